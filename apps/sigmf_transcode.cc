@@ -0,0 +1,99 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <boost/program_options.hpp>
+#include <boost/format.hpp>
+#include <unistd.h>
+#include <stdio.h>
+#include <sigmf/transcode.h>
+
+
+namespace po = boost::program_options;
+
+static const auto RED = isatty(fileno(stdin)) ? "\033[1;31m" : "";
+static const auto NO_COLOR = isatty(fileno(stdin)) ? "\033[0m" : "";
+
+int
+main(int argc, char *argv[])
+{
+  std::string input_filename;
+  std::string output_filename;
+  std::string output_type;
+  size_t num_threads;
+  size_t chunk_samples;
+
+  po::options_description main_options("Allowed options");
+  // Need to tell clang-format to not format this
+  // clang-format off
+  main_options.add_options()
+    ("help,h", "Show help message")
+    ("type,t", po::value<std::string>(&output_type)->required(), "Datatype to convert to, e.g. ci16_le")
+    ("threads,j", po::value<size_t>(&num_threads)->default_value(0), "Conversion threads, 0 for one per core")
+    ("chunk-samples", po::value<size_t>(&chunk_samples)->default_value(1 << 20), "Samples converted at a time by each thread")
+    ("output-file,o", po::value<std::string>(&output_filename)->required(), "File to write to")
+    ("input-file", po::value<std::string>(&input_filename)->required(), "File to convert");
+  // clang-format on
+  po::positional_options_description positional_options;
+  positional_options.add("input-file", 1);
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv)
+              .options(main_options)
+              .positional(positional_options)
+              .run(),
+            vm);
+
+  if(vm.count("help")) {
+    std::cout << "Convert a SigMF dataset to another datatype" << std::endl << std::endl;
+    std::cout << boost::format("Usage: %s [options] -t <type> -o <output> <filename>") % argv[0]
+              << std::endl
+              << std::endl;
+    std::cout << main_options << std::endl;
+    return ~0;
+  }
+
+  try {
+    po::notify(vm);
+  }
+  catch(const std::exception &e) {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t num_samples;
+  try {
+    num_samples = gr::sigmf::transcode(
+      input_filename, output_filename, output_type, num_threads, chunk_samples);
+  }
+  catch(const std::exception &e) {
+    std::cerr << RED << "Transcode failed: " << e.what() << NO_COLOR << std::endl;
+    return 1;
+  }
+  double seconds =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << boost::format("Converted %d samples in %.2f s (%.1f Msps)") % num_samples %
+                 seconds % (num_samples / seconds / 1e6)
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,122 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SIGMF_ANNOTATION_INDEX_H
+#define INCLUDED_SIGMF_ANNOTATION_INDEX_H
+
+#include <sigmf/api.h>
+#include <sigmf/meta_arena.h>
+#include <sigmf/meta_namespace.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gr {
+  namespace sigmf {
+
+    /*!
+     * Finds the annotations that overlap a range of samples without
+     * looking at the others.
+     *
+     * Annotations are sorted by sample_start and laid out as an implicit
+     * balanced binary tree, where every node also has the largest end of
+     * any annotation below it. A query skips subtrees that end before the
+     * range or start after it, so it takes O(log n + k) for the k
+     * annotations that start in the range, plus O(log n) at most for each
+     * one that starts before the range and runs into it.
+     *
+     * An annotation covers [sample_start, sample_start + sample_count). One
+     * with no sample_count, or a sample_count of 0, covers just its
+     * sample_start, so it overlaps a range it starts in.
+     *
+     * The index is built once; annotations added later aren't in it.
+     */
+    class SIGMF_API annotation_index {
+      public:
+      struct interval {
+        uint64_t sample_start;
+        uint64_t sample_count;
+        //! which annotation this is, returned by queries
+        size_t index;
+      };
+
+      annotation_index();
+
+      /*! \brief index annotations by position in the vector
+      * @exception std::runtime_error an annotation has no core:sample_start
+      */
+      explicit annotation_index(const std::vector<meta_namespace> &annotations);
+
+      //! \copydoc annotation_index(const std::vector<meta_namespace> &annotations)
+      explicit annotation_index(const arena_segments &annotations);
+
+      /*! \brief index intervals directly, for annotations kept some other way
+      */
+      explicit annotation_index(std::vector<interval> intervals);
+
+      /*! \brief indices of the annotations that overlap the samples
+      * [start, end), in order of sample_start
+      */
+      std::vector<size_t> overlapping(uint64_t start, uint64_t end) const;
+
+      /*! \copydoc overlapping(uint64_t start, uint64_t end) const
+      *
+      * The indices are appended to out, so a caller can reuse its vector.
+      */
+      void overlapping(uint64_t start, uint64_t end, std::vector<size_t> &out) const;
+
+      /*! \brief indices of the annotations that cover sample, in order
+      * of sample_start
+      */
+      std::vector<size_t> at(uint64_t sample) const;
+
+      size_t
+      size() const
+      {
+        return d_starts.size();
+      }
+
+      bool
+      empty() const
+      {
+        return d_starts.empty();
+      }
+
+      private:
+      // Sorted by start. The node for [lo, hi) is at the middle, with
+      // [lo, mid) and [mid + 1, hi) below it.
+      std::vector<uint64_t> d_starts;
+      std::vector<uint64_t> d_ends;
+      std::vector<uint64_t> d_max_ends;
+      std::vector<size_t> d_indices;
+
+      void build(std::vector<interval> &intervals);
+      uint64_t build_max_ends(size_t lo, size_t hi);
+      void query(size_t lo,
+                 size_t hi,
+                 uint64_t start,
+                 uint64_t end,
+                 std::vector<size_t> &out) const;
+    };
+
+  } // namespace sigmf
+} // namespace gr
+
+#endif /* INCLUDED_SIGMF_ANNOTATION_INDEX_H */
@@ -0,0 +1,346 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SIGMF_META_ARENA_H
+#define INCLUDED_SIGMF_META_ARENA_H
+
+#include <sigmf/api.h>
+#include <sigmf/meta_namespace.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace gr {
+  namespace sigmf {
+
+    /*!
+     * A bump allocator. Memory is handed out from large blocks and is
+     * only ever freed all at once, by clear() or the destructor, which
+     * costs one free per block no matter how many allocations there were.
+     * Nothing allocated in an arena has its destructor run.
+     */
+    class SIGMF_API meta_arena {
+      public:
+      static const size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+
+      explicit meta_arena(size_t block_size = DEFAULT_BLOCK_SIZE);
+      ~meta_arena();
+
+      meta_arena(meta_arena &&other) noexcept;
+      meta_arena &operator=(meta_arena &&other) noexcept;
+      meta_arena(const meta_arena &) = delete;
+      meta_arena &operator=(const meta_arena &) = delete;
+
+      /*! \brief size bytes aligned to align, which must be a power of two
+      *
+      * Allocations bigger than a quarter of a block get a block of their own.
+      */
+      void *allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+      //! a copy of length bytes of data in the arena
+      const char *copy(const char *data, size_t length);
+
+      //! free every block
+      void clear();
+
+      //! bytes in blocks, used or not
+      size_t
+      capacity() const
+      {
+        return d_capacity;
+      }
+
+      private:
+      size_t d_block_size;
+      std::vector<char *> d_blocks;
+      char *d_pos;
+      char *d_end;
+      size_t d_capacity;
+
+      char *new_block(size_t size);
+    };
+
+    /*!
+     * A metadata value stored in an arena_segments. Scalars are stored
+     * inline and strings in the arena. Objects and arrays are kept in the
+     * arena as JSON and turned back into a pmt when they're read, the
+     * same pmt they would be if they were loaded from a file.
+     */
+    class SIGMF_API arena_value {
+      public:
+      meta_value::kind_t
+      kind() const
+      {
+        return d_kind;
+      }
+
+      //! the value as the pmt it would be in a meta_namespace
+      pmt::pmt_t to_pmt() const;
+
+      /*! \brief read the value without boxing it in a pmt
+      *
+      * Converts the way meta_value::as does.
+      * @return false if the value can't be read as that type
+      */
+      bool
+      as(uint64_t &out) const
+      {
+        if(d_kind == meta_value::UINT64 || (d_kind == meta_value::INT64 && d_int >= 0)) {
+          out = d_uint;
+          return true;
+        }
+        return false;
+      }
+
+      //! \copydoc as(uint64_t &out) const
+      bool
+      as(int64_t &out) const
+      {
+        if(d_kind == meta_value::INT64 ||
+           (d_kind == meta_value::UINT64 &&
+            d_uint <= uint64_t(std::numeric_limits<int64_t>::max()))) {
+          out = d_int;
+          return true;
+        }
+        return false;
+      }
+
+      //! \copydoc as(uint64_t &out) const
+      bool
+      as(double &out) const
+      {
+        switch(d_kind) {
+          case meta_value::DOUBLE:
+            out = d_double;
+            return true;
+          case meta_value::INT64:
+            out = d_int;
+            return true;
+          case meta_value::UINT64:
+            out = d_uint;
+            return true;
+          default:
+            return false;
+        }
+      }
+
+      //! \copydoc as(uint64_t &out) const
+      bool
+      as(bool &out) const
+      {
+        if(d_kind == meta_value::BOOL) {
+          out = d_bool;
+          return true;
+        }
+        return false;
+      }
+
+      //! \copydoc as(uint64_t &out) const
+      bool
+      as(std::string &out) const
+      {
+        if(d_kind == meta_value::STRING) {
+          out.assign(d_str.data, d_str.length);
+          return true;
+        }
+        return false;
+      }
+
+      private:
+      friend class arena_segment;
+      friend class arena_segments;
+
+      meta_value::kind_t d_kind;
+      // PMT values are JSON text unless they can't be written as JSON
+      bool d_json;
+      union {
+        bool d_bool;
+        int64_t d_int;
+        uint64_t d_uint;
+        double d_double;
+        struct {
+          const char *data;
+          size_t length;
+        } d_str;
+        const pmt::pmt_t *d_pmt;
+      };
+    };
+
+    /*!
+     * One segment of an arena_segments: its keys and values in the order
+     * they were set. Segments are small, so a key is found by comparing
+     * it against each interned key in turn.
+     */
+    class SIGMF_API arena_segment {
+      public:
+      struct member {
+        const meta_key *key;
+        arena_value value;
+      };
+      typedef const member *const_iterator;
+
+      const_iterator
+      begin() const
+      {
+        return d_members;
+      }
+
+      const_iterator
+      end() const
+      {
+        return d_members + d_size;
+      }
+
+      size_t
+      size() const
+      {
+        return d_size;
+      }
+
+      //! the value under key, or NULL if there isn't one
+      const arena_value *find(const meta_key &key) const;
+
+      //! \copydoc find(const meta_key &key) const
+      const arena_value *find(const std::string &key) const;
+
+      //! \copydoc find(const meta_key &key) const
+      const arena_value *
+      find(meta_key::core_field field) const
+      {
+        return find(meta_key::core(field));
+      }
+
+      //! see meta_namespace::try_get
+      template <typename T>
+      bool
+      try_get(meta_key::core_field field, T &out) const
+      {
+        const arena_value *val = find(field);
+        return val != NULL && val->as(out);
+      }
+
+      //! the value under key as a pmt, or PMT_NIL if there isn't one
+      pmt::pmt_t get(const std::string &key) const;
+
+      //! a meta_namespace holding the same values
+      meta_namespace to_namespace() const;
+
+      private:
+      friend class arena_segments;
+
+      const member *d_members;
+      size_t d_size;
+    };
+
+    /*!
+     * The capture or annotation segments of a recording, all stored in
+     * one meta_arena. A meta_namespace allocates its table, its strings
+     * and a pmt tree for each nested value separately, so a million
+     * annotations are millions of small allocations that spread over the
+     * heap and take seconds to free one by one. Here everything is
+     * trivially destructible and lives in a few large blocks, so the
+     * segments take less memory and are freed in a handful of calls.
+     *
+     * Segments can only be added, not changed.
+     */
+    class SIGMF_API arena_segments {
+      public:
+      typedef std::vector<arena_segment>::const_iterator const_iterator;
+
+      arena_segments();
+
+      arena_segments(arena_segments &&other) = default;
+      arena_segments &operator=(arena_segments &&other) = default;
+      arena_segments(const arena_segments &) = delete;
+      arena_segments &operator=(const arena_segments &) = delete;
+
+      /*! \brief add a copy of a segment
+      */
+      void push_back(const meta_namespace &ns);
+
+      const arena_segment &
+      operator[](size_t index) const
+      {
+        return d_segments[index];
+      }
+
+      size_t
+      size() const
+      {
+        return d_segments.size();
+      }
+
+      bool
+      empty() const
+      {
+        return d_segments.empty();
+      }
+
+      const_iterator
+      begin() const
+      {
+        return d_segments.begin();
+      }
+
+      const_iterator
+      end() const
+      {
+        return d_segments.end();
+      }
+
+      //! remove every segment and free the arena
+      void clear();
+
+      //! bytes held, including unused space in the arena
+      size_t memory_size() const;
+
+      private:
+      meta_arena d_arena;
+      std::vector<arena_segment> d_segments;
+      // Values that can't be written as JSON. A deque, so they stay
+      // where values point to as more are added.
+      std::deque<pmt::pmt_t> d_pmts;
+    };
+
+    /*! \brief parse a whole metadata file, storing the annotations in an arena
+    *
+    * Large files are parsed on one thread per core, a round of slices
+    * at a time as the load_metafile overload taking num_threads and a
+    * callback does. Each annotation is copied into the arena as soon as
+    * its round is done, so the annotations are never all held as
+    * meta_namespace at once.
+    * @param fp the file to read
+    * @param global set to the global object
+    * @param captures capture segments are appended to this
+    * @param annotations annotation segments are appended to this
+    */
+    void load_metafile(FILE *fp,
+                       meta_namespace &global,
+                       std::vector<meta_namespace> &captures,
+                       arena_segments &annotations) SIGMF_API;
+
+  } // namespace sigmf
+} // namespace gr
+
+#endif /* INCLUDED_SIGMF_META_ARENA_H */
@@ -0,0 +1,133 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SIGMF_META_KEY_H
+#define INCLUDED_SIGMF_META_KEY_H
+
+#include <pmt/pmt.h>
+#include <sigmf/api.h>
+#include <string>
+
+namespace gr {
+  namespace sigmf {
+
+    /*!
+     * An interned metadata key. There is one meta_key per distinct key
+     * string in the process, so keys can be compared by address, and the
+     * work of validating and splitting a key is done the first time it's
+     * seen.
+     *
+     * Like pmt symbols, interned keys are never freed.
+     */
+    class SIGMF_API meta_key {
+      public:
+      /*!
+       * Core keys that are read often enough that meta_map keeps a slot
+       * for each, so looking one up doesn't need the hash table.
+       */
+      enum core_field {
+        NOT_CORE = -1,
+        SAMPLE_START,
+        SAMPLE_COUNT,
+        FREQUENCY,
+        DATETIME,
+        NUM_CORE_FIELDS
+      };
+
+      /*! \brief the interned key for a string, interning it if needed
+      */
+      static const meta_key &intern(const std::string &key);
+
+      /*! \brief the interned key for a string, or NULL if it has never been
+      * interned, which means no meta_namespace can hold it
+      */
+      static const meta_key *lookup(const std::string &key);
+
+      //! true if the key has the form namespace:name
+      static bool is_valid_key(const std::string &key);
+
+      //! the interned key for a core field
+      static const meta_key &core(core_field field);
+
+      const std::string &
+      str() const
+      {
+        return d_str;
+      }
+
+      //! the part before the colon; empty for invalid keys
+      const std::string &
+      ns() const
+      {
+        return d_ns;
+      }
+
+      //! the part after the colon; empty for invalid keys
+      const std::string &
+      name() const
+      {
+        return d_name;
+      }
+
+      bool
+      valid() const
+      {
+        return d_valid;
+      }
+
+      size_t
+      hash() const
+      {
+        return d_hash;
+      }
+
+      //! the key as a pmt symbol
+      const pmt::pmt_t &
+      symbol() const
+      {
+        return d_symbol;
+      }
+
+      //! which core field this key is, or NOT_CORE
+      core_field
+      field() const
+      {
+        return d_field;
+      }
+
+      meta_key(const meta_key &) = delete;
+      meta_key &operator=(const meta_key &) = delete;
+
+      private:
+      explicit meta_key(const std::string &key, size_t hash);
+
+      std::string d_str;
+      std::string d_ns;
+      std::string d_name;
+      bool d_valid;
+      size_t d_hash;
+      pmt::pmt_t d_symbol;
+      core_field d_field;
+    };
+
+  } // namespace sigmf
+} // namespace gr
+
+#endif /* INCLUDED_SIGMF_META_KEY_H */
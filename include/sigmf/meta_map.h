@@ -0,0 +1,324 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SIGMF_META_MAP_H
+#define INCLUDED_SIGMF_META_MAP_H
+
+#include <pmt/pmt.h>
+#include <sigmf/api.h>
+#include <sigmf/meta_key.h>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace gr {
+  namespace sigmf {
+
+    /*!
+     * A single metadata value. Scalars and strings are stored unboxed;
+     * objects, arrays and anything else are kept as a pmt.
+     *
+     * The constructors mirror the pmt::mp overloads, so a value set
+     * through meta_value converts to the same pmt that pmt::mp would give.
+     */
+    class SIGMF_API meta_value {
+      public:
+      enum kind_t { NIL, BOOL, INT64, UINT64, DOUBLE, STRING, PMT };
+
+      meta_value();
+      meta_value(int val);
+      meta_value(long val);
+      meta_value(unsigned long val);
+      meta_value(unsigned long long val);
+      meta_value(double val);
+      meta_value(const std::string &val);
+      meta_value(const char *val);
+      meta_value(const pmt::pmt_t &val);
+
+      /*! \brief a BOOL value
+      *
+      * There's no bool constructor, a bool converts like an int the same
+      * way it does with pmt::mp.
+      */
+      static meta_value from_bool(bool val);
+
+      kind_t
+      kind() const
+      {
+        return d_kind;
+      }
+
+      //! the string value; only valid for STRING values
+      const std::string &
+      str() const
+      {
+        return d_str;
+      }
+
+      /*! \brief convert to the pmt this value would have been stored as
+      */
+      pmt::pmt_t to_pmt() const;
+
+      /*! \brief read the value without boxing it in a pmt
+      *
+      * Numbers convert the way the pmt::to_* functions would convert
+      * them: integers widen to double, and a signed integer reads as
+      * uint64_t if it isn't negative.
+      * @return false if the value can't be read as that type
+      */
+      bool
+      as(uint64_t &out) const
+      {
+        if(d_kind == UINT64 || (d_kind == INT64 && d_int >= 0)) {
+          out = d_uint;
+          return true;
+        }
+        return false;
+      }
+
+      //! \copydoc as(uint64_t &out) const
+      bool
+      as(int64_t &out) const
+      {
+        if(d_kind == INT64 ||
+           (d_kind == UINT64 && d_uint <= uint64_t(std::numeric_limits<int64_t>::max()))) {
+          out = d_int;
+          return true;
+        }
+        return false;
+      }
+
+      //! \copydoc as(uint64_t &out) const
+      bool
+      as(double &out) const
+      {
+        switch(d_kind) {
+          case DOUBLE:
+            out = d_double;
+            return true;
+          case INT64:
+            out = d_int;
+            return true;
+          case UINT64:
+            out = d_uint;
+            return true;
+          default:
+            return false;
+        }
+      }
+
+      //! \copydoc as(uint64_t &out) const
+      bool
+      as(bool &out) const
+      {
+        if(d_kind == BOOL) {
+          out = d_bool;
+          return true;
+        }
+        return false;
+      }
+
+      //! \copydoc as(uint64_t &out) const
+      bool
+      as(std::string &out) const
+      {
+        if(d_kind == STRING) {
+          out = d_str;
+          return true;
+        }
+        return false;
+      }
+
+      /*! \brief write this value to a rapidjson Writer
+      */
+      template <typename Writer>
+      void
+      serialize(Writer &writer) const
+      {
+        switch(d_kind) {
+          case BOOL:
+            writer.Bool(d_bool);
+            break;
+          case INT64:
+            writer.Int64(d_int);
+            break;
+          case UINT64:
+            writer.Uint64(d_uint);
+            break;
+          case DOUBLE:
+            writer.Double(d_double);
+            break;
+          case STRING:
+            writer.String(d_str.c_str(), d_str.size());
+            break;
+          case NIL:
+            serialize_pmt(writer, pmt::get_PMT_NIL());
+            break;
+          default:
+            serialize_pmt(writer, d_pmt);
+            break;
+        }
+      }
+
+      /*! \brief write a pmt to a rapidjson Writer as JSON
+      */
+      template <typename Writer>
+      static void
+      serialize_pmt(Writer &writer, pmt::pmt_t pmt_data)
+      {
+        if(pmt::is_dict(pmt_data)) {
+          // Walk the dict's pairs once, rather than looking each key up,
+          // which would be quadratic in the number of keys
+          writer.StartObject();
+          pmt::pmt_t items = pmt::dict_items(pmt_data);
+          for(; pmt::is_pair(items); items = pmt::cdr(items)) {
+            pmt::pmt_t item = pmt::car(items);
+            std::string key_str = pmt::symbol_to_string(pmt::car(item));
+            writer.String(key_str.c_str(), key_str.size());
+            serialize_pmt(writer, pmt::cdr(item));
+          }
+          writer.EndObject();
+        } else if(pmt::is_bool(pmt_data)) {
+          writer.Bool(pmt::to_bool(pmt_data));
+        } else if(pmt::is_integer(pmt_data)) {
+          writer.Int64(pmt::to_long(pmt_data));
+        } else if(pmt::is_real(pmt_data)) {
+          writer.Double(pmt::to_double(pmt_data));
+        } else if(pmt::is_vector(pmt_data)) {
+          writer.StartArray();
+          size_t num_items = pmt::length(pmt_data);
+          for(size_t i = 0; i < num_items; i++) {
+            pmt::pmt_t item = pmt::vector_ref(pmt_data, i);
+            serialize_pmt(writer, item);
+          }
+          writer.EndArray();
+        } else if(pmt::is_symbol(pmt_data)) {
+          std::string str = pmt::symbol_to_string(pmt_data);
+          writer.String(str.c_str());
+        } else if(pmt::is_uint64(pmt_data)) {
+          writer.Uint64(pmt::to_uint64(pmt_data));
+        } else {
+          throw std::runtime_error("Unhandled pmt value in serialize_pmt");
+        }
+      }
+
+      private:
+      kind_t d_kind;
+      union {
+        bool d_bool;
+        int64_t d_int;
+        uint64_t d_uint;
+        double d_double;
+      };
+      std::string d_str;
+      pmt::pmt_t d_pmt;
+    };
+
+    /*!
+     * Map from interned metadata keys to values, kept in insertion order.
+     *
+     * Entries live in a vector, and an open addressing table of entry
+     * indices with linear probing finds them by key, so lookups and
+     * inserts are O(1) and iteration is a walk over the vector. Keys are
+     * compared by address. Core fields also have a slot each, so reading
+     * one is a field read.
+     */
+    class SIGMF_API meta_map {
+      public:
+      struct entry {
+        const meta_key *key;
+        meta_value value;
+      };
+      typedef std::vector<entry>::const_iterator const_iterator;
+
+      meta_map();
+
+      //! the value under key, or NULL if there isn't one
+      const meta_value *find(const meta_key &key) const;
+
+      //! \copydoc find(const meta_key &key) const
+      meta_value *find(const meta_key &key);
+
+      //! \copydoc find(const meta_key &key) const
+      const meta_value *find(const std::string &key) const;
+
+      //! the value under a core field's key, read from its slot
+      const meta_value *
+      find(meta_key::core_field field) const
+      {
+        uint32_t index = d_core[field];
+        return index == 0 ? NULL : &d_entries[index - 1].value;
+      }
+
+      /*! \brief set the value under key, replacing an existing value in place
+      */
+      void set(const meta_key &key, const meta_value &val);
+
+      /*! \brief remove the value under key
+      * @return true if there was one
+      */
+      bool erase(const meta_key &key);
+
+      //! make room for count entries without rehashing
+      void reserve(size_t count);
+
+      size_t
+      size() const
+      {
+        return d_entries.size();
+      }
+
+      bool
+      empty() const
+      {
+        return d_entries.empty();
+      }
+
+      const_iterator
+      begin() const
+      {
+        return d_entries.begin();
+      }
+
+      const_iterator
+      end() const
+      {
+        return d_entries.end();
+      }
+
+      private:
+      // Slot for key: the one holding it, or the empty one it would go in
+      size_t find_slot(const meta_key &key) const;
+      void rehash(size_t num_slots);
+
+      std::vector<entry> d_entries;
+      // Index into d_entries plus one, or zero for an empty slot. The
+      // size is zero or a power of two.
+      std::vector<uint32_t> d_slots;
+      // The same, for each core field
+      uint32_t d_core[meta_key::NUM_CORE_FIELDS];
+    };
+
+  } // namespace sigmf
+} // namespace gr
+
+#endif /* INCLUDED_SIGMF_META_MAP_H */
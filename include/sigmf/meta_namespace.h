@@ -34,9 +34,13 @@
 #undef RAPIDJSON_HAS_STDSTRING
 #endif
 
+#include <cstdio>
+#include <functional>
 #include <set>
 #include <sigmf/api.h>
+#include <sigmf/meta_map.h>
 #include <string>
+#include <vector>
 
 namespace gr {
   namespace sigmf {
@@ -44,11 +48,14 @@ namespace gr {
     static const char *SIGMF_VERSION = "0.0.2";
 
     /*!
-     * meta_namespace is essentially a light wrapper around a pmt
-     * that is used to represent all sections of the metadata in
-     * gr-simgf. The global metadata is a single instace and
+     * meta_namespace is used to represent all sections of the metadata
+     * in gr-simgf. The global metadata is a single instace and
      * each segment in annotations and captures is also a single
      * instance.
+     *
+     * Values are kept in a meta_map rather than a pmt dict, so gets and
+     * sets don't walk or copy the whole object. The pmt based API
+     * converts to and from pmts as needed.
      */
     class SIGMF_API meta_namespace {
       public:
@@ -74,15 +81,31 @@ namespace gr {
       static meta_namespace build_annotation_segment(uint64_t sample_start, uint64_t sample_count);
 
       meta_namespace(pmt::pmt_t data);
+
+      /*! \brief take ownership of values that have already been built
+      *
+      * Like the pmt constructor, keys aren't validated.
+      */
+      explicit meta_namespace(meta_map data);
+
       meta_namespace();
       ~meta_namespace();
 
-      /*! \brief access the underlying pmt for this meta_namespace object
+      // Declared so the destructor above doesn't turn moves into copies
+      meta_namespace(const meta_namespace &) = default;
+      meta_namespace(meta_namespace &&) = default;
+      meta_namespace &operator=(const meta_namespace &) = default;
+      meta_namespace &operator=(meta_namespace &&) = default;
+
+      /*! \brief build a pmt dict with the contents of this meta_namespace object
       * @return the pmt
       */
       pmt::pmt_t data();
 
       /*! \brief check if a given string is a valid key for SigMF metadata
+      *
+      * The result is cached in the interned key table, so checking a key
+      * that has been seen before is a single lookup.
       * @param key the key to check
       * @return true if the key is valid and false otherwise
       */
@@ -100,10 +123,7 @@ namespace gr {
       void
       set(const std::string &key, ValType val)
       {
-        if(!validate_key(key)) {
-          throw std::invalid_argument("key format is invalid:'" + key + "'");
-        }
-        d_data = pmt::dict_add(d_data, pmt::mp(key), pmt::mp(val));
+        set(meta_key::intern(key), meta_value(val));
       }
 
       /*! \copydoc set(const std::string &key, ValType val)
@@ -111,13 +131,13 @@ namespace gr {
       void
       set(const pmt::pmt_t &key, const pmt::pmt_t &val)
       {
-        std::string key_str = pmt::symbol_to_string(key);
-        if(!validate_key(key_str)) {
-          throw std::invalid_argument("key format is invalid:'" + key_str + "'");
-        }
-        d_data = pmt::dict_add(d_data, key, val);
+        set(meta_key::intern(pmt::symbol_to_string(key)), meta_value(val));
       }
 
+      /*! \copydoc set(const std::string &key, ValType val)
+      */
+      void set(const meta_key &key, const meta_value &val);
+
       /*! \copydoc set(const std::string &key, ValType val)
       */
       // TODO: This should probably be a specialization of the template function above,
@@ -153,6 +173,62 @@ namespace gr {
       */
       std::string get_str(const std::string &key) const;
 
+      /*! \brief read a value as uint64_t, int64_t, double, bool or std::string
+      * without building a pmt
+      *
+      * See meta_value::as for how numbers convert.
+      * @param key the key to use
+      * @param out set to the value if there is one of the right type
+      * @return false if there's no value of that type under the key
+      */
+      template <typename T>
+      bool
+      try_get(const std::string &key, T &out) const
+      {
+        const meta_value *val = d_data.find(key);
+        return val != NULL && val->as(out);
+      }
+
+      /*! \copydoc try_get(const std::string &key, T &out) const
+      *
+      * Core fields are read from a slot in the map, without hashing.
+      */
+      template <typename T>
+      bool
+      try_get(meta_key::core_field field, T &out) const
+      {
+        const meta_value *val = d_data.find(field);
+        return val != NULL && val->as(out);
+      }
+
+      /*! \brief like try_get, but throws std::runtime_error if there's no
+      * value of that type under the key
+      */
+      template <typename T>
+      T
+      get_as(const std::string &key) const
+      {
+        T out;
+        if(!try_get(key, out)) {
+          throw std::runtime_error("no value of the requested type for key '" + key + "'");
+        }
+        return out;
+      }
+
+      /*! \copydoc get_as(const std::string &key) const
+      */
+      template <typename T>
+      T
+      get_as(meta_key::core_field field) const
+      {
+        T out;
+        if(!try_get(field, out)) {
+          throw std::runtime_error("no value of the requested type for key '" +
+                                   meta_key::core(field).str() + "'");
+        }
+        return out;
+      }
+
       /*! \brief Check if a given key exists
       * @param key the key to check
       * @return true if the key is present and false otherwise
@@ -181,7 +257,20 @@ namespace gr {
       void
       serialize(Writer &writer) const
       {
-        serialize_impl(writer, d_data);
+        writer.StartObject();
+        for(const meta_map::entry &e : d_data) {
+          writer.String(e.key->str().c_str(), e.key->str().size());
+          e.value.serialize(writer);
+        }
+        writer.EndObject();
+      }
+
+      /*! \brief the values, in the order their keys were first set
+      */
+      const meta_map &
+      values() const
+      {
+        return d_data;
       }
 
       /*! \brief Print a string representation of this namespace to stdout
@@ -189,47 +278,7 @@ namespace gr {
       void print() const;
 
       private:
-
-      template <typename Writer>
-      void
-      serialize_impl(Writer &writer, pmt::pmt_t pmt_data) const
-      {
-        if(pmt::is_dict(pmt_data)) {
-          writer.StartObject();
-          pmt::pmt_t item_keys = pmt::dict_keys(pmt_data);
-          size_t num_items = pmt::length(item_keys);
-          for(size_t i = 0; i < num_items; i++) {
-            pmt::pmt_t item_key = pmt::nth(i, item_keys);
-            pmt::pmt_t val_for_key = pmt::dict_ref(pmt_data, item_key, pmt::get_PMT_NIL());
-            std::string key_str = pmt::symbol_to_string(item_key);
-            writer.String(key_str.c_str());
-            serialize_impl(writer, val_for_key);
-          }
-          writer.EndObject();
-        } else if(pmt::is_bool(pmt_data)) {
-          writer.Bool(pmt::to_bool(pmt_data));
-        } else if(pmt::is_integer(pmt_data)) {
-          writer.Int64(pmt::to_long(pmt_data));
-        } else if(pmt::is_real(pmt_data)) {
-          writer.Double(pmt::to_double(pmt_data));
-        } else if(pmt::is_vector(pmt_data)) {
-          writer.StartArray();
-          size_t num_items = pmt::length(pmt_data);
-          for(size_t i = 0; i < num_items; i++) {
-            pmt::pmt_t item = pmt::vector_ref(pmt_data, i);
-            serialize_impl(writer, item);
-          }
-          writer.EndArray();
-        } else if(pmt::is_symbol(pmt_data)) {
-          std::string str = pmt::symbol_to_string(pmt_data);
-          writer.String(str.c_str());
-        } else if(pmt::is_uint64(pmt_data)) {
-          writer.Uint64(pmt::to_uint64(pmt_data));
-        } else {
-          throw std::runtime_error("Unhandled pmt value in serialize_impl");
-        }
-      }
-      pmt::pmt_t d_data;
+      meta_map d_data;
     };
 
 
@@ -239,7 +288,73 @@ namespace gr {
       std::vector<meta_namespace> annotations;
     };
 
+    /*! \brief parse a whole metadata file
+    *
+    * Segments are built straight from the parser's events, without a
+    * Document or pmt in between. Files of 4 MiB or more have their
+    * annotations parsed on one thread per core, see the overload below.
+    */
     metafile_namespaces load_metafile(FILE *fp) SIGMF_API;
+
+    /*! \brief parse a whole metadata file, splitting the annotations
+    * across threads
+    *
+    * The file is read into memory and the bounds of every element of the
+    * annotations array are found without parsing them. Each thread then
+    * parses a slice of the array, about the same number of bytes each,
+    * and the annotations end up in file order as usual. Pipes, files
+    * under 4 MiB and files whose layout isn't plain enough to split are
+    * parsed on the calling thread.
+    *
+    * While the threads parse, a copy of the file from its current
+    * position to the end is held in memory, so peak memory use is the
+    * size of the file on top of the parsed segments. Where that matters
+    * more than load time, pass 1 thread or use the overload that hands
+    * annotations over one at a time, which read through a small buffer.
+    * @param fp the file to read, from its current position
+    * @param num_threads threads to parse with, 0 for one per core
+    */
+    metafile_namespaces load_metafile(FILE *fp, size_t num_threads) SIGMF_API;
+
+    /*! \brief parse a metadata file, handing annotations over one at a time
+    *
+    * on_annotation is called with each annotation as soon as it has been
+    * parsed, so the whole annotations array is never held in memory.
+    * Annotations are in file order, so if they come before global or
+    * captures in the file those won't have been filled in yet when the
+    * callback runs.
+    * @param fp the file to read
+    * @param global set to the global object
+    * @param captures capture segments are appended to this
+    * @param on_annotation called with each annotation segment
+    */
+    void load_metafile(FILE *fp,
+                       meta_namespace &global,
+                       std::vector<meta_namespace> &captures,
+                       const std::function<void(meta_namespace &)> &on_annotation) SIGMF_API;
+
+    /*! \brief parse a metadata file across threads, handing annotations
+    * over one at a time
+    *
+    * Like the overload above, except that files split across threads as
+    * load_metafile(FILE *, size_t) splits them are parsed in rounds of
+    * one slice of about 1 MiB per thread. Each round's annotations are
+    * handed to on_annotation in file order, on the calling thread, and
+    * freed before the next round is parsed. So besides the copy of the
+    * file, only one round of annotations is held at a time. When a file
+    * is split, global and captures are filled in before the first call.
+    * @param fp the file to read, from its current position
+    * @param num_threads threads to parse with, 0 for one per core
+    * @param global set to the global object
+    * @param captures capture segments are appended to this
+    * @param on_annotation called with each annotation segment
+    */
+    void load_metafile(FILE *fp,
+                       size_t num_threads,
+                       meta_namespace &global,
+                       std::vector<meta_namespace> &captures,
+                       const std::function<void(meta_namespace &)> &on_annotation) SIGMF_API;
+
     pmt::pmt_t json_value_to_pmt(const rapidjson::Value &val) SIGMF_API;
   }
 }
@@ -56,7 +56,7 @@ namespace gr {
       bool is_complex;
       //! base type string, so no r or c and no _le or _be
       std::string type_str;
-      //! size of the format in bits
+      //! size of the format in bits, 4 or 12 for the packed ci4 and ci12
       size_t width;
       //! endinness of the format
       endian_t endianness;
@@ -65,6 +65,11 @@ namespace gr {
     /*!
      * \brief Parse the dataset format
      * defined by SigMF into a format_detail_t struct.
+     *
+     * Also accepts the packed complex formats ci4, with I in the high
+     * nibble and Q in the low nibble of each byte, and ci12, with I and Q
+     * in three bytes. ci12_le has the low bits of each value first and
+     * ci12_be the high bits.
      * @param format_str format as a sttring
      * @exception std::runtime_error invalid format string
      * @return the parsed struct
@@ -136,6 +136,25 @@ namespace gr {
        */
       virtual void set_capture_meta(uint64_t index, std::string key, pmt::pmt_t val) = 0;
 
+      /*!
+       * \brief Record the scale and offset that map samples to physical
+       * units, as in * scale + offset
+       *
+       * Stored as gr_sigmf:scale and gr_sigmf:offset in the global
+       * metadata and kept for new files. A source block playing the
+       * recording as a floating point type applies them as it converts.
+       * The samples themselves are written unchanged.
+       */
+      virtual void set_scale(double scale, double offset = 0) = 0;
+
+      /*!
+       * \brief Write the metadata file without indentation or newlines
+       *
+       * Large annotation arrays are roughly half the size written this
+       * way. Applies to metadata written from now on.
+       */
+      virtual void set_compact_meta(bool compact) = 0;
+
       /*!
        * \brief Open a new file to start recording to
        * @param filename the file to write to
@@ -44,9 +44,19 @@ namespace gr {
        * constructor is in a private implementation
        * class. sigmf::source::make is the public interface for
        * creating new instances.
+       *
+       * If stream_annotations is true, only the global object and capture
+       * segments are loaded up front. Annotations are read from the
+       * metadata file as playback reaches them, so startup time and memory
+       * use don't depend on the number of annotations. This requires the
+       * annotations to be sorted by core:sample_start, as the SigMF spec
+       * says they should be. Annotations that are out of order are dropped.
        */
       static sptr
-      make(std::string filename, std::string output_datatype, bool repeat = false);
+      make(std::string filename,
+           std::string output_datatype,
+           bool repeat = false,
+           bool stream_annotations = false);
 
       /*!
        * \brief Return a shared_ptr to a new instance of sigmf::source.
@@ -55,7 +65,28 @@ namespace gr {
        * native datatype of the input file as the output datatype.
        */
       static sptr
-      make_no_datatype(std::string filename, bool repeat = false);
+      make_no_datatype(std::string filename, bool repeat = false, bool stream_annotations = false);
+
+      /*!
+       * \brief Return a shared_ptr to a source that plays several recordings
+       * back to back as one continuous stream.
+       *
+       * Each entry of filenames is either a recording or a glob pattern
+       * (using * and ?) that matches recordings, which are played sorted by
+       * name. While a recording plays, the next one is opened and its
+       * metadata parsed on a background thread so there is no gap between
+       * them. With repeat set, playback goes back to the first recording
+       * after the last one.
+       *
+       * Recordings may have different datatypes as long as each can be
+       * converted to output_datatype. If output_datatype is empty, the
+       * datatype of the first recording is used.
+       */
+      static sptr
+      make_sequence(std::vector<std::string> filenames,
+                    std::string output_datatype = "",
+                    bool repeat = false,
+                    bool stream_annotations = false);
 
       /*!
        * \brief Add a stream tag to the first sample of the file if true
@@ -63,6 +94,80 @@ namespace gr {
        */
       virtual void set_begin_tag(pmt::pmt_t val) = 0;
 
+      /*!
+       * \brief Convert the recording into memory once, rather than
+       * reading and converting it from the file on every repeat
+       *
+       * Useful for short recordings that are repeated for a long time.
+       * Nothing is cached if the converted recording would need more than
+       * max_bytes of memory, or for a sequence of recordings. Passing 0
+       * frees the cache. May be called while the flowgraph is running.
+       * @param max_bytes the most memory the cache may use
+       * @return true if the recording is now played from memory
+       */
+      virtual bool set_repeat_cache(size_t max_bytes) = 0;
+
+      /*!
+       * \brief Play a quick preview of the recording by skipping most of it
+       *
+       * Reads block_size samples, then skips the next stride - 1 blocks,
+       * so only 1/stride of the file is read. Tags in skipped blocks are
+       * put on the first sample after them, and rx_rate tags are divided
+       * by stride so downstream rates stay about right. A stride of 1
+       * plays everything. May be called while the flowgraph is running.
+       * @param stride play one block out of every stride
+       * @param block_size samples in a block
+       */
+      virtual void set_preview(size_t stride, size_t block_size = 1024) = 0;
+
+      /*!
+       * \brief Output samples as in * scale + offset, in place of the
+       * default scaling
+       *
+       * By default integer samples are divided by the max value of their
+       * type when played as floats, and floats are rounded as they are
+       * when played as integers, so normalized float recordings end up
+       * as -1, 0 or 1. With a scale set, each sample is multiplied and
+       * offset as it is converted, rounding and saturating integer
+       * outputs, with no extra pass over the data. Unsigned samples have
+       * their offset binary removed before scaling.
+       *
+       * If this isn't called and the output type is floating point,
+       * gr_sigmf:scale and gr_sigmf:offset from the global metadata are
+       * used if the recording has them. May be called while the flowgraph
+       * is running.
+       * @param scale multiplies each sample
+       * @param offset added after scaling
+       */
+      virtual void set_scale(double scale, double offset = 0) = 0;
+
+      /*!
+       * \brief Release samples in realtime at the recording's sample rate
+       *
+       * When paced, samples are released against a monotonic clock at
+       * core:sample_rate rather than as fast as downstream blocks will
+       * take them, at most max_burst samples at a time. This replaces a
+       * throttle block when replaying into something that expects a
+       * live receiver. rx_time tags are advanced on each repeat so time
+       * keeps moving forward. If playback falls more than a second
+       * behind, the clock is reset rather than bursting to catch up.
+       * Each recording in a sequence plays at its own sample rate.
+       *
+       * Throws if the recording has no core:sample_rate.
+       * @param paced whether to pace playback
+       * @param max_burst the most samples released at once
+       */
+      virtual void set_pacing(bool paced, int max_burst = 4096) = 0;
+
+      /*!
+       * \brief Statistics on how closely paced playback kept to the clock
+       *
+       * Returns a dict with the number of samples and bursts released,
+       * how many bursts were late, how many times the clock was reset,
+       * and the mean and max release error in seconds.
+       */
+      virtual pmt::pmt_t pacing_stats() = 0;
+
       /*!
        * \brief retrieve the global metadata for this source
        */
@@ -0,0 +1,62 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SIGMF_TRANSCODE_H
+#define INCLUDED_SIGMF_TRANSCODE_H
+
+#include <cstdint>
+#include <string>
+#include <sigmf/api.h>
+
+namespace gr {
+  namespace sigmf {
+
+    /*!
+     * \brief Convert a recording to another datatype, using several threads
+     *
+     * The data file is split into chunks of chunk_samples samples, which
+     * are read and converted in parallel and written out in order, with
+     * at most two chunks per thread in memory at once. Conversion is the
+     * same as the source block's, including a recording's gr_sigmf:scale
+     * when converting to floats.
+     *
+     * The metadata is copied with the new core:datatype. core:sha512 is
+     * dropped because the data changes, and so are gr_sigmf:scale and
+     * gr_sigmf:offset if they were applied.
+     *
+     * @param input_filename the recording to convert
+     * @param output_filename where to write the converted recording
+     * @param output_type the datatype to convert to
+     * @param num_threads threads to convert with, 0 for one per core
+     * @param chunk_samples samples converted at a time by each thread
+     * @exception std::runtime_error a file can't be read or written, or
+     * the types can't be converted
+     * @return the number of samples converted
+     */
+    uint64_t transcode(const std::string &input_filename,
+                       const std::string &output_filename,
+                       const std::string &output_type,
+                       size_t num_threads = 0,
+                       size_t chunk_samples = 1 << 20) SIGMF_API;
+
+  } // namespace sigmf
+} // namespace gr
+
+#endif /* INCLUDED_SIGMF_TRANSCODE_H */
@@ -0,0 +1,217 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SIGMF_TYPE_CONVERTER_H
+#define INCLUDED_SIGMF_TYPE_CONVERTER_H
+
+#include <memory>
+#include <string>
+#include <volk/volk.h>
+#include <sigmf/api.h>
+#include <sigmf/meta_namespace.h>
+#include <sigmf/sigmf_utils.h>
+
+namespace gr {
+  namespace sigmf {
+
+    //! Base sample types, without complexity or byte order
+    enum sample_type_t {
+      TYPE_F32 = 0,
+      TYPE_F64,
+      TYPE_I8,
+      TYPE_I16,
+      TYPE_I32,
+      TYPE_I64,
+      TYPE_U8,
+      TYPE_U16,
+      TYPE_U32,
+      TYPE_U64,
+      NUM_SAMPLE_TYPES
+    };
+
+    /*!
+     * \brief Look up the sample type for a format_detail_t::type_str
+     * @exception std::runtime_error unsupported type
+     */
+    sample_type_t sample_type_from_str(const std::string &type_str) SIGMF_API;
+
+    //! size in bytes of one item of a sample type
+    size_t sample_type_size(sample_type_t type) SIGMF_API;
+
+    //! instruction set picked at runtime for the conversions VOLK has no
+    //! kernel for, e.g. "avx2"
+    std::string converter_isa() SIGMF_API;
+
+    //! Global metadata keys for the scale and offset that map a recording's
+    //! samples to physical units, as raw * scale + offset
+    static const char *const SCALE_META_KEY = "gr_sigmf:scale";
+    static const char *const OFFSET_META_KEY = "gr_sigmf:offset";
+
+    //! Frees memory from volk_malloc
+    struct volk_deleter {
+      void
+      operator()(char *p) const
+      {
+        volk_free(p);
+      }
+    };
+
+    //! Converts count items in memory, from in to out
+    typedef void (*convert_kernel_t)(char *out, const char *in, size_t count);
+
+    //! Converts count items to in * scale + offset, saturating integer outputs
+    typedef void (*scaled_kernel_t)(
+      char *out, const char *in, size_t count, double scale, double offset);
+
+    /*!
+     * \brief Converts items from one SigMF datatype to another, from one
+     * buffer to another
+     *
+     * Items are base units, so a complex sample is two items. The kernel
+     * for a pair of types is looked up once, when the converter is made,
+     * from a table generated at compile time. Unsigned types are offset
+     * binary and are converted by flipping their sign bits and using the
+     * kernel for the signed types of the same widths. Types that aren't
+     * in native byte order are byte swapped.
+     *
+     * The packed complex types ci4 and ci12 are unpacked to i8 and i16
+     * without scaling, and converted like those types, except that they
+     * are scaled by their own max value when converted to floats. Values
+     * saturate when they are packed. Counts for packed types must be even.
+     *
+     * By default integers are scaled by the max value of their type when
+     * converted to floats, but floats are converted to integers
+     * unscaled, only rounded and saturated, so floats in [-1, 1] come
+     * out as -1, 0 or 1. Make the converter with the integer type's max
+     * as the scale to go back to full scale. A converter made with a
+     * scale and offset produces in * scale + offset, rounding and
+     * saturating when the output is an integer, in a single pass. For
+     * unsigned inputs the scale applies after the offset binary has been
+     * removed, so the middle of the range is 0.
+     *
+     * Converters do no I/O, so the input can come from fread, a memory
+     * mapped file or another block. A converter is not thread safe, but
+     * separate converters for the same types can work on separate chunks
+     * of a buffer at the same time.
+     */
+    class SIGMF_API type_converter {
+      public:
+      //! A converter that copies items of one byte unchanged
+      type_converter();
+
+      /*!
+       * @exception std::runtime_error the types can't be converted
+       */
+      type_converter(const std::string &from_type, const std::string &to_type);
+
+      /*!
+       * \brief A converter that produces in * scale + offset
+       * @exception std::runtime_error the types can't be converted
+       */
+      type_converter(const std::string &from_type,
+                     const std::string &to_type,
+                     double scale,
+                     double offset);
+
+      //! size in bytes of count input items
+      size_t input_bytes(size_t count) const;
+
+      //! size in bytes of count output items
+      size_t output_bytes(size_t count) const;
+
+      //! number of whole input items in bytes
+      size_t input_items(size_t bytes) const;
+
+      //! true if conversion is at most a byte swap, so it can be done in place
+      bool is_identity() const;
+
+      /*!
+       * \brief Convert count items from in to out, leaving in unchanged
+       *
+       * in and out may be the same buffer if is_identity(). Otherwise
+       * they must not overlap. If the input needs byte swapping or sign
+       * flipping it is first copied to a scratch buffer, which is kept
+       * between calls.
+       */
+      void convert(char *out, const char *in, size_t count);
+
+      /*!
+       * \brief Convert count items from in to out, using in as scratch space
+       *
+       * Avoids the copy that convert() may need, for callers that own the
+       * input buffer, like a staging buffer that was just read into. The
+       * contents of in are undefined afterwards.
+       */
+      void convert_in_place(char *out, char *in, size_t count);
+
+      private:
+      convert_kernel_t d_kernel;
+      scaled_kernel_t d_scaled_kernel;
+      bool d_scaled;
+      double d_scale;
+      double d_offset;
+      // sizes of the unpacked types
+      size_t d_input_size;
+      size_t d_output_size;
+      size_t d_input_bits;
+      size_t d_output_bits;
+      // Bits per value of packed types, 0 if not packed
+      size_t d_in_packed;
+      size_t d_out_packed;
+      bool d_in_packed_be;
+      bool d_out_packed_be;
+      // Item sizes to flip sign bits or swap bytes for, 0 if not needed
+      size_t d_in_flip;
+      size_t d_out_flip;
+      size_t d_in_swap;
+      size_t d_out_swap;
+      // Types are the same except maybe for byte order
+      bool d_identity;
+
+      // Input after unpacking, swapping or flipping
+      std::unique_ptr<char, volk_deleter> d_temp_buf;
+      size_t d_allocated_size;
+      // Output before packing
+      std::unique_ptr<char, volk_deleter> d_pack_buf;
+      size_t d_pack_allocated_size;
+
+      void init(const std::string &from_type, const std::string &to_type);
+    };
+
+    /*!
+     * \brief true if a recording with this global metadata is converted
+     * with its gr_sigmf:scale and gr_sigmf:offset when played as to_type,
+     * which is when it has them and to_type is floating point
+     */
+    bool applies_recording_scale(const meta_namespace &global,
+                                 const std::string &to_type) SIGMF_API;
+
+    /*!
+     * \brief Make a converter from the core:datatype of a recording to
+     * to_type, in the recording's physical units if applies_recording_scale
+     * @exception std::runtime_error the types can't be converted
+     */
+    type_converter make_recording_converter(const meta_namespace &global,
+                                            const std::string &to_type) SIGMF_API;
+
+  } // namespace sigmf
+} // namespace gr
+
+#endif /* INCLUDED_SIGMF_TYPE_CONVERTER_H */
@@ -0,0 +1,176 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "sigmf/annotation_index.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace gr {
+  namespace sigmf {
+
+    namespace {
+      // One past the last sample an annotation covers
+      uint64_t
+      interval_end(uint64_t start, uint64_t count)
+      {
+        count = std::max<uint64_t>(count, 1);
+        if(start > std::numeric_limits<uint64_t>::max() - count) {
+          return std::numeric_limits<uint64_t>::max();
+        }
+        return start + count;
+      }
+
+      template <typename Segment>
+      annotation_index::interval
+      segment_interval(const Segment &segment, size_t index)
+      {
+        annotation_index::interval i = {0, 0, index};
+        if(!segment.try_get(meta_key::SAMPLE_START, i.sample_start)) {
+          throw std::runtime_error(
+            "Invalid metadata, no core:sample_start found for annotation");
+        }
+        segment.try_get(meta_key::SAMPLE_COUNT, i.sample_count);
+        return i;
+      }
+    } // namespace
+
+    annotation_index::annotation_index()
+    {
+    }
+
+    annotation_index::annotation_index(const std::vector<meta_namespace> &annotations)
+    {
+      std::vector<interval> intervals;
+      intervals.reserve(annotations.size());
+      for(size_t i = 0; i < annotations.size(); i++) {
+        intervals.push_back(segment_interval(annotations[i], i));
+      }
+      build(intervals);
+    }
+
+    annotation_index::annotation_index(const arena_segments &annotations)
+    {
+      std::vector<interval> intervals;
+      intervals.reserve(annotations.size());
+      for(size_t i = 0; i < annotations.size(); i++) {
+        intervals.push_back(segment_interval(annotations[i], i));
+      }
+      build(intervals);
+    }
+
+    annotation_index::annotation_index(std::vector<interval> intervals)
+    {
+      build(intervals);
+    }
+
+    void
+    annotation_index::build(std::vector<interval> &intervals)
+    {
+      // Usually in order already, as they are in a metadata file
+      auto by_start = [](const interval &a, const interval &b) {
+        return a.sample_start < b.sample_start ||
+               (a.sample_start == b.sample_start && a.index < b.index);
+      };
+      if(!std::is_sorted(intervals.begin(), intervals.end(), by_start)) {
+        std::sort(intervals.begin(), intervals.end(), by_start);
+      }
+
+      size_t n = intervals.size();
+      d_starts.resize(n);
+      d_ends.resize(n);
+      d_max_ends.resize(n);
+      d_indices.resize(n);
+      for(size_t i = 0; i < n; i++) {
+        d_starts[i] = intervals[i].sample_start;
+        d_ends[i] = interval_end(intervals[i].sample_start, intervals[i].sample_count);
+        d_indices[i] = intervals[i].index;
+      }
+      build_max_ends(0, n);
+    }
+
+    uint64_t
+    annotation_index::build_max_ends(size_t lo, size_t hi)
+    {
+      if(lo >= hi) {
+        return 0;
+      }
+      size_t mid = lo + (hi - lo) / 2;
+      uint64_t max_end = std::max(build_max_ends(lo, mid), build_max_ends(mid + 1, hi));
+      max_end = std::max(max_end, d_ends[mid]);
+      d_max_ends[mid] = max_end;
+      return max_end;
+    }
+
+    void
+    annotation_index::query(size_t lo,
+                            size_t hi,
+                            uint64_t start,
+                            uint64_t end,
+                            std::vector<size_t> &out) const
+    {
+      while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        // Everything below here ends before the range
+        if(d_max_ends[mid] <= start) {
+          return;
+        }
+        query(lo, mid, start, end, out);
+        // This and everything after it start after the range
+        if(d_starts[mid] >= end) {
+          return;
+        }
+        if(d_ends[mid] > start) {
+          out.push_back(d_indices[mid]);
+        }
+        lo = mid + 1;
+      }
+    }
+
+    void
+    annotation_index::overlapping(uint64_t start,
+                                  uint64_t end,
+                                  std::vector<size_t> &out) const
+    {
+      if(start < end) {
+        query(0, d_starts.size(), start, end, out);
+      }
+    }
+
+    std::vector<size_t>
+    annotation_index::overlapping(uint64_t start, uint64_t end) const
+    {
+      std::vector<size_t> out;
+      overlapping(start, end, out);
+      return out;
+    }
+
+    std::vector<size_t>
+    annotation_index::at(uint64_t sample) const
+    {
+      std::vector<size_t> out;
+      if(sample < std::numeric_limits<uint64_t>::max()) {
+        query(0, d_starts.size(), sample, sample + 1, out);
+      }
+      return out;
+    }
+
+  } // namespace sigmf
+} // namespace gr
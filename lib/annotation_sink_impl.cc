@@ -29,13 +29,53 @@
 #include "writer_utils.h"
 #include "reader_utils.h"
 #include "pmt_utils.h"
+#include "metafile_layout.h"
 #include "annotation_sink_impl.h"
+#include <boost/filesystem/operations.hpp>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
+namespace fs = boost::filesystem;
 namespace posix = boost::posix_time;
 
 namespace gr {
   namespace sigmf {
 
+    namespace {
+      // Read a sample index from a message value that's either a uint64
+      // or a non-negative integer
+      bool
+      message_index(const pmt::pmt_t &val, uint64_t &out)
+      {
+        if(pmt::is_uint64(val)) {
+          out = pmt::to_uint64(val);
+          return true;
+        }
+        if(pmt::is_integer(val) && pmt::to_long(val) >= 0) {
+          out = pmt::to_long(val);
+          return true;
+        }
+        return false;
+      }
+
+#ifndef _WIN32
+      // Whether a file's inode, size and modification time are unchanged
+      bool
+      same_file_state(const struct stat &a, const struct stat &b)
+      {
+        if(a.st_ino != b.st_ino || a.st_size != b.st_size || a.st_mtime != b.st_mtime) {
+          return false;
+        }
+#ifdef __APPLE__
+        return a.st_mtimespec.tv_nsec == b.st_mtimespec.tv_nsec;
+#else
+        return a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+#endif
+      }
+#endif
+    } // namespace
+
     annotation_sink::sptr
     annotation_sink::make(std::string filename, annotation_mode mode, sigmf_time_mode time_mode)
     {
@@ -52,7 +92,8 @@ namespace gr {
                      gr::io_signature::make(0, 0, 0)),
       d_filter_strategy(mode.filter_strategy), d_filter_key_regex(glob_to_regex(mode.filter_key)),
       d_data_path(to_data_path(filename)), d_meta_path(meta_path_from_data(d_data_path)),
-      d_sample_rate(-1), d_time_mode(time_mode)
+      d_sample_rate(-1), d_time_mode(time_mode), d_loaded_annotations(0),
+      d_loaded_modified(false), d_can_append(false), d_last_loaded_start(0)
     {
       message_port_register_in(pmt::mp("annotations"));
       set_msg_handler(pmt::mp("annotations"),
@@ -142,33 +183,34 @@ namespace gr {
       if(!pmt::eqv(sample_start_pmt, pmt::get_PMT_NIL()) &&
          !pmt::eqv(sample_count_pmt, pmt::get_PMT_NIL())) {
         bool found_match = false;
+        // sample_counts and sample_starts received in messages might be integers even though
+        // they should be uint64s, so read them as numbers once rather than per annotation
+        uint64_t msg_start = 0;
+        uint64_t msg_count = 0;
+        bool start_is_number = message_index(sample_start_pmt, msg_start);
+        bool count_is_number = message_index(sample_count_pmt, msg_count);
         for(auto &anno : d_annotations) {
-
-          // sample_counts and sample_starts received in messages might be integers even though
-          // they should be uint64s, so we have to handle that case here
           bool start_equal = false;
           bool count_equal = false;
-          if (pmt::is_integer(sample_start_pmt)) {
-            int64_t temp = pmt::to_long(sample_start_pmt);
-            if (temp >= 0) {
-              uint64_t native_start = pmt::to_uint64(anno.get(SAMPLE_START_KEY));
-              start_equal = static_cast<uint64_t>(temp) == native_start;
-            }
+          uint64_t anno_val;
+          if (start_is_number) {
+            start_equal =
+              anno.try_get(meta_key::SAMPLE_START, anno_val) && anno_val == msg_start;
           } else {
             start_equal = pmt::eqv(anno.get(SAMPLE_START_KEY), sample_start_pmt);
           }
-          if (pmt::is_integer(sample_count_pmt)) {
-            int64_t temp = pmt::to_long(sample_count_pmt);
-            if (temp >= 0) {
-              uint64_t native_count = pmt::to_uint64(anno.get(SAMPLE_COUNT_KEY));
-              count_equal = static_cast<uint64_t>(temp) == native_count;
-            }
+          if (count_is_number) {
+            count_equal =
+              anno.try_get(meta_key::SAMPLE_COUNT, anno_val) && anno_val == msg_count;
           } else {
             count_equal = pmt::eqv(anno.get(SAMPLE_COUNT_KEY), sample_count_pmt);
           }
 
           if(start_equal && count_equal) {
             found_match = true;
+            if(static_cast<size_t>(&anno - d_annotations.data()) < d_loaded_annotations) {
+              d_loaded_modified = true;
+            }
             // Get all the keys from the message
             pmt::pmt_t keys = pmt::dict_keys(annotation_msg);
             for (size_t i = 0; i < pmt::length(keys); i++) {
@@ -189,10 +231,13 @@ namespace gr {
     void
     annotation_sink_impl::load_metadata()
     {
-      metafile_namespaces ns = load_metafile(d_meta_fp);
+      metafile_namespaces ns = load_metafile(d_meta_fp, 0, d_loaded_end);
       d_global = ns.global;
       d_captures = ns.captures;
       d_annotations = ns.annotations;
+      d_loaded_annotations = d_annotations.size();
+      d_loaded_modified = false;
+      check_appendable();
 
       if (d_filter_strategy == annotation_filter_strategy::clear_existing) {
         for(meta_namespace &anno_ns: d_annotations) {
@@ -203,6 +248,7 @@ namespace gr {
             if (std::regex_match(key, m, d_filter_key_regex)) {
               // then we keep will drop it
               anno_ns.del(key);
+              d_loaded_modified = true;
             }
           }
         }
@@ -214,7 +260,10 @@ namespace gr {
 
       if (d_time_mode == sigmf_time_mode::absolute) {
         // need to get start time
-        pmt::pmt_t start_time = d_captures[0].get("core:datetime", pmt::get_PMT_NIL());
+        pmt::pmt_t start_time = pmt::get_PMT_NIL();
+        if (d_captures.size() > 0) {
+          start_time = d_captures[0].get("core:datetime", pmt::get_PMT_NIL());
+        }
         if (pmt::is_null(start_time)) {
           throw std::runtime_error("Can't use absolute mode if datetime not set!");
         } else {
@@ -226,13 +275,147 @@ namespace gr {
       }
     }
 
+    void
+    annotation_sink_impl::check_appendable()
+    {
+      d_can_append = false;
+      // The loaded annotations have to be in the order writing puts them in
+      d_last_loaded_start = 0;
+      if(d_loaded_end.num_arrays != 1 || d_loaded_end.count != d_annotations.size()) {
+        return;
+      }
+      for(const meta_namespace &anno : d_annotations) {
+        uint64_t start;
+        if(!anno.try_get(meta_key::SAMPLE_START, start) || start < d_last_loaded_start) {
+          return;
+        }
+        d_last_loaded_start = start;
+      }
+      d_can_append = fstat(fileno(d_meta_fp), &d_loaded_stat) == 0;
+    }
+
+    bool
+    annotation_sink_impl::read_after_annotations(FILE *fp, std::string &after_annotations)
+    {
+      // Only the end of the file is read, from the annotations array's ']'
+      size_t length = d_loaded_stat.st_size - d_loaded_end.close;
+      std::vector<char> tail(length);
+      if(std::fseek(fp, d_loaded_end.close, SEEK_SET) != 0 ||
+         std::fread(tail.data(), 1, length, fp) != length || tail.empty() || tail[0] != ']') {
+        return false;
+      }
+      after_annotations.assign(tail.data() + 1, length - 1);
+      return true;
+    }
+
     void
     annotation_sink_impl::write_metadata() {
-      // Blow away whatever was there
-      d_meta_fp = std::fopen(d_meta_path.c_str(), "w");
-      // Write over it with our new meta
-      writer_utils::write_meta_to_fp(d_meta_fp, d_global, d_captures, d_annotations);
-      std::fclose(d_meta_fp);
+      if(!append_metadata()) {
+        replace_metadata();
+      }
+      // The file doesn't match what was loaded anymore
+      d_can_append = false;
+    }
+
+    bool
+    annotation_sink_impl::append_metadata()
+    {
+#ifdef _WIN32
+      // No ftruncate, so the whole file is rewritten
+      return false;
+#else
+      if(!d_can_append || d_loaded_modified) {
+        return false;
+      }
+      for(size_t i = d_loaded_annotations; i < d_annotations.size(); i++) {
+        uint64_t start;
+        if(!d_annotations[i].try_get(meta_key::SAMPLE_START, start) ||
+           start < d_last_loaded_start) {
+          return false;
+        }
+      }
+      if(d_loaded_annotations == d_annotations.size()) {
+        // Nothing changed
+        return true;
+      }
+
+      FILE *fp = std::fopen(d_meta_path.c_str(), "r+");
+      if(fp == NULL) {
+        return false;
+      }
+      struct stat st;
+      if(fstat(fileno(fp), &st) != 0 || !same_file_state(st, d_loaded_stat)) {
+        std::fclose(fp);
+        GR_LOG_WARN(d_logger, "meta file changed since it was loaded, rewriting it");
+        return false;
+      }
+      std::string after_annotations;
+      if(!read_after_annotations(fp, after_annotations)) {
+        std::fclose(fp);
+        return false;
+      }
+      std::vector<meta_namespace> added(d_annotations.begin() + d_loaded_annotations,
+                                        d_annotations.end());
+      bool ok = std::fseek(fp, d_loaded_end.append_offset, SEEK_SET) == 0;
+      if(ok) {
+        writer_utils::write_annotations_tail(fp, added, d_loaded_annotations > 0);
+        std::fwrite(after_annotations.data(), 1, after_annotations.size(), fp);
+        ok = std::fflush(fp) == 0 && !std::ferror(fp) &&
+             ::ftruncate(fileno(fp), std::ftell(fp)) == 0;
+      }
+      std::fclose(fp);
+      if(!ok) {
+        // Everything is still in memory, so a whole new file fixes
+        // whatever was partly written
+        GR_LOG_WARN(d_logger, "failed to append to meta file, rewriting it");
+      }
+      return ok;
+#endif
+    }
+
+    void
+    annotation_sink_impl::replace_metadata()
+    {
+      // If the meta file is a symlink, replace the file it points to
+      // rather than the link
+      fs::path target = d_meta_path;
+      boost::system::error_code ec;
+      if(fs::is_symlink(d_meta_path, ec)) {
+        fs::path resolved = fs::canonical(d_meta_path, ec);
+        if(!ec) {
+          target = resolved;
+        }
+      }
+
+      // Write a new file next to the old one and swap it in, so the
+      // metadata is never left half written
+      std::string temp_path = writer_utils::unique_temp_path(target.string());
+      FILE *fp = std::fopen(temp_path.c_str(), "w");
+      if(fp == NULL) {
+        std::stringstream s;
+        s << "failed to open meta file " << temp_path << ", errno = " << errno << std::endl;
+        throw std::runtime_error(s.str());
+      }
+#ifndef _WIN32
+      struct stat st;
+      if(::stat(target.c_str(), &st) == 0) {
+        ::fchmod(fileno(fp), st.st_mode & 07777);
+      }
+#endif
+      writer_utils::write_meta_to_fp(fp, d_global, d_captures, d_annotations);
+      bool ok = std::fflush(fp) == 0 && !std::ferror(fp);
+      std::fclose(fp);
+      if(ok) {
+        // Unlike std::rename, this replaces an existing file on Windows too
+        fs::rename(temp_path, target, ec);
+        ok = !ec;
+      }
+      if(!ok) {
+        std::remove(temp_path.c_str());
+        std::stringstream s;
+        s << "failed to write meta file, errno = " << errno << std::endl;
+        throw std::runtime_error(s.str());
+      }
     }
 
     std::regex
@@ -24,6 +24,8 @@
 #include <sigmf/annotation_sink.h>
 #include <pmt/pmt.h>
 #include <regex>
+#include <sys/stat.h>
+#include "metafile_layout.h"
 
 namespace gr {
   namespace sigmf {
@@ -53,13 +55,31 @@ namespace gr {
       // Start time as uhd time tuple
       pmt::pmt_t d_start_time;
 
+      // Annotations [0, d_loaded_annotations) came from the meta file. If
+      // none of them change and new ones sort after them, the new ones
+      // are written into the file where its annotations array ends
+      // instead of rewriting the whole file.
+      size_t d_loaded_annotations;
+      bool d_loaded_modified;
+      bool d_can_append;
+      uint64_t d_last_loaded_start;
+      // To tell if the file changed since it was loaded
+      struct stat d_loaded_stat;
+      // Where the loaded annotations array ends, found while loading
+      annotations_end d_loaded_end;
+
       std::regex glob_to_regex(const std::string &filter_glob);
 
       void add_annotation(pmt::pmt_t annotation_msg);
 
       void write_metadata();
+      bool append_metadata();
+      void replace_metadata();
       bool open();
       void load_metadata();
+      void check_appendable();
+      // Everything after the annotations array of the file as it was loaded
+      bool read_after_annotations(FILE *fp, std::string &after_annotations);
 
       public:
       annotation_sink_impl(std::string filename, annotation_mode mode, sigmf_time_mode time_mode);
@@ -0,0 +1,330 @@
+#include "annotation_stream.h"
+#include "pmt_sax_handler.h"
+#include <stdexcept>
+#include <string>
+#include <rapidjson/reader.h>
+
+namespace gr {
+  namespace sigmf {
+
+    namespace {
+      /**
+       * Handles the top level object of a metadata file. Values under
+       * each top level key are built with a pmt_sax_handler, and parsing
+       * stops as soon as the annotations array is opened.
+       */
+      class header_handler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, header_handler> {
+        public:
+        header_handler()
+        : d_depth(0), d_at_annotations(false), d_has_global(false), d_has_captures(false)
+        {
+        }
+
+        bool
+        Null()
+        {
+          return d_depth > 0 && d_value.Null() && collect();
+        }
+
+        bool
+        Bool(bool b)
+        {
+          return d_depth > 0 && d_value.Bool(b) && collect();
+        }
+
+        bool
+        Int(int i)
+        {
+          return d_depth > 0 && d_value.Int(i) && collect();
+        }
+
+        bool
+        Uint(unsigned u)
+        {
+          return d_depth > 0 && d_value.Uint(u) && collect();
+        }
+
+        bool
+        Int64(int64_t i)
+        {
+          return d_depth > 0 && d_value.Int64(i) && collect();
+        }
+
+        bool
+        Uint64(uint64_t u)
+        {
+          return d_depth > 0 && d_value.Uint64(u) && collect();
+        }
+
+        bool
+        Double(double d)
+        {
+          return d_depth > 0 && d_value.Double(d) && collect();
+        }
+
+        bool
+        String(const char *str, rapidjson::SizeType length, bool copy)
+        {
+          return d_depth > 0 && d_value.String(str, length, copy) && collect();
+        }
+
+        bool
+        StartObject()
+        {
+          d_depth++;
+          if(d_depth == 1) {
+            // the root object
+            return true;
+          }
+          return d_value.StartObject();
+        }
+
+        bool
+        Key(const char *str, rapidjson::SizeType length, bool copy)
+        {
+          if(d_depth == 1) {
+            d_section.assign(str, length);
+            d_value.reset();
+            return true;
+          }
+          return d_value.Key(str, length, copy);
+        }
+
+        bool
+        EndObject(rapidjson::SizeType member_count)
+        {
+          d_depth--;
+          if(d_depth == 0) {
+            return true;
+          }
+          return d_value.EndObject(member_count) && collect();
+        }
+
+        bool
+        StartArray()
+        {
+          if(d_depth == 0) {
+            // root must be an object
+            return false;
+          }
+          if(d_depth == 1 && d_section == "annotations") {
+            d_at_annotations = true;
+            return false;
+          }
+          d_depth++;
+          return d_value.StartArray();
+        }
+
+        bool
+        EndArray(rapidjson::SizeType element_count)
+        {
+          d_depth--;
+          return d_value.EndArray(element_count) && collect();
+        }
+
+        bool
+        at_annotations() const
+        {
+          return d_at_annotations;
+        }
+
+        bool
+        has_global() const
+        {
+          return d_has_global;
+        }
+
+        bool
+        has_captures() const
+        {
+          return d_has_captures;
+        }
+
+        meta_namespace global;
+        std::vector<meta_namespace> captures;
+
+        private:
+        int d_depth;
+        bool d_at_annotations;
+        bool d_has_global;
+        bool d_has_captures;
+        std::string d_section;
+        pmt_sax_handler d_value;
+
+        // Store the value for the current section once it's complete
+        bool
+        collect()
+        {
+          if(d_depth != 1 || !d_value.complete()) {
+            return true;
+          }
+          pmt::pmt_t val = d_value.result();
+          if(d_section == "global") {
+            global = meta_namespace(val);
+            d_has_global = true;
+          } else if(d_section == "captures") {
+            captures.clear();
+            if(pmt::is_vector(val)) {
+              for(size_t i = 0; i < pmt::length(val); i++) {
+                captures.push_back(meta_namespace(pmt::vector_ref(val, i)));
+              }
+            }
+            d_has_captures = true;
+          }
+          d_value.reset();
+          return true;
+        }
+      };
+    } // namespace
+
+    annotation_stream::annotation_stream(FILE *fp, const std::string &meta_path)
+    : d_fp(fp), d_buffer(65536), d_annotations_offset(-1), d_base_offset(0), d_streaming(true),
+      d_done(true), d_loaded_index(0), d_index_next(NULL)
+    {
+      if(!meta_path.empty()) {
+        d_index = meta_index::open(meta_path);
+      }
+      if(!d_index || !load_from_index()) {
+        d_index.reset();
+        parse_header();
+      }
+    }
+
+    bool
+    annotation_stream::load_from_index()
+    {
+      try {
+        d_global = meta_index::load(d_fp, d_index->global());
+        d_captures.clear();
+        for(const meta_index::entry *e = d_index->captures_begin(); e != d_index->captures_end();
+            ++e) {
+          d_captures.push_back(meta_index::load(d_fp, *e));
+        }
+      } catch(const std::runtime_error &) {
+        // Parse the JSON instead
+        return false;
+      }
+      d_index_next = d_index->annotations_begin();
+      return true;
+    }
+
+    void
+    annotation_stream::parse_header()
+    {
+      seek(0);
+      header_handler handler;
+      rapidjson::Reader reader;
+      reader.Parse(*d_stream, handler);
+
+      if(handler.at_annotations() && handler.has_global() && handler.has_captures()) {
+        // The common case, the stream is now just past the '[' of the annotations
+        d_global = handler.global;
+        d_captures = handler.captures;
+        d_annotations_offset = d_base_offset + d_stream->Tell();
+        d_done = false;
+      } else if(handler.at_annotations()) {
+        // Annotations come before something we need, so there is no way
+        // around reading the whole thing
+        d_streaming = false;
+        std::fseek(d_fp, 0, SEEK_SET);
+        metafile_namespaces ns = load_metafile(d_fp);
+        d_global = ns.global;
+        d_captures = ns.captures;
+        d_loaded_annotations = ns.annotations;
+      } else if(reader.HasParseError() || !handler.has_global()) {
+        throw std::runtime_error("Meta namespace parse error - invalid metadata.");
+      } else {
+        // No annotations in this file
+        d_global = handler.global;
+        d_captures = handler.captures;
+      }
+    }
+
+    const meta_namespace &
+    annotation_stream::global() const
+    {
+      return d_global;
+    }
+
+    const std::vector<meta_namespace> &
+    annotation_stream::captures() const
+    {
+      return d_captures;
+    }
+
+    bool
+    annotation_stream::next(meta_namespace &annotation)
+    {
+      if(d_index) {
+        if(d_index_next == d_index->annotations_end()) {
+          return false;
+        }
+        annotation = meta_index::load(d_fp, *d_index_next++);
+        return true;
+      }
+      if(!d_streaming) {
+        if(d_loaded_index < d_loaded_annotations.size()) {
+          annotation = d_loaded_annotations[d_loaded_index++];
+          return true;
+        }
+        return false;
+      }
+      if(d_done) {
+        return false;
+      }
+
+      skip_whitespace();
+      if(d_stream->Peek() == ',') {
+        d_stream->Take();
+        skip_whitespace();
+      }
+      if(d_stream->Peek() == ']') {
+        d_done = true;
+        return false;
+      }
+
+      // Parse exactly one element of the array, leaving the stream
+      // right after it
+      d_handler.reset();
+      rapidjson::Reader reader;
+      reader.Parse<rapidjson::kParseStopWhenDoneFlag>(*d_stream, d_handler);
+      if(reader.HasParseError() || !d_handler.complete()) {
+        throw std::runtime_error("Meta namespace parse error - invalid annotation.");
+      }
+      annotation = d_handler.take();
+      return true;
+    }
+
+    void
+    annotation_stream::rewind()
+    {
+      if(d_index) {
+        d_index_next = d_index->annotations_begin();
+      } else if(!d_streaming) {
+        d_loaded_index = 0;
+      } else if(d_annotations_offset >= 0) {
+        seek(d_annotations_offset);
+        d_done = false;
+      }
+    }
+
+    void
+    annotation_stream::seek(long offset)
+    {
+      std::fseek(d_fp, offset, SEEK_SET);
+      d_base_offset = offset;
+      d_stream.reset(new rapidjson::FileReadStream(d_fp, d_buffer.data(), d_buffer.size()));
+    }
+
+    void
+    annotation_stream::skip_whitespace()
+    {
+      char c = d_stream->Peek();
+      while(c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+        d_stream->Take();
+        c = d_stream->Peek();
+      }
+    }
+
+  } // namespace sigmf
+} // namespace gr
@@ -0,0 +1,89 @@
+#ifndef INCLUDED_SIGMF_ANNOTATION_STREAM_H
+#define INCLUDED_SIGMF_ANNOTATION_STREAM_H
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sigmf/meta_namespace.h>
+#include <rapidjson/filereadstream.h>
+#include "meta_index.h"
+#include "meta_sax_handler.h"
+
+/**
+ * Incremental reader for .sigmf-meta files
+ */
+namespace gr {
+  namespace sigmf {
+
+    /**
+     * Reads the global object and capture segments of a metadata file
+     * up front, then hands out annotations one at a time as they are
+     * requested, so the cost of opening a file does not depend on how
+     * many annotations it has.
+     *
+     * Annotations are parsed straight from the file with a SAX handler,
+     * one element of the annotations array per call to next(). If the
+     * file has the annotations array before the global object or the
+     * captures array, the whole file is loaded instead and annotations
+     * are handed out from memory.
+     *
+     * If meta_path is given and the file has a meta_index, global and
+     * captures are read from the byte ranges it records, and annotations
+     * are handed out in order of sample_start rather than file order.
+     *
+     * Does not take ownership of fp.
+     */
+    class annotation_stream {
+      public:
+      explicit annotation_stream(FILE *fp, const std::string &meta_path = "");
+
+      const meta_namespace &global() const;
+      const std::vector<meta_namespace> &captures() const;
+
+      /**
+       * Read the next annotation in file order.
+       * Returns false once all annotations have been read.
+       */
+      bool next(meta_namespace &annotation);
+
+      /**
+       * Go back to the first annotation
+       */
+      void rewind();
+
+      private:
+      FILE *d_fp;
+      std::vector<char> d_buffer;
+      std::unique_ptr<rapidjson::FileReadStream> d_stream;
+
+      // byte offset of the first character after the opening '['
+      // of the annotations array, or -1 if there is nothing to stream
+      long d_annotations_offset;
+      // byte offset d_stream was started at
+      long d_base_offset;
+      bool d_streaming;
+      bool d_done;
+      meta_namespace_sax_handler d_handler;
+
+      meta_namespace d_global;
+      std::vector<meta_namespace> d_captures;
+
+      // only used if the file could not be streamed
+      std::vector<meta_namespace> d_loaded_annotations;
+      size_t d_loaded_index;
+
+      // only used if the file has an index
+      std::unique_ptr<meta_index> d_index;
+      const meta_index::entry *d_index_next;
+
+      void parse_header();
+      bool load_from_index();
+      void seek(long offset);
+      void skip_whitespace();
+    };
+
+  } // namespace sigmf
+} // namespace gr
+
+#endif /* INCLUDED_SIGMF_ANNOTATION_STREAM_H */
@@ -0,0 +1,255 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Times range and point queries on an annotation_index against scanning
+ * every annotation, and writes the results as JSON. The index is built
+ * from intervals directly, so the annotations themselves don't have to
+ * fit in memory.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <rapidjson/filewritestream.h>
+#include <rapidjson/prettywriter.h>
+#include <sigmf/annotation_index.h>
+
+namespace po = boost::program_options;
+
+using namespace gr::sigmf;
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  // Samples between annotation starts, on average
+  const uint64_t SPACING = 1000;
+
+  struct result {
+    std::string query;
+    std::string impl;
+    size_t queries;
+    size_t matches;
+    double seconds;
+  };
+
+  // Mostly short bursts, with the occasional long annotation spanning
+  // thousands of others, like a detector and a recording-wide label
+  std::vector<annotation_index::interval>
+  make_intervals(size_t num_annotations, std::mt19937_64 &rng)
+  {
+    std::uniform_int_distribution<uint64_t> jitter(0, SPACING - 1);
+    std::uniform_int_distribution<uint64_t> burst(0, 2 * SPACING);
+    std::uniform_int_distribution<uint64_t> long_count(0, 10000 * SPACING);
+    std::vector<annotation_index::interval> intervals;
+    intervals.reserve(num_annotations);
+    for(size_t i = 0; i < num_annotations; i++) {
+      uint64_t count = i % 10000 == 0 ? long_count(rng) : burst(rng);
+      intervals.push_back({i * SPACING + jitter(rng), count, i});
+    }
+    return intervals;
+  }
+
+  size_t
+  scan(const std::vector<annotation_index::interval> &intervals,
+       uint64_t start,
+       uint64_t end,
+       std::vector<size_t> &out)
+  {
+    for(const annotation_index::interval &i : intervals) {
+      uint64_t i_end = i.sample_start + std::max<uint64_t>(i.sample_count, 1);
+      if(i.sample_start < end && i_end > start) {
+        out.push_back(i.index);
+      }
+    }
+    return out.size();
+  }
+
+  template <typename Query>
+  result
+  run(const std::string &query,
+      const std::string &impl,
+      const std::vector<std::pair<uint64_t, uint64_t>> &ranges,
+      size_t num_queries,
+      Query q)
+  {
+    std::vector<size_t> out;
+    size_t matches = 0;
+    clock_type::time_point start = clock_type::now();
+    for(size_t i = 0; i < num_queries; i++) {
+      out.clear();
+      matches += q(ranges[i].first, ranges[i].second, out);
+    }
+    double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    return {query, impl, num_queries, matches, seconds};
+  }
+
+  template <typename Writer>
+  void
+  write_result(Writer &writer, const result &r)
+  {
+    writer.StartObject();
+    writer.Key("query");
+    writer.String(r.query.c_str());
+    writer.Key("impl");
+    writer.String(r.impl.c_str());
+    writer.Key("queries");
+    writer.Uint64(r.queries);
+    writer.Key("matches");
+    writer.Uint64(r.matches);
+    writer.Key("seconds");
+    writer.Double(r.seconds);
+    writer.Key("microseconds_per_query");
+    writer.Double(r.seconds * 1e6 / r.queries);
+    writer.EndObject();
+  }
+} // namespace
+
+int
+main(int argc, char *argv[])
+{
+  size_t num_annotations;
+  size_t num_queries;
+  size_t num_linear_queries;
+  uint64_t window;
+  std::string output;
+
+  po::options_description desc("Benchmark annotation_index queries");
+  desc.add_options()
+    ("help,h", "Show this message")
+    ("annotations", po::value<size_t>(&num_annotations)->default_value(10000000),
+     "Annotations to index")
+    ("queries", po::value<size_t>(&num_queries)->default_value(100000),
+     "Queries of each kind to time on the index")
+    ("linear-queries", po::value<size_t>(&num_linear_queries)->default_value(20),
+     "Queries of each kind to time by scanning every annotation")
+    ("window", po::value<uint64_t>(&window)->default_value(100000),
+     "Samples in each range query")
+    ("output,o", po::value<std::string>(&output), "File to write JSON to. Default stdout");
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch(const po::error &e) {
+    std::cerr << e.what() << std::endl << desc << std::endl;
+    return 1;
+  }
+  if(vm.count("help")) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  if(num_annotations == 0 || num_queries == 0 || window == 0) {
+    std::cerr << "--annotations, --queries and --window must be positive" << std::endl;
+    return 1;
+  }
+  num_linear_queries = std::min(num_linear_queries, num_queries);
+
+  std::mt19937_64 rng(12345);
+  std::vector<annotation_index::interval> intervals = make_intervals(num_annotations, rng);
+
+  clock_type::time_point start = clock_type::now();
+  annotation_index index(intervals);
+  double build_seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+  std::uniform_int_distribution<uint64_t> position(0, num_annotations * SPACING);
+  std::vector<std::pair<uint64_t, uint64_t>> ranges;
+  std::vector<std::pair<uint64_t, uint64_t>> points;
+  for(size_t i = 0; i < num_queries; i++) {
+    uint64_t s = position(rng);
+    ranges.push_back(std::make_pair(s, s + window));
+    s = position(rng);
+    points.push_back(std::make_pair(s, s + 1));
+  }
+
+  auto indexed = [&index](uint64_t s, uint64_t e, std::vector<size_t> &out) {
+    index.overlapping(s, e, out);
+    return out.size();
+  };
+  auto indexed_point = [&index](uint64_t s, uint64_t, std::vector<size_t> &out) {
+    out = index.at(s);
+    return out.size();
+  };
+  auto linear = [&intervals](uint64_t s, uint64_t e, std::vector<size_t> &out) {
+    return scan(intervals, s, e, out);
+  };
+
+  std::vector<result> results;
+  results.push_back(run("range", "index", ranges, num_queries, indexed));
+  results.push_back(run("range", "linear", ranges, num_linear_queries, linear));
+  results.push_back(run("point", "index", points, num_queries, indexed_point));
+  results.push_back(run("point", "linear", points, num_linear_queries, linear));
+
+  // Both ways have to find the same annotations
+  for(size_t i = 0; i < num_linear_queries; i++) {
+    std::vector<size_t> expected;
+    std::vector<size_t> found;
+    for(const auto &r : {ranges[i], points[i]}) {
+      expected.clear();
+      scan(intervals, r.first, r.second, expected);
+      found = index.overlapping(r.first, r.second);
+      std::sort(found.begin(), found.end());
+      if(found != expected) {
+        std::cerr << "Index and scan disagree on [" << r.first << ", " << r.second << ")"
+                  << std::endl;
+        return 1;
+      }
+    }
+  }
+
+  FILE *fp = stdout;
+  if(!output.empty()) {
+    fp = std::fopen(output.c_str(), "w");
+    if(fp == NULL) {
+      std::cerr << "Unable to open output file " << output << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<char> write_buffer(65536);
+  rapidjson::FileWriteStream stream(fp, write_buffer.data(), write_buffer.size());
+  rapidjson::PrettyWriter<rapidjson::FileWriteStream> writer(stream);
+  writer.StartObject();
+  writer.Key("annotations");
+  writer.Uint64(num_annotations);
+  writer.Key("window");
+  writer.Uint64(window);
+  writer.Key("build_seconds");
+  writer.Double(build_seconds);
+  writer.Key("results");
+  writer.StartArray();
+  for(const result &r : results) {
+    write_result(writer, r);
+  }
+  writer.EndArray();
+  writer.EndObject();
+  stream.Put('\n');
+  stream.Flush();
+
+  if(fp != stdout) {
+    std::fclose(fp);
+  }
+  return 0;
+}
@@ -0,0 +1,206 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Measures how long loading a metadata file with many annotations takes
+ * with a range of thread counts, and writes the results as JSON.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <gnuradio/thread/thread.h>
+#include <rapidjson/filewritestream.h>
+#include <rapidjson/prettywriter.h>
+#include <sigmf/meta_namespace.h>
+#include "writer_utils.h"
+
+namespace po = boost::program_options;
+
+using namespace gr::sigmf;
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  struct result {
+    size_t threads;
+    size_t annotations;
+    double seconds;
+  };
+
+  struct file_closer {
+    void
+    operator()(FILE *fp) const
+    {
+      std::fclose(fp);
+    }
+  };
+
+  // Write a metadata file with annotations like a detector would make
+  std::unique_ptr<FILE, file_closer>
+  make_metafile(size_t num_annotations, bool pretty)
+  {
+    std::unique_ptr<FILE, file_closer> fp(std::tmpfile());
+    if(!fp) {
+      throw std::runtime_error("Unable to open a temporary file");
+    }
+    meta_namespace global = meta_namespace::build_global_object("cf32_le");
+    global.set("core:sample_rate", 10e6);
+    std::vector<meta_namespace> captures(1, meta_namespace::build_capture_segment(0));
+    std::vector<meta_namespace> annotations;
+    annotations.reserve(num_annotations);
+    for(size_t i = 0; i < num_annotations; i++) {
+      meta_namespace ns = meta_namespace::build_annotation_segment(i * 1000, 500);
+      ns.set("core:freq_lower_edge", 915e6 + (i % 64) * 25e3);
+      ns.set("core:freq_upper_edge", 915e6 + (i % 64 + 1) * 25e3);
+      ns.set("core:label", "burst");
+      pmt::pmt_t detail = pmt::make_dict();
+      detail = pmt::dict_add(detail, pmt::mp("snr"), pmt::from_double(12.5));
+      detail = pmt::dict_add(detail, pmt::mp("channel"), pmt::from_uint64(i % 64));
+      detail = pmt::dict_add(detail, pmt::mp("crc_ok"), pmt::PMT_T);
+      ns.set("bench:detail", detail);
+      annotations.push_back(std::move(ns));
+    }
+    writer_utils::write_meta_to_fp(fp.get(), global, captures, annotations, pretty);
+    std::fflush(fp.get());
+    return fp;
+  }
+
+  result
+  run(FILE *fp, size_t num_threads, size_t repeats)
+  {
+    double best = 0;
+    size_t num_annotations = 0;
+    for(size_t i = 0; i < repeats; i++) {
+      std::rewind(fp);
+      clock_type::time_point start = clock_type::now();
+      metafile_namespaces ns = load_metafile(fp, num_threads);
+      double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+      if(i == 0 || seconds < best) {
+        best = seconds;
+      }
+      num_annotations = ns.annotations.size();
+    }
+    return {num_threads, num_annotations, best};
+  }
+
+  template <typename Writer>
+  void
+  write_result(Writer &writer, const result &r, double single_thread_seconds)
+  {
+    writer.StartObject();
+    writer.Key("threads");
+    writer.Uint64(r.threads);
+    writer.Key("annotations");
+    writer.Uint64(r.annotations);
+    writer.Key("seconds");
+    writer.Double(r.seconds);
+    writer.Key("speedup");
+    writer.Double(single_thread_seconds / r.seconds);
+    writer.EndObject();
+  }
+} // namespace
+
+int
+main(int argc, char *argv[])
+{
+  size_t num_annotations;
+  size_t max_threads;
+  size_t repeats;
+  std::string output;
+
+  po::options_description desc("Benchmark loading metadata files with many annotations");
+  desc.add_options()
+    ("help,h", "Show this message")
+    ("annotations", po::value<size_t>(&num_annotations)->default_value(1000000),
+     "Annotations in the file")
+    ("threads", po::value<size_t>(&max_threads)->default_value(0),
+     "Most threads to load with, doubling from 1. Default one per core")
+    ("repeats", po::value<size_t>(&repeats)->default_value(3),
+     "Loads per thread count, the fastest is reported")
+    ("compact", "Write the file without pretty printing")
+    ("output,o", po::value<std::string>(&output), "File to write JSON to. Default stdout");
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch(const po::error &e) {
+    std::cerr << e.what() << std::endl << desc << std::endl;
+    return 1;
+  }
+  if(vm.count("help")) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  if(max_threads == 0) {
+    max_threads = std::max(1u, gr::thread::thread::hardware_concurrency());
+  }
+  repeats = std::max<size_t>(1, repeats);
+
+  std::unique_ptr<FILE, file_closer> meta_fp =
+    make_metafile(num_annotations, vm.count("compact") == 0);
+  std::fseek(meta_fp.get(), 0, SEEK_END);
+  long meta_bytes = std::ftell(meta_fp.get());
+
+  std::vector<result> results;
+  for(size_t threads = 1;; threads *= 2) {
+    threads = std::min(threads, max_threads);
+    results.push_back(run(meta_fp.get(), threads, repeats));
+    if(threads == max_threads) {
+      break;
+    }
+  }
+
+  FILE *fp = stdout;
+  if(!output.empty()) {
+    fp = std::fopen(output.c_str(), "w");
+    if(fp == NULL) {
+      std::cerr << "Unable to open output file " << output << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<char> write_buffer(65536);
+  rapidjson::FileWriteStream stream(fp, write_buffer.data(), write_buffer.size());
+  rapidjson::PrettyWriter<rapidjson::FileWriteStream> writer(stream);
+  writer.StartObject();
+  writer.Key("bytes");
+  writer.Int64(meta_bytes);
+  writer.Key("results");
+  writer.StartArray();
+  for(const result &r : results) {
+    write_result(writer, r, results[0].seconds);
+  }
+  writer.EndArray();
+  writer.EndObject();
+  stream.Put('\n');
+  stream.Flush();
+
+  if(fp != stdout) {
+    std::fclose(fp);
+  }
+  return 0;
+}
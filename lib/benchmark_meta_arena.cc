@@ -0,0 +1,330 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Measures the memory and time taken to hold and free many annotations
+ * as a vector of meta_namespace and as arena_segments, both built one at
+ * a time and loaded from a metadata file, and writes the results as
+ * JSON. Memory is the growth in resident set size once they're held,
+ * and the highest it got on the way there.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <rapidjson/filewritestream.h>
+#include <rapidjson/prettywriter.h>
+#include <sigmf/meta_arena.h>
+#include <sigmf/meta_namespace.h>
+#include <unistd.h>
+#include "writer_utils.h"
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace po = boost::program_options;
+
+using namespace gr::sigmf;
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  struct result {
+    std::string impl;
+    std::string source;
+    size_t annotations;
+    double build_seconds;
+    long rss_bytes;
+    long peak_rss_bytes;
+    double teardown_seconds;
+    long rss_after_teardown_bytes;
+  };
+
+  struct file_closer {
+    void
+    operator()(FILE *fp) const
+    {
+      std::fclose(fp);
+    }
+  };
+
+  long
+  rss_bytes()
+  {
+    long pages = 0;
+    long resident = 0;
+    FILE *fp = std::fopen("/proc/self/statm", "r");
+    if(fp == NULL) {
+      return -1;
+    }
+    if(std::fscanf(fp, "%ld %ld", &pages, &resident) != 2) {
+      resident = -1;
+    }
+    std::fclose(fp);
+    return resident < 0 ? -1 : resident * sysconf(_SC_PAGESIZE);
+  }
+
+  // Start the high water mark of the resident set size over from where
+  // it is now. Needs Linux 4.0 or later.
+  bool
+  reset_peak_rss()
+  {
+    FILE *fp = std::fopen("/proc/self/clear_refs", "w");
+    if(fp == NULL) {
+      return false;
+    }
+    bool ok = std::fputs("5", fp) >= 0;
+    return std::fclose(fp) == 0 && ok;
+  }
+
+  long
+  peak_rss_bytes()
+  {
+    FILE *fp = std::fopen("/proc/self/status", "r");
+    if(fp == NULL) {
+      return -1;
+    }
+    char line[256];
+    long peak = -1;
+    while(std::fgets(line, sizeof(line), fp) != NULL) {
+      if(std::strncmp(line, "VmHWM:", 6) == 0 && std::sscanf(line + 6, "%ld", &peak) == 1) {
+        peak *= 1024;
+        break;
+      }
+    }
+    std::fclose(fp);
+    return peak;
+  }
+
+  // Hand freed memory back, so one run doesn't count the last one's
+  void
+  release_free_memory()
+  {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+  }
+
+  // An annotation like a detector would make, with a nested object
+  meta_namespace
+  make_annotation(size_t i)
+  {
+    meta_namespace ns = meta_namespace::build_annotation_segment(i * 1000, 500);
+    ns.set("core:freq_lower_edge", 915e6 + (i % 64) * 25e3);
+    ns.set("core:freq_upper_edge", 915e6 + (i % 64 + 1) * 25e3);
+    ns.set("core:label", "burst");
+    ns.set("core:comment", "detected by the energy detector on channel " + std::to_string(i % 64));
+    pmt::pmt_t detail = pmt::make_dict();
+    detail = pmt::dict_add(detail, pmt::mp("snr"), pmt::from_double(12.5));
+    detail = pmt::dict_add(detail, pmt::mp("channel"), pmt::from_uint64(i % 64));
+    detail = pmt::dict_add(detail, pmt::mp("crc_ok"), pmt::PMT_T);
+    ns.set("bench:detail", detail);
+    return ns;
+  }
+
+  // Write a metadata file holding the same annotations
+  std::unique_ptr<FILE, file_closer>
+  make_metafile(size_t num_annotations)
+  {
+    std::unique_ptr<FILE, file_closer> fp(std::tmpfile());
+    if(!fp) {
+      throw std::runtime_error("Unable to open a temporary file");
+    }
+    meta_namespace global = meta_namespace::build_global_object("cf32_le");
+    std::vector<meta_namespace> captures(1, meta_namespace::build_capture_segment(0));
+    std::vector<meta_namespace> annotations;
+    annotations.reserve(num_annotations);
+    for(size_t i = 0; i < num_annotations; i++) {
+      annotations.push_back(make_annotation(i));
+    }
+    writer_utils::write_meta_to_fp(fp.get(), global, captures, annotations, false);
+    std::fflush(fp.get());
+    return fp;
+  }
+
+  template <typename Container>
+  void
+  build(Container &annotations, size_t num_annotations)
+  {
+    for(size_t i = 0; i < num_annotations; i++) {
+      annotations.push_back(make_annotation(i));
+    }
+  }
+
+  void
+  load(std::vector<meta_namespace> &annotations, FILE *fp)
+  {
+    std::rewind(fp);
+    annotations = load_metafile(fp).annotations;
+  }
+
+  void
+  load(arena_segments &annotations, FILE *fp)
+  {
+    std::rewind(fp);
+    meta_namespace global;
+    std::vector<meta_namespace> captures;
+    load_metafile(fp, global, captures, annotations);
+  }
+
+  // fill is called with an empty Container to build or load into
+  template <typename Container, typename Fill>
+  result
+  run(const std::string &impl, const std::string &source, Fill fill)
+  {
+    release_free_memory();
+    long rss_before = rss_bytes();
+    bool peak_reset = reset_peak_rss();
+    clock_type::time_point start = clock_type::now();
+    Container *annotations = new Container();
+    fill(*annotations);
+    double build_seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    long rss_built = rss_bytes();
+    long peak = peak_reset ? peak_rss_bytes() : -1;
+
+    start = clock_type::now();
+    size_t num_annotations = annotations->size();
+    delete annotations;
+    double teardown_seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    long rss_after = rss_bytes();
+    return {impl,
+            source,
+            num_annotations,
+            build_seconds,
+            rss_built - rss_before,
+            peak < 0 ? -1 : peak - rss_before,
+            teardown_seconds,
+            rss_after - rss_before};
+  }
+
+  template <typename Writer>
+  void
+  write_result(Writer &writer, const result &r)
+  {
+    writer.StartObject();
+    writer.Key("impl");
+    writer.String(r.impl.c_str());
+    writer.Key("source");
+    writer.String(r.source.c_str());
+    writer.Key("annotations");
+    writer.Uint64(r.annotations);
+    writer.Key("build_seconds");
+    writer.Double(r.build_seconds);
+    writer.Key("rss_bytes");
+    writer.Int64(r.rss_bytes);
+    writer.Key("rss_bytes_per_annotation");
+    writer.Double(static_cast<double>(r.rss_bytes) / r.annotations);
+    // -1 where the high water mark can't be reset
+    writer.Key("peak_rss_bytes");
+    writer.Int64(r.peak_rss_bytes);
+    writer.Key("teardown_seconds");
+    writer.Double(r.teardown_seconds);
+    writer.Key("rss_after_teardown_bytes");
+    writer.Int64(r.rss_after_teardown_bytes);
+    writer.EndObject();
+  }
+} // namespace
+
+int
+main(int argc, char *argv[])
+{
+  size_t num_annotations;
+  std::string output;
+
+  po::options_description desc("Benchmark holding and freeing many annotations");
+  desc.add_options()
+    ("help,h", "Show this message")
+    ("annotations", po::value<size_t>(&num_annotations)->default_value(1000000),
+     "Annotations to hold")
+    ("output,o", po::value<std::string>(&output), "File to write JSON to. Default stdout");
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch(const po::error &e) {
+    std::cerr << e.what() << std::endl << desc << std::endl;
+    return 1;
+  }
+  if(vm.count("help")) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  // Intern the keys first, so neither run pays for it
+  make_annotation(0);
+
+  typedef std::vector<meta_namespace> namespace_vector;
+  std::vector<result> results;
+  results.push_back(run<namespace_vector>("meta_namespace", "built", [&](namespace_vector &a) {
+    build(a, num_annotations);
+  }));
+  results.push_back(run<arena_segments>("arena", "built", [&](arena_segments &a) {
+    build(a, num_annotations);
+  }));
+
+  std::unique_ptr<FILE, file_closer> meta_fp;
+  try {
+    meta_fp = make_metafile(num_annotations);
+  } catch(const std::runtime_error &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  results.push_back(run<namespace_vector>("meta_namespace", "loaded", [&](namespace_vector &a) {
+    load(a, meta_fp.get());
+  }));
+  results.push_back(run<arena_segments>("arena", "loaded", [&](arena_segments &a) {
+    load(a, meta_fp.get());
+  }));
+
+  FILE *fp = stdout;
+  if(!output.empty()) {
+    fp = std::fopen(output.c_str(), "w");
+    if(fp == NULL) {
+      std::cerr << "Unable to open output file " << output << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<char> write_buffer(65536);
+  rapidjson::FileWriteStream stream(fp, write_buffer.data(), write_buffer.size());
+  rapidjson::PrettyWriter<rapidjson::FileWriteStream> writer(stream);
+  writer.StartObject();
+  writer.Key("results");
+  writer.StartArray();
+  for(const result &r : results) {
+    write_result(writer, r);
+  }
+  writer.EndArray();
+  writer.EndObject();
+  stream.Put('\n');
+  stream.Flush();
+
+  if(fp != stdout) {
+    std::fclose(fp);
+  }
+  return 0;
+}
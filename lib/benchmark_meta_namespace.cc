@@ -0,0 +1,292 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Measures set, get and serialize on meta_namespace against a plain pmt
+ * dict used the way meta_namespace used to use it, with the regex key
+ * validation it used to do, for objects with a range of key counts, and
+ * writes the results as JSON.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <boost/regex.hpp>
+#include <rapidjson/filewritestream.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <sigmf/meta_namespace.h>
+
+namespace po = boost::program_options;
+
+using namespace gr::sigmf;
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  struct result {
+    std::string impl;
+    std::string op;
+    size_t keys;
+    size_t objects;
+    double seconds;
+  };
+
+  std::vector<std::string>
+  make_keys(size_t num_keys)
+  {
+    std::vector<std::string> keys;
+    for(size_t i = 0; i < num_keys; i++) {
+      keys.push_back("bench:key_" + std::to_string(i));
+    }
+    return keys;
+  }
+
+  // What meta_namespace::validate_key used to do
+  bool
+  regex_validate_key(const std::string &key)
+  {
+    boost::regex key_regex("(^\\w+:\\w+$)");
+    return boost::regex_match(key, key_regex);
+  }
+
+  double
+  seconds_since(clock_type::time_point start)
+  {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+  }
+
+  // The mix of values annotations usually have
+  template <typename Set>
+  void
+  set_values(const std::vector<std::string> &keys, size_t object, Set set)
+  {
+    for(size_t k = 0; k < keys.size(); k++) {
+      switch(k % 3) {
+        case 0:
+          set(keys[k], pmt::from_uint64(object * 1000 + k));
+          break;
+        case 1:
+          set(keys[k], pmt::from_double(object * 0.5));
+          break;
+        default:
+          set(keys[k], pmt::string_to_symbol("value"));
+          break;
+      }
+    }
+  }
+
+  void
+  run_pmt_dict(size_t num_keys, size_t num_objects, std::vector<result> &results)
+  {
+    std::vector<std::string> keys = make_keys(num_keys);
+    std::vector<pmt::pmt_t> objects(num_objects, pmt::make_dict());
+
+    clock_type::time_point start = clock_type::now();
+    for(size_t i = 0; i < num_objects; i++) {
+      set_values(keys, i, [&](const std::string &key, const pmt::pmt_t &val) {
+        if(!regex_validate_key(key)) {
+          throw std::invalid_argument("key format is invalid:'" + key + "'");
+        }
+        objects[i] = pmt::dict_add(objects[i], pmt::mp(key), val);
+      });
+    }
+    results.push_back({"pmt_dict", "set", num_keys, num_objects, seconds_since(start)});
+
+    start = clock_type::now();
+    size_t found = 0;
+    for(size_t i = 0; i < num_objects; i++) {
+      for(const std::string &key : keys) {
+        found += !pmt::is_null(pmt::dict_ref(objects[i], pmt::mp(key), pmt::get_PMT_NIL()));
+      }
+    }
+    results.push_back({"pmt_dict", "get", num_keys, num_objects, seconds_since(start)});
+    if(found != num_keys * num_objects) {
+      throw std::runtime_error("pmt_dict lost values");
+    }
+
+    start = clock_type::now();
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartArray();
+    for(size_t i = 0; i < num_objects; i++) {
+      meta_value::serialize_pmt(writer, objects[i]);
+    }
+    writer.EndArray();
+    results.push_back({"pmt_dict", "serialize", num_keys, num_objects, seconds_since(start)});
+
+    // Tags with keys that aren't namespaced are checked once per tag
+    start = clock_type::now();
+    size_t valid = 0;
+    for(size_t i = 0; i < num_objects; i++) {
+      for(const std::string &key : keys) {
+        valid += regex_validate_key(key);
+      }
+    }
+    results.push_back({"pmt_dict", "validate", num_keys, num_objects, seconds_since(start)});
+    if(valid != num_keys * num_objects) {
+      throw std::runtime_error("regex rejected a valid key");
+    }
+  }
+
+  void
+  run_meta_namespace(size_t num_keys, size_t num_objects, std::vector<result> &results)
+  {
+    std::vector<std::string> keys = make_keys(num_keys);
+    std::vector<meta_namespace> objects(num_objects);
+
+    clock_type::time_point start = clock_type::now();
+    for(size_t i = 0; i < num_objects; i++) {
+      set_values(keys, i, [&](const std::string &key, const pmt::pmt_t &val) {
+        objects[i].set(key, val);
+      });
+    }
+    results.push_back({"meta_namespace", "set", num_keys, num_objects, seconds_since(start)});
+
+    start = clock_type::now();
+    size_t found = 0;
+    for(size_t i = 0; i < num_objects; i++) {
+      for(const std::string &key : keys) {
+        found += !pmt::is_null(objects[i].get(key));
+      }
+    }
+    results.push_back({"meta_namespace", "get", num_keys, num_objects, seconds_since(start)});
+    if(found != num_keys * num_objects) {
+      throw std::runtime_error("meta_namespace lost values");
+    }
+
+    start = clock_type::now();
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartArray();
+    for(size_t i = 0; i < num_objects; i++) {
+      objects[i].serialize(writer);
+    }
+    writer.EndArray();
+    results.push_back(
+      {"meta_namespace", "serialize", num_keys, num_objects, seconds_since(start)});
+
+    start = clock_type::now();
+    size_t valid = 0;
+    for(size_t i = 0; i < num_objects; i++) {
+      for(const std::string &key : keys) {
+        valid += meta_namespace::validate_key(key);
+      }
+    }
+    results.push_back(
+      {"meta_namespace", "validate", num_keys, num_objects, seconds_since(start)});
+    if(valid != num_keys * num_objects) {
+      throw std::runtime_error("validate_key rejected a valid key");
+    }
+  }
+
+  template <typename Writer>
+  void
+  write_result(Writer &writer, const result &r)
+  {
+    double ops = static_cast<double>(r.keys) * r.objects;
+    writer.StartObject();
+    writer.Key("impl");
+    writer.String(r.impl.c_str());
+    writer.Key("op");
+    writer.String(r.op.c_str());
+    writer.Key("keys");
+    writer.Uint64(r.keys);
+    writer.Key("objects");
+    writer.Uint64(r.objects);
+    writer.Key("seconds");
+    writer.Double(r.seconds);
+    writer.Key("ns_per_key");
+    writer.Double(r.seconds * 1e9 / ops);
+    writer.EndObject();
+  }
+} // namespace
+
+int
+main(int argc, char *argv[])
+{
+  std::vector<size_t> key_counts;
+  size_t num_objects;
+  std::string output;
+
+  po::options_description desc("Benchmark meta_namespace against a pmt dict");
+  desc.add_options()
+    ("help,h", "Show this message")
+    ("keys", po::value<std::vector<size_t>>(&key_counts)->multitoken(),
+     "Keys per object. Default 4 16 64")
+    ("objects", po::value<size_t>(&num_objects)->default_value(10000),
+     "Objects to set, get, serialize and validate keys for, for each key count")
+    ("output,o", po::value<std::string>(&output), "File to write JSON to. Default stdout");
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch(const po::error &e) {
+    std::cerr << e.what() << std::endl << desc << std::endl;
+    return 1;
+  }
+  if(vm.count("help")) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  if(key_counts.empty()) {
+    key_counts = {4, 16, 64};
+  }
+
+  std::vector<result> results;
+  for(size_t num_keys : key_counts) {
+    run_pmt_dict(num_keys, num_objects, results);
+    run_meta_namespace(num_keys, num_objects, results);
+    std::cerr << num_keys << " keys" << std::endl;
+  }
+
+  FILE *fp = stdout;
+  if(!output.empty()) {
+    fp = std::fopen(output.c_str(), "w");
+    if(fp == NULL) {
+      std::cerr << "Unable to open output file " << output << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<char> write_buffer(65536);
+  rapidjson::FileWriteStream stream(fp, write_buffer.data(), write_buffer.size());
+  rapidjson::PrettyWriter<rapidjson::FileWriteStream> writer(stream);
+  writer.StartObject();
+  writer.Key("results");
+  writer.StartArray();
+  for(const result &r : results) {
+    write_result(writer, r);
+  }
+  writer.EndArray();
+  writer.EndObject();
+  stream.Put('\n');
+  stream.Flush();
+
+  if(fp != stdout) {
+    std::fclose(fp);
+  }
+  return 0;
+}
@@ -0,0 +1,295 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Measures the throughput of every type_converter pair, for a range of
+ * buffer sizes, and writes the results as JSON so runs from different
+ * builds or VOLK versions can be diffed.
+ *
+ * VOLK picks its kernels once per process, so to compare machines run
+ * this once per machine, e.g. with --generic, or with VOLK_CONFIGPATH
+ * pointing at a different volk_config.
+ *
+ * Converters work on items, and the types here are the base types, so
+ * costs are per item. cycles_per_sample is the cost of a complex
+ * sample of the same types, which is two items.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/endian/conversion.hpp>
+#include <boost/program_options.hpp>
+#include <rapidjson/filewritestream.h>
+#include <rapidjson/prettywriter.h>
+#include <volk/volk.h>
+#include <sigmf/type_converter.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+namespace po = boost::program_options;
+namespace endian = boost::endian;
+
+using namespace gr::sigmf;
+
+namespace {
+  const std::vector<std::string> TYPE_NAMES = {
+    "f32", "f64", "i8", "i16", "i32", "i64", "u8", "u16", "u32", "u64", "i4", "i12"};
+
+  typedef std::chrono::steady_clock clock_type;
+
+  struct result {
+    std::string from;
+    std::string to;
+    size_t buffer_bytes;
+    size_t items;
+    size_t calls;
+    double seconds;
+    double cycles;
+  };
+
+  uint64_t
+  read_cycles()
+  {
+#ifdef HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+  /*
+   * Convert the same buffer until min_seconds have passed, after one
+   * call to warm caches and the converter's scratch buffer
+   */
+  result
+  run_pair(const std::string &from,
+           const std::string &to,
+           size_t buffer_bytes,
+           double min_seconds,
+           bool scaled)
+  {
+    std::string suffix = endian::order::native == endian::order::little ? "_le" : "_be";
+    // Complex, so the packed types can be included
+    type_converter converter = scaled ?
+      type_converter("c" + from + suffix, "c" + to + suffix, 0.5, 0.25) :
+      type_converter("c" + from + suffix, "c" + to + suffix);
+
+    size_t items = converter.input_items(buffer_bytes);
+    size_t in_bytes = converter.input_bytes(items);
+    std::unique_ptr<char, volk_deleter> in(
+      static_cast<char *>(volk_malloc(in_bytes, volk_get_alignment())));
+    std::unique_ptr<char, volk_deleter> out(
+      static_cast<char *>(volk_malloc(converter.output_bytes(items), volk_get_alignment())));
+    if(!in || !out) {
+      throw std::runtime_error("failed to allocate benchmark buffers");
+    }
+    // Small values, so no conversion saturates or produces NaNs
+    for(size_t i = 0; i < in_bytes; i++) {
+      in.get()[i] = static_cast<char>(i % 31);
+    }
+
+    converter.convert(out.get(), in.get(), items);
+
+    result r;
+    r.from = from;
+    r.to = to;
+    r.buffer_bytes = in_bytes;
+    r.items = items;
+    r.calls = 0;
+    clock_type::time_point start = clock_type::now();
+    uint64_t start_cycles = read_cycles();
+    do {
+      converter.convert(out.get(), in.get(), items);
+      r.calls++;
+      r.seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    } while(r.seconds < min_seconds);
+    r.cycles = static_cast<double>(read_cycles() - start_cycles);
+    return r;
+  }
+
+  template <typename Writer>
+  void
+  write_result(Writer &writer, const result &r)
+  {
+    double total_items = static_cast<double>(r.items) * r.calls;
+    writer.StartObject();
+    writer.Key("from");
+    writer.String(r.from.c_str());
+    writer.Key("to");
+    writer.String(r.to.c_str());
+    writer.Key("buffer_bytes");
+    writer.Uint64(r.buffer_bytes);
+    writer.Key("items");
+    writer.Uint64(r.items);
+    writer.Key("calls");
+    writer.Uint64(r.calls);
+    writer.Key("seconds");
+    writer.Double(r.seconds);
+    // Bytes read from the input buffer
+    writer.Key("gb_per_sec");
+    writer.Double(r.buffer_bytes * static_cast<double>(r.calls) / r.seconds / 1e9);
+    writer.Key("ns_per_item");
+    writer.Double(r.seconds * 1e9 / total_items);
+    // Reference cycles from the TSC, not core clock cycles
+    writer.Key("cycles_per_item");
+    if(r.cycles > 0) {
+      writer.Double(r.cycles / total_items);
+    } else {
+      writer.Null();
+    }
+    // For the complex version of the types, where a sample is two items.
+    // A real sample is one item, so it costs cycles_per_item.
+    writer.Key("cycles_per_sample");
+    if(r.cycles > 0) {
+      writer.Double(2 * r.cycles / total_items);
+    } else {
+      writer.Null();
+    }
+    writer.EndObject();
+  }
+
+  std::vector<std::string>
+  parse_types(const std::string &types)
+  {
+    std::vector<std::string> result;
+    if(types.empty()) {
+      return TYPE_NAMES;
+    }
+    size_t start = 0;
+    while(start <= types.size()) {
+      size_t end = types.find(',', start);
+      if(end == std::string::npos) {
+        end = types.size();
+      }
+      std::string type = types.substr(start, end - start);
+      if(std::find(TYPE_NAMES.begin(), TYPE_NAMES.end(), type) == TYPE_NAMES.end()) {
+        throw std::runtime_error("Unsupported sample type " + type);
+      }
+      result.push_back(type);
+      start = end + 1;
+    }
+    return result;
+  }
+} // namespace
+
+int
+main(int argc, char *argv[])
+{
+  std::string types_str;
+  std::string output;
+  std::vector<size_t> sizes;
+  double min_seconds;
+
+  po::options_description desc("Benchmark SigMF datatype conversions");
+  desc.add_options()
+    ("help,h", "Show this message")
+    ("types", po::value<std::string>(&types_str),
+     "Comma separated types to convert between, e.g. f32,i16. Default all")
+    ("sizes", po::value<std::vector<size_t>>(&sizes)->multitoken(),
+     "Input buffer sizes in bytes. Default runs from L1 sized to DRAM sized")
+    ("min-time", po::value<double>(&min_seconds)->default_value(0.1),
+     "Seconds to run each pair and size for")
+    ("scaled", "Benchmark the conversions with a scale and offset")
+    ("generic", "Use only the generic VOLK and converter kernels")
+    ("output,o", po::value<std::string>(&output), "File to write JSON to. Default stdout");
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch(const po::error &e) {
+    std::cerr << e.what() << std::endl << desc << std::endl;
+    return 1;
+  }
+  if(vm.count("help")) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  if(vm.count("generic")) {
+    // Has to be set before the first VOLK call
+    setenv("VOLK_GENERIC", "1", 1);
+  }
+  if(sizes.empty()) {
+    sizes = {4096, 32768, 262144, 2097152, 67108864};
+  }
+  bool scaled = vm.count("scaled") > 0;
+
+  std::vector<std::string> types;
+  try {
+    types = parse_types(types_str);
+  } catch(const std::runtime_error &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  FILE *fp = stdout;
+  if(!output.empty()) {
+    fp = std::fopen(output.c_str(), "w");
+    if(fp == NULL) {
+      std::cerr << "Unable to open output file " << output << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<char> write_buffer(65536);
+  rapidjson::FileWriteStream stream(fp, write_buffer.data(), write_buffer.size());
+  rapidjson::PrettyWriter<rapidjson::FileWriteStream> writer(stream);
+  writer.StartObject();
+  writer.Key("volk_machine");
+  writer.String(volk_get_machine());
+  writer.Key("volk_alignment");
+  writer.Uint64(volk_get_alignment());
+  // ISA of the pairs VOLK doesn't cover, generic with --generic too
+  writer.Key("converter_isa");
+  writer.String(converter_isa().c_str());
+  writer.Key("scaled");
+  writer.Bool(scaled);
+  writer.Key("min_seconds");
+  writer.Double(min_seconds);
+  writer.Key("results");
+  writer.StartArray();
+  for(const std::string &from : types) {
+    for(const std::string &to : types) {
+      for(size_t size : sizes) {
+        write_result(writer, run_pair(from, to, size, min_seconds, scaled));
+      }
+      std::cerr << from << " -> " << to << std::endl;
+    }
+  }
+  writer.EndArray();
+  writer.EndObject();
+  stream.Put('\n');
+  stream.Flush();
+
+  if(fp != stdout) {
+    std::fclose(fp);
+  }
+  return 0;
+}
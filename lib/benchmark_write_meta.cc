@@ -0,0 +1,272 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Measures how long writing a metadata file with many annotations takes
+ * and how big it is, pretty printed and compact, against the way
+ * write_meta_to_fp used to write it, and writes the results as JSON.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <rapidjson/filewritestream.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/writer.h>
+#include <sigmf/meta_namespace.h>
+#include "writer_utils.h"
+
+namespace po = boost::program_options;
+
+using namespace gr::sigmf;
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  struct result {
+    std::string impl;
+    size_t annotations;
+    double seconds;
+    long bytes;
+  };
+
+  struct file_closer {
+    void
+    operator()(FILE *fp) const
+    {
+      std::fclose(fp);
+    }
+  };
+
+  // What meta_value::serialize_pmt used to do with dicts, looking up
+  // every key
+  template <typename Writer>
+  void
+  legacy_serialize_pmt(Writer &writer, pmt::pmt_t pmt_data)
+  {
+    if(pmt::is_dict(pmt_data)) {
+      writer.StartObject();
+      pmt::pmt_t item_keys = pmt::dict_keys(pmt_data);
+      size_t num_items = pmt::length(item_keys);
+      for(size_t i = 0; i < num_items; i++) {
+        pmt::pmt_t item_key = pmt::nth(i, item_keys);
+        pmt::pmt_t val_for_key = pmt::dict_ref(pmt_data, item_key, pmt::get_PMT_NIL());
+        std::string key_str = pmt::symbol_to_string(item_key);
+        writer.String(key_str.c_str());
+        legacy_serialize_pmt(writer, val_for_key);
+      }
+      writer.EndObject();
+    } else {
+      meta_value::serialize_pmt(writer, pmt_data);
+    }
+  }
+
+  template <typename Writer>
+  void
+  legacy_serialize(Writer &writer, const meta_namespace &ns)
+  {
+    writer.StartObject();
+    for(const std::string &key : ns.keys()) {
+      writer.String(key.c_str());
+      legacy_serialize_pmt(writer, ns.get(key));
+    }
+    writer.EndObject();
+  }
+
+  // What write_meta_to_fp used to do: sort reading sample_start on every
+  // comparison, then pretty print
+  void
+  legacy_write_meta(FILE *fp,
+                    const meta_namespace &global,
+                    std::vector<meta_namespace> &captures,
+                    std::vector<meta_namespace> &annotations)
+  {
+    char write_buf[65536];
+    rapidjson::FileWriteStream file_stream(fp, write_buf, sizeof(write_buf));
+    rapidjson::PrettyWriter<rapidjson::FileWriteStream> writer(file_stream);
+    writer.StartObject();
+    writer.String("global");
+    legacy_serialize(writer, global);
+    writer.String("captures");
+    writer.StartArray();
+    for(const meta_namespace &capture : captures) {
+      legacy_serialize(writer, capture);
+    }
+    writer.EndArray();
+    std::sort(annotations.begin(), annotations.end(),
+              [](const meta_namespace &a, const meta_namespace &b) {
+                return pmt::to_uint64(a.get("core:sample_start")) <
+                       pmt::to_uint64(b.get("core:sample_start"));
+              });
+    writer.String("annotations");
+    writer.StartArray();
+    for(const meta_namespace &annotation : annotations) {
+      legacy_serialize(writer, annotation);
+    }
+    writer.EndArray();
+    writer.EndObject();
+  }
+
+  // Annotations like a detector would make, with a nested object
+  std::vector<meta_namespace>
+  make_annotations(size_t num_annotations, bool shuffle)
+  {
+    std::vector<meta_namespace> annotations;
+    annotations.reserve(num_annotations);
+    for(size_t i = 0; i < num_annotations; i++) {
+      meta_namespace ns = meta_namespace::build_annotation_segment(i * 1000, 500);
+      ns.set("core:freq_lower_edge", 915e6 + (i % 64) * 25e3);
+      ns.set("core:freq_upper_edge", 915e6 + (i % 64 + 1) * 25e3);
+      ns.set("core:label", "burst");
+      pmt::pmt_t detail = pmt::make_dict();
+      detail = pmt::dict_add(detail, pmt::mp("snr"), pmt::from_double(12.5));
+      detail = pmt::dict_add(detail, pmt::mp("channel"), pmt::from_uint64(i % 64));
+      detail = pmt::dict_add(detail, pmt::mp("crc_ok"), pmt::PMT_T);
+      ns.set("bench:detail", detail);
+      annotations.push_back(std::move(ns));
+    }
+    if(shuffle) {
+      std::mt19937 rng(1);
+      std::shuffle(annotations.begin(), annotations.end(), rng);
+    }
+    return annotations;
+  }
+
+  template <typename Write>
+  result
+  run(const std::string &impl, const std::vector<meta_namespace> &annotations, Write write)
+  {
+    meta_namespace global = meta_namespace::build_global_object("cf32_le");
+    std::vector<meta_namespace> captures(1, meta_namespace::build_capture_segment(0));
+    // Writing sorts the annotations, so each run gets its own copy
+    std::vector<meta_namespace> to_write(annotations);
+    std::unique_ptr<FILE, file_closer> fp(std::tmpfile());
+    if(!fp) {
+      throw std::runtime_error("Unable to open a temporary file");
+    }
+
+    clock_type::time_point start = clock_type::now();
+    write(fp.get(), global, captures, to_write);
+    std::fflush(fp.get());
+    double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    return {impl, annotations.size(), seconds, std::ftell(fp.get())};
+  }
+
+  template <typename Writer>
+  void
+  write_result(Writer &writer, const result &r)
+  {
+    writer.StartObject();
+    writer.Key("impl");
+    writer.String(r.impl.c_str());
+    writer.Key("annotations");
+    writer.Uint64(r.annotations);
+    writer.Key("seconds");
+    writer.Double(r.seconds);
+    writer.Key("bytes");
+    writer.Int64(r.bytes);
+    writer.Key("bytes_per_annotation");
+    writer.Double(static_cast<double>(r.bytes) / r.annotations);
+    writer.EndObject();
+  }
+} // namespace
+
+int
+main(int argc, char *argv[])
+{
+  size_t num_annotations;
+  std::string output;
+
+  po::options_description desc("Benchmark writing metadata files with many annotations");
+  desc.add_options()
+    ("help,h", "Show this message")
+    ("annotations", po::value<size_t>(&num_annotations)->default_value(1000000),
+     "Annotations to write")
+    ("shuffle", "Add the annotations out of order, so writing has to sort them")
+    ("skip-legacy", "Don't time the old writer, which is slow for many annotations")
+    ("output,o", po::value<std::string>(&output), "File to write JSON to. Default stdout");
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch(const po::error &e) {
+    std::cerr << e.what() << std::endl << desc << std::endl;
+    return 1;
+  }
+  if(vm.count("help")) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  std::vector<meta_namespace> annotations =
+    make_annotations(num_annotations, vm.count("shuffle") > 0);
+
+  std::vector<result> results;
+  if(!vm.count("skip-legacy")) {
+    results.push_back(run("legacy", annotations, legacy_write_meta));
+  }
+  results.push_back(run("pretty", annotations,
+                        [](FILE *fp, const meta_namespace &global,
+                           std::vector<meta_namespace> &captures,
+                           std::vector<meta_namespace> &to_write) {
+                          writer_utils::write_meta_to_fp(fp, global, captures, to_write, true);
+                        }));
+  results.push_back(run("compact", annotations,
+                        [](FILE *fp, const meta_namespace &global,
+                           std::vector<meta_namespace> &captures,
+                           std::vector<meta_namespace> &to_write) {
+                          writer_utils::write_meta_to_fp(fp, global, captures, to_write, false);
+                        }));
+
+  FILE *fp = stdout;
+  if(!output.empty()) {
+    fp = std::fopen(output.c_str(), "w");
+    if(fp == NULL) {
+      std::cerr << "Unable to open output file " << output << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<char> write_buffer(65536);
+  rapidjson::FileWriteStream stream(fp, write_buffer.data(), write_buffer.size());
+  rapidjson::PrettyWriter<rapidjson::FileWriteStream> writer(stream);
+  writer.StartObject();
+  writer.Key("results");
+  writer.StartArray();
+  for(const result &r : results) {
+    write_result(writer, r);
+  }
+  writer.EndArray();
+  writer.EndObject();
+  stream.Put('\n');
+  stream.Flush();
+
+  if(fp != stdout) {
+    std::fclose(fp);
+  }
+  return 0;
+}
@@ -0,0 +1,321 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "sigmf/meta_arena.h"
+#include "pmt_sax_handler.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <rapidjson/memorystream.h>
+#include <rapidjson/reader.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+namespace gr {
+  namespace sigmf {
+
+    namespace {
+      // NaN and infinity can be set through a pmt, so they have to
+      // survive the trip through JSON
+      typedef rapidjson::Writer<rapidjson::StringBuffer,
+                                rapidjson::UTF8<>,
+                                rapidjson::UTF8<>,
+                                rapidjson::CrtAllocator,
+                                rapidjson::kWriteNanAndInfFlag>
+        json_writer;
+    } // namespace
+
+    meta_arena::meta_arena(size_t block_size)
+    : d_block_size(block_size), d_pos(NULL), d_end(NULL), d_capacity(0)
+    {
+    }
+
+    meta_arena::~meta_arena()
+    {
+      clear();
+    }
+
+    meta_arena::meta_arena(meta_arena &&other) noexcept
+    : d_block_size(other.d_block_size), d_blocks(std::move(other.d_blocks)), d_pos(other.d_pos),
+      d_end(other.d_end), d_capacity(other.d_capacity)
+    {
+      other.d_blocks.clear();
+      other.d_pos = NULL;
+      other.d_end = NULL;
+      other.d_capacity = 0;
+    }
+
+    meta_arena &
+    meta_arena::operator=(meta_arena &&other) noexcept
+    {
+      if(this != &other) {
+        clear();
+        d_block_size = other.d_block_size;
+        d_blocks.swap(other.d_blocks);
+        d_pos = other.d_pos;
+        d_end = other.d_end;
+        d_capacity = other.d_capacity;
+        other.d_pos = NULL;
+        other.d_end = NULL;
+        other.d_capacity = 0;
+      }
+      return *this;
+    }
+
+    char *
+    meta_arena::new_block(size_t size)
+    {
+      char *block = static_cast<char *>(std::malloc(size));
+      if(block == NULL) {
+        throw std::bad_alloc();
+      }
+      d_blocks.push_back(block);
+      d_capacity += size;
+      return block;
+    }
+
+    void *
+    meta_arena::allocate(size_t size, size_t align)
+    {
+      uintptr_t p = (reinterpret_cast<uintptr_t>(d_pos) + align - 1) & ~(align - 1);
+      if(d_pos != NULL && p + size <= reinterpret_cast<uintptr_t>(d_end)) {
+        d_pos = reinterpret_cast<char *>(p + size);
+        return reinterpret_cast<void *>(p);
+      }
+
+      if(size + align > d_block_size / 4) {
+        // The rest of the current block is still used for small ones
+        char *block = new_block(size + align);
+        p = (reinterpret_cast<uintptr_t>(block) + align - 1) & ~(align - 1);
+        return reinterpret_cast<void *>(p);
+      }
+      char *block = new_block(d_block_size);
+      d_end = block + d_block_size;
+      p = (reinterpret_cast<uintptr_t>(block) + align - 1) & ~(align - 1);
+      d_pos = reinterpret_cast<char *>(p + size);
+      return reinterpret_cast<void *>(p);
+    }
+
+    const char *
+    meta_arena::copy(const char *data, size_t length)
+    {
+      char *p = static_cast<char *>(allocate(length, 1));
+      std::memcpy(p, data, length);
+      return p;
+    }
+
+    void
+    meta_arena::clear()
+    {
+      for(char *block : d_blocks) {
+        std::free(block);
+      }
+      d_blocks.clear();
+      d_pos = NULL;
+      d_end = NULL;
+      d_capacity = 0;
+    }
+
+    pmt::pmt_t
+    arena_value::to_pmt() const
+    {
+      switch(d_kind) {
+        case meta_value::BOOL:
+          return pmt::from_bool(d_bool);
+        case meta_value::INT64:
+          return pmt::from_long(d_int);
+        case meta_value::UINT64:
+          return pmt::from_uint64(d_uint);
+        case meta_value::DOUBLE:
+          return pmt::from_double(d_double);
+        case meta_value::STRING:
+          return pmt::string_to_symbol(std::string(d_str.data, d_str.length));
+        case meta_value::PMT:
+          break;
+        default:
+          return pmt::get_PMT_NIL();
+      }
+      if(!d_json) {
+        return *d_pmt;
+      }
+      rapidjson::MemoryStream stream(d_str.data, d_str.length);
+      pmt_sax_handler handler;
+      rapidjson::Reader reader;
+      reader.Parse<rapidjson::kParseNanAndInfFlag>(stream, handler);
+      if(reader.HasParseError() || !handler.complete()) {
+        throw std::runtime_error("Corrupt value in arena_segments");
+      }
+      return handler.result();
+    }
+
+    const arena_value *
+    arena_segment::find(const meta_key &key) const
+    {
+      for(const member &m : *this) {
+        if(m.key == &key) {
+          return &m.value;
+        }
+      }
+      return NULL;
+    }
+
+    const arena_value *
+    arena_segment::find(const std::string &key) const
+    {
+      const meta_key *k = meta_key::lookup(key);
+      return k == NULL ? NULL : find(*k);
+    }
+
+    pmt::pmt_t
+    arena_segment::get(const std::string &key) const
+    {
+      const arena_value *val = find(key);
+      return val == NULL ? pmt::get_PMT_NIL() : val->to_pmt();
+    }
+
+    meta_namespace
+    arena_segment::to_namespace() const
+    {
+      meta_map data;
+      data.reserve(d_size);
+      for(const member &m : *this) {
+        const arena_value &v = m.value;
+        switch(v.kind()) {
+          case meta_value::BOOL:
+            data.set(*m.key, meta_value::from_bool(v.d_bool));
+            break;
+          case meta_value::INT64:
+            data.set(*m.key, meta_value(static_cast<long>(v.d_int)));
+            break;
+          case meta_value::UINT64:
+            data.set(*m.key, meta_value(static_cast<unsigned long long>(v.d_uint)));
+            break;
+          case meta_value::DOUBLE:
+            data.set(*m.key, meta_value(v.d_double));
+            break;
+          case meta_value::STRING:
+            data.set(*m.key, meta_value(std::string(v.d_str.data, v.d_str.length)));
+            break;
+          case meta_value::PMT:
+            data.set(*m.key, meta_value(v.to_pmt()));
+            break;
+          default:
+            data.set(*m.key, meta_value());
+            break;
+        }
+      }
+      return meta_namespace(std::move(data));
+    }
+
+    arena_segments::arena_segments()
+    {
+    }
+
+    void
+    arena_segments::push_back(const meta_namespace &ns)
+    {
+      const meta_map &values = ns.values();
+      arena_segment segment;
+      segment.d_size = values.size();
+      arena_segment::member *members = static_cast<arena_segment::member *>(
+        d_arena.allocate(values.size() * sizeof(arena_segment::member),
+                         alignof(arena_segment::member)));
+      segment.d_members = members;
+
+      for(const meta_map::entry &e : values) {
+        arena_segment::member &m = *members++;
+        m.key = e.key;
+        arena_value &v = m.value;
+        v.d_kind = e.value.kind();
+        v.d_json = false;
+        v.d_uint = 0;
+        switch(v.d_kind) {
+          case meta_value::BOOL:
+            e.value.as(v.d_bool);
+            break;
+          case meta_value::INT64:
+            e.value.as(v.d_int);
+            break;
+          case meta_value::UINT64:
+            e.value.as(v.d_uint);
+            break;
+          case meta_value::DOUBLE:
+            e.value.as(v.d_double);
+            break;
+          case meta_value::STRING:
+            v.d_str.length = e.value.str().size();
+            v.d_str.data = d_arena.copy(e.value.str().data(), v.d_str.length);
+            break;
+          case meta_value::PMT: {
+            pmt::pmt_t val = e.value.to_pmt();
+            rapidjson::StringBuffer buffer;
+            json_writer writer(buffer);
+            try {
+              meta_value::serialize_pmt(writer, val);
+            } catch(const std::runtime_error &) {
+              // Not something JSON can hold, like a tuple
+            }
+            if(writer.IsComplete()) {
+              v.d_json = true;
+              v.d_str.length = buffer.GetSize();
+              v.d_str.data = d_arena.copy(buffer.GetString(), v.d_str.length);
+            } else {
+              d_pmts.push_back(val);
+              v.d_pmt = &d_pmts.back();
+            }
+            break;
+          }
+          default:
+            break;
+        }
+      }
+      d_segments.push_back(segment);
+    }
+
+    void
+    arena_segments::clear()
+    {
+      d_segments.clear();
+      d_segments.shrink_to_fit();
+      d_pmts.clear();
+      d_arena.clear();
+    }
+
+    size_t
+    arena_segments::memory_size() const
+    {
+      return d_arena.capacity() + d_segments.capacity() * sizeof(arena_segment) +
+             d_pmts.size() * sizeof(pmt::pmt_t);
+    }
+
+    void
+    load_metafile(FILE *fp,
+                  meta_namespace &global,
+                  std::vector<meta_namespace> &captures,
+                  arena_segments &annotations)
+    {
+      load_metafile(fp, 0, global, captures, [&](meta_namespace &annotation) {
+        annotations.push_back(annotation);
+      });
+    }
+
+  } // namespace sigmf
+} // namespace gr
@@ -0,0 +1,517 @@
+#include "meta_index.h"
+#include "meta_sax_handler.h"
+#include "writer_utils.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <rapidjson/filereadstream.h>
+#include <rapidjson/memorystream.h>
+#include <rapidjson/reader.h>
+
+// The index is mapped into memory, so it needs mmap. Elsewhere metadata
+// files are always parsed directly.
+#ifndef _WIN32
+#define SIGMF_HAVE_META_INDEX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace gr {
+  namespace sigmf {
+
+    namespace {
+      const char INDEX_MAGIC[8] = {'S', 'I', 'G', 'M', 'F', 'I', 'D', 'X'};
+      const uint32_t INDEX_VERSION = 1;
+      // Reads back differently on a machine with the other byte order
+      const uint32_t INDEX_BYTE_ORDER = 0x01020304;
+
+      struct meta_stat {
+        uint64_t inode;
+        uint64_t size;
+        int64_t mtime_sec;
+        int64_t mtime_nsec;
+      };
+
+#ifdef SIGMF_HAVE_META_INDEX
+      bool
+      stat_meta(const std::string &meta_path, meta_stat &st)
+      {
+        struct stat s;
+        if(::stat(meta_path.c_str(), &s) != 0) {
+          return false;
+        }
+        st.inode = s.st_ino;
+        st.size = s.st_size;
+#ifdef __APPLE__
+        st.mtime_sec = s.st_mtimespec.tv_sec;
+        st.mtime_nsec = s.st_mtimespec.tv_nsec;
+#else
+        st.mtime_sec = s.st_mtim.tv_sec;
+        st.mtime_nsec = s.st_mtim.tv_nsec;
+#endif
+        return true;
+      }
+#endif
+
+      bool
+      by_sample_start(const meta_index::entry &a, const meta_index::entry &b)
+      {
+        return a.sample_start < b.sample_start;
+      }
+
+      /**
+       * Finds the byte range of every segment in a metadata file, along
+       * with the sample_start and sample_count at its top level, without
+       * building any values.
+       */
+      class index_handler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, index_handler> {
+        public:
+        explicit index_handler(const rapidjson::FileReadStream &stream)
+        : d_stream(stream), d_depth(0), d_section(SECTION_OTHER), d_in_segment_array(false),
+          d_segment_depth(0), d_field(FIELD_NONE), d_has_global(false)
+        {
+        }
+
+        bool
+        Null()
+        {
+          return scalar();
+        }
+
+        bool
+        Bool(bool)
+        {
+          return scalar();
+        }
+
+        bool
+        Int(int i)
+        {
+          return i >= 0 ? number(i) : scalar();
+        }
+
+        bool
+        Uint(unsigned u)
+        {
+          return number(u);
+        }
+
+        bool
+        Int64(int64_t i)
+        {
+          return i >= 0 ? number(i) : scalar();
+        }
+
+        bool
+        Uint64(uint64_t u)
+        {
+          return number(u);
+        }
+
+        bool
+        Double(double)
+        {
+          return scalar();
+        }
+
+        bool
+        String(const char *, rapidjson::SizeType, bool)
+        {
+          return scalar();
+        }
+
+        bool
+        StartObject()
+        {
+          d_field = FIELD_NONE;
+          if(d_segment_depth == 0 && at_segment()) {
+            // The '{' has just been read
+            d_segment = meta_index::entry{0, 0, d_stream.Tell() - 1, 0};
+            d_segment_depth = d_depth + 1;
+          }
+          d_depth++;
+          return true;
+        }
+
+        bool
+        Key(const char *str, rapidjson::SizeType length, bool)
+        {
+          std::string key(str, length);
+          if(d_depth == 1) {
+            if(key == "global") {
+              d_section = SECTION_GLOBAL;
+            } else if(key == "captures") {
+              d_section = SECTION_CAPTURES;
+            } else if(key == "annotations") {
+              d_section = SECTION_ANNOTATIONS;
+            } else {
+              d_section = SECTION_OTHER;
+            }
+          } else if(d_depth == d_segment_depth) {
+            if(key == "core:sample_start") {
+              d_field = FIELD_SAMPLE_START;
+            } else if(key == "core:sample_count") {
+              d_field = FIELD_SAMPLE_COUNT;
+            } else {
+              d_field = FIELD_NONE;
+            }
+          }
+          return true;
+        }
+
+        bool
+        EndObject(rapidjson::SizeType)
+        {
+          d_field = FIELD_NONE;
+          if(d_depth == d_segment_depth) {
+            // The '}' has just been read
+            d_segment.json_length = d_stream.Tell() - d_segment.json_offset;
+            d_segment_depth = 0;
+            if(d_section == SECTION_GLOBAL) {
+              global = d_segment;
+              d_has_global = true;
+            } else if(d_section == SECTION_CAPTURES) {
+              captures.push_back(d_segment);
+            } else {
+              annotations.push_back(d_segment);
+            }
+          }
+          d_depth--;
+          return true;
+        }
+
+        bool
+        StartArray()
+        {
+          d_field = FIELD_NONE;
+          // The root and segments have to be objects
+          if(d_depth == 0 || (d_segment_depth == 0 && at_segment())) {
+            return false;
+          }
+          if(d_depth == 1 && (d_section == SECTION_CAPTURES || d_section == SECTION_ANNOTATIONS)) {
+            d_in_segment_array = true;
+          }
+          d_depth++;
+          return true;
+        }
+
+        bool
+        EndArray(rapidjson::SizeType)
+        {
+          d_depth--;
+          if(d_depth == 1) {
+            d_in_segment_array = false;
+          }
+          return true;
+        }
+
+        bool
+        has_global() const
+        {
+          return d_has_global;
+        }
+
+        meta_index::entry global;
+        std::vector<meta_index::entry> captures;
+        std::vector<meta_index::entry> annotations;
+
+        private:
+        enum section_t { SECTION_OTHER, SECTION_GLOBAL, SECTION_CAPTURES, SECTION_ANNOTATIONS };
+        enum field_t { FIELD_NONE, FIELD_SAMPLE_START, FIELD_SAMPLE_COUNT };
+
+        const rapidjson::FileReadStream &d_stream;
+        int d_depth;
+        section_t d_section;
+        bool d_in_segment_array;
+        // Depth inside the current segment's object, 0 outside segments
+        int d_segment_depth;
+        field_t d_field;
+        bool d_has_global;
+        meta_index::entry d_segment;
+
+        // true if an object starting now would be a segment
+        bool
+        at_segment() const
+        {
+          return (d_depth == 1 && d_section == SECTION_GLOBAL) ||
+                 (d_depth == 2 && d_in_segment_array);
+        }
+
+        bool
+        scalar()
+        {
+          d_field = FIELD_NONE;
+          // Only objects can go where a segment belongs
+          return d_depth > 0 && !(d_segment_depth == 0 && at_segment());
+        }
+
+        bool
+        number(uint64_t val)
+        {
+          if(d_field == FIELD_SAMPLE_START) {
+            d_segment.sample_start = val;
+          } else if(d_field == FIELD_SAMPLE_COUNT) {
+            d_segment.sample_count = val;
+          }
+          return scalar();
+        }
+      };
+
+      void
+      write_or_throw(FILE *fp, const void *data, size_t size)
+      {
+        if(size > 0 && std::fwrite(data, size, 1, fp) != 1) {
+          throw std::runtime_error("Unable to write metadata index");
+        }
+      }
+    } // namespace
+
+    struct meta_index::header {
+      char magic[8];
+      uint32_t version;
+      uint32_t byte_order;
+      uint64_t meta_inode;
+      uint64_t meta_size;
+      int64_t meta_mtime_sec;
+      int64_t meta_mtime_nsec;
+      entry global;
+      uint64_t num_captures;
+      uint64_t num_annotations;
+      // The longest annotation, so range queries know how far back an
+      // overlapping annotation could start
+      uint64_t max_annotation_count;
+    };
+
+    std::string
+    meta_index::index_path(const std::string &meta_path)
+    {
+      return meta_path + ".idx";
+    }
+
+    void
+    meta_index::build(const std::string &meta_path)
+    {
+#ifndef SIGMF_HAVE_META_INDEX
+      throw std::runtime_error("Metadata indexes aren't supported on this platform");
+#else
+      meta_stat before;
+      FILE *meta_fp = std::fopen(meta_path.c_str(), "r");
+      if(meta_fp == NULL || !stat_meta(meta_path, before)) {
+        if(meta_fp != NULL) {
+          std::fclose(meta_fp);
+        }
+        throw std::runtime_error("Unable to open metadata file " + meta_path);
+      }
+
+      char buffer[65536];
+      rapidjson::FileReadStream stream(meta_fp, buffer, sizeof(buffer));
+      index_handler handler(stream);
+      rapidjson::Reader reader;
+      rapidjson::ParseResult ok = reader.Parse(stream, handler);
+      std::fclose(meta_fp);
+      if(!ok || !handler.has_global()) {
+        throw std::runtime_error("Meta namespace parse error - invalid metadata.");
+      }
+
+      // Ties stay in file order
+      std::stable_sort(handler.captures.begin(), handler.captures.end(), by_sample_start);
+      std::stable_sort(handler.annotations.begin(), handler.annotations.end(), by_sample_start);
+
+      header h;
+      std::memset(&h, 0, sizeof(h));
+      std::memcpy(h.magic, INDEX_MAGIC, sizeof(h.magic));
+      h.version = INDEX_VERSION;
+      h.byte_order = INDEX_BYTE_ORDER;
+      h.meta_inode = before.inode;
+      h.meta_size = before.size;
+      h.meta_mtime_sec = before.mtime_sec;
+      h.meta_mtime_nsec = before.mtime_nsec;
+      h.global = handler.global;
+      h.num_captures = handler.captures.size();
+      h.num_annotations = handler.annotations.size();
+      for(const entry &e : handler.annotations) {
+        h.max_annotation_count = std::max(h.max_annotation_count, e.sample_count);
+      }
+
+      std::string path = index_path(meta_path);
+      std::string temp_path = writer_utils::unique_temp_path(path);
+      FILE *fp = std::fopen(temp_path.c_str(), "wb");
+      if(fp == NULL) {
+        throw std::runtime_error("Unable to open metadata index " + temp_path);
+      }
+      try {
+        write_or_throw(fp, &h, sizeof(h));
+        write_or_throw(fp, handler.captures.data(), handler.captures.size() * sizeof(entry));
+        write_or_throw(fp, handler.annotations.data(), handler.annotations.size() * sizeof(entry));
+      } catch(const std::runtime_error &) {
+        std::fclose(fp);
+        std::remove(temp_path.c_str());
+        throw;
+      }
+      std::fclose(fp);
+
+      // If the metadata changed while it was being read, this index
+      // would describe neither version
+      meta_stat after;
+      if(!stat_meta(meta_path, after) || after.inode != before.inode || after.size != before.size ||
+         after.mtime_sec != before.mtime_sec || after.mtime_nsec != before.mtime_nsec) {
+        std::remove(temp_path.c_str());
+        throw std::runtime_error("Metadata file changed while it was being indexed");
+      }
+      if(std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        throw std::runtime_error("Unable to write metadata index " + path);
+      }
+#endif
+    }
+
+    std::unique_ptr<meta_index>
+    meta_index::open(const std::string &meta_path, bool force_build)
+    {
+#ifndef SIGMF_HAVE_META_INDEX
+      return nullptr;
+#else
+      meta_stat st;
+      if(!stat_meta(meta_path, st)) {
+        return nullptr;
+      }
+
+      std::string path = index_path(meta_path);
+      for(int attempt = 0; attempt < 2; attempt++) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd >= 0) {
+          struct stat s;
+          void *map = MAP_FAILED;
+          if(::fstat(fd, &s) == 0 && static_cast<size_t>(s.st_size) >= sizeof(header)) {
+            map = ::mmap(NULL, s.st_size, PROT_READ, MAP_SHARED, fd, 0);
+          }
+          ::close(fd);
+          if(map != MAP_FAILED) {
+            const header *h = static_cast<const header *>(map);
+            uint64_t entries = (s.st_size - sizeof(header)) / sizeof(entry);
+            bool current = std::memcmp(h->magic, INDEX_MAGIC, sizeof(h->magic)) == 0 &&
+                           h->version == INDEX_VERSION && h->byte_order == INDEX_BYTE_ORDER &&
+                           h->meta_inode == st.inode && h->meta_size == st.size &&
+                           h->meta_mtime_sec == st.mtime_sec &&
+                           h->meta_mtime_nsec == st.mtime_nsec &&
+                           h->num_captures <= entries &&
+                           h->num_annotations <= entries - h->num_captures;
+            if(current) {
+              return std::unique_ptr<meta_index>(new meta_index(map, s.st_size));
+            }
+            ::munmap(map, s.st_size);
+          }
+        }
+
+        // Missing or stale
+        if(attempt > 0 || (!force_build && st.size < MIN_AUTO_META_SIZE)) {
+          break;
+        }
+        try {
+          build(meta_path);
+        } catch(const std::runtime_error &) {
+          // The JSON can still be read directly
+          break;
+        }
+        if(!stat_meta(meta_path, st)) {
+          break;
+        }
+      }
+      return nullptr;
+#endif
+    }
+
+    meta_index::meta_index(void *map, size_t size)
+    : d_map(map), d_size(size), d_header(static_cast<const header *>(map)),
+      d_captures(reinterpret_cast<const entry *>(d_header + 1)),
+      d_annotations(d_captures + d_header->num_captures)
+    {
+    }
+
+    meta_index::~meta_index()
+    {
+#ifdef SIGMF_HAVE_META_INDEX
+      ::munmap(d_map, d_size);
+#endif
+    }
+
+    const meta_index::entry &
+    meta_index::global() const
+    {
+      return d_header->global;
+    }
+
+    const meta_index::entry *
+    meta_index::captures_begin() const
+    {
+      return d_captures;
+    }
+
+    const meta_index::entry *
+    meta_index::captures_end() const
+    {
+      return d_captures + d_header->num_captures;
+    }
+
+    size_t
+    meta_index::num_captures() const
+    {
+      return d_header->num_captures;
+    }
+
+    const meta_index::entry *
+    meta_index::annotations_begin() const
+    {
+      return d_annotations;
+    }
+
+    const meta_index::entry *
+    meta_index::annotations_end() const
+    {
+      return d_annotations + d_header->num_annotations;
+    }
+
+    size_t
+    meta_index::num_annotations() const
+    {
+      return d_header->num_annotations;
+    }
+
+    std::vector<meta_index::entry>
+    meta_index::annotations_in(uint64_t start, uint64_t end) const
+    {
+      std::vector<entry> found;
+      uint64_t max_count = d_header->max_annotation_count;
+      entry key = {start >= max_count ? start - max_count : 0, 0, 0, 0};
+      for(const entry *it = std::lower_bound(annotations_begin(), annotations_end(), key,
+                                             by_sample_start);
+          it != annotations_end() && it->sample_start < end; ++it) {
+        if(it->sample_start >= start || it->sample_start + it->sample_count > start) {
+          found.push_back(*it);
+        }
+      }
+      return found;
+    }
+
+    meta_namespace
+    meta_index::load(FILE *meta_fp, const entry &e)
+    {
+      std::vector<char> json(e.json_length);
+      if(std::fseek(meta_fp, e.json_offset, SEEK_SET) != 0 ||
+         std::fread(json.data(), 1, json.size(), meta_fp) != json.size()) {
+        throw std::runtime_error("Unable to read metadata segment");
+      }
+      rapidjson::MemoryStream stream(json.data(), json.size());
+      meta_namespace_sax_handler handler;
+      rapidjson::Reader reader;
+      reader.Parse(stream, handler);
+      if(reader.HasParseError() || !handler.complete()) {
+        throw std::runtime_error("Meta namespace parse error - invalid metadata segment.");
+      }
+      return handler.take();
+    }
+
+  } // namespace sigmf
+} // namespace gr
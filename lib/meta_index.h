@@ -0,0 +1,111 @@
+#ifndef INCLUDED_SIGMF_META_INDEX_H
+#define INCLUDED_SIGMF_META_INDEX_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sigmf/meta_namespace.h>
+
+/**
+ * Binary index of a .sigmf-meta file
+ */
+namespace gr {
+  namespace sigmf {
+
+    /**
+     * A .sigmf-meta.idx file kept next to a metadata file. It holds the
+     * byte range in the JSON of the global object and of every capture
+     * and annotation segment, with each segment's sample_start and
+     * sample_count, sorted by sample_start. The file is mapped into
+     * memory, so opening one costs nothing no matter how many
+     * annotations there are, and segments are only parsed when they are
+     * loaded.
+     *
+     * An index records the inode, size and modification time of the
+     * metadata file it was built from, and is ignored once any of them
+     * changes. open() rebuilds it the next time, so writers don't need
+     * to do anything to keep it up to date. Indexes are only built
+     * automatically for metadata files of at least MIN_AUTO_META_SIZE
+     * bytes, smaller ones parse quickly enough.
+     *
+     * The layout is the host's byte order; an index from a machine with
+     * the other byte order is ignored and rebuilt. On Windows there is
+     * no index: open() always returns NULL and build() throws.
+     */
+    class meta_index {
+      public:
+      struct entry {
+        uint64_t sample_start;
+        uint64_t sample_count;
+        // Byte range of the segment's object in the metadata file
+        uint64_t json_offset;
+        uint64_t json_length;
+      };
+
+      static const uint64_t MIN_AUTO_META_SIZE = 1 << 20;
+
+      //! path of the index for the metadata file at meta_path
+      static std::string index_path(const std::string &meta_path);
+
+      /**
+       * Open the index for the metadata file at meta_path if there is a
+       * current one. Otherwise build it first if the metadata file is
+       * big enough, or always if force_build is set. Returns NULL if
+       * there is no usable index; failing to build one is not an error.
+       */
+      static std::unique_ptr<meta_index> open(const std::string &meta_path,
+                                              bool force_build = false);
+
+      /**
+       * Parse the metadata file at meta_path and write its index.
+       * The index is written to a temporary file and renamed into
+       * place, so readers never see a partial index.
+       * @exception std::runtime_error the metadata can't be parsed or
+       * the index can't be written
+       */
+      static void build(const std::string &meta_path);
+
+      ~meta_index();
+
+      const entry &global() const;
+
+      const entry *captures_begin() const;
+      const entry *captures_end() const;
+      size_t num_captures() const;
+
+      const entry *annotations_begin() const;
+      const entry *annotations_end() const;
+      size_t num_annotations() const;
+
+      /**
+       * Annotations that overlap the samples [start, end), in order of
+       * sample_start. An annotation with a sample_count of 0 overlaps
+       * the range if it starts in it.
+       */
+      std::vector<entry> annotations_in(uint64_t start, uint64_t end) const;
+
+      /**
+       * Parse one segment out of the metadata file this index was
+       * built from.
+       * @exception std::runtime_error the segment can't be read or parsed
+       */
+      static meta_namespace load(FILE *meta_fp, const entry &e);
+
+      private:
+      struct header;
+
+      meta_index(void *map, size_t size);
+
+      void *d_map;
+      size_t d_size;
+      const header *d_header;
+      const entry *d_captures;
+      const entry *d_annotations;
+    };
+
+  } // namespace sigmf
+} // namespace gr
+
+#endif /* INCLUDED_SIGMF_META_INDEX_H */
@@ -0,0 +1,124 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <sigmf/meta_key.h>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/shared_mutex.hpp>
+
+namespace gr {
+  namespace sigmf {
+
+    namespace {
+      // In the order of meta_key::core_field
+      const char *CORE_FIELD_KEYS[] = {
+        "core:sample_start", "core:sample_count", "core:frequency", "core:datetime"};
+
+      // Hashes are computed once, when a key is first interned
+      struct key_table {
+        boost::shared_mutex mutex;
+        std::unordered_map<std::string, std::unique_ptr<meta_key>> keys;
+      };
+
+      key_table &
+      table()
+      {
+        static key_table t;
+        return t;
+      }
+
+      // Same as the \w of the regex this replaced
+      bool
+      is_word_char(char c)
+      {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+               c == '_';
+      }
+    } // namespace
+
+    meta_key::meta_key(const std::string &key, size_t hash)
+    : d_str(key), d_valid(is_valid_key(key)), d_hash(hash),
+      d_symbol(pmt::string_to_symbol(key)), d_field(NOT_CORE)
+    {
+      for(int i = 0; i < NUM_CORE_FIELDS; i++) {
+        if(key == CORE_FIELD_KEYS[i]) {
+          d_field = static_cast<core_field>(i);
+        }
+      }
+      if(d_valid) {
+        size_t colon = key.find(':');
+        d_ns = key.substr(0, colon);
+        d_name = key.substr(colon + 1);
+      }
+    }
+
+    bool
+    meta_key::is_valid_key(const std::string &key)
+    {
+      size_t colon = std::string::npos;
+      for(size_t i = 0; i < key.size(); i++) {
+        if(key[i] == ':' && colon == std::string::npos) {
+          colon = i;
+        } else if(!is_word_char(key[i])) {
+          return false;
+        }
+      }
+      return colon != std::string::npos && colon > 0 && colon + 1 < key.size();
+    }
+
+    const meta_key &
+    meta_key::core(core_field field)
+    {
+      static const meta_key *const keys[NUM_CORE_FIELDS] = {
+        &intern(CORE_FIELD_KEYS[SAMPLE_START]), &intern(CORE_FIELD_KEYS[SAMPLE_COUNT]),
+        &intern(CORE_FIELD_KEYS[FREQUENCY]), &intern(CORE_FIELD_KEYS[DATETIME])};
+      return *keys[field];
+    }
+
+    const meta_key *
+    meta_key::lookup(const std::string &key)
+    {
+      key_table &t = table();
+      boost::shared_lock<boost::shared_mutex> lock(t.mutex);
+      auto it = t.keys.find(key);
+      return it == t.keys.end() ? NULL : it->second.get();
+    }
+
+    const meta_key &
+    meta_key::intern(const std::string &key)
+    {
+      const meta_key *found = lookup(key);
+      if(found != NULL) {
+        return *found;
+      }
+      key_table &t = table();
+      boost::unique_lock<boost::shared_mutex> lock(t.mutex);
+      // Another thread may have added it since the lookup
+      std::unique_ptr<meta_key> &slot = t.keys[key];
+      if(!slot) {
+        slot.reset(new meta_key(key, std::hash<std::string>()(key)));
+      }
+      return *slot;
+    }
+
+  } // namespace sigmf
+} // namespace gr
@@ -0,0 +1,228 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <sigmf/meta_map.h>
+#include <algorithm>
+#include <functional>
+
+namespace gr {
+  namespace sigmf {
+
+    namespace {
+      const size_t MIN_SLOTS = 8;
+    }
+
+    meta_value::meta_value() : d_kind(NIL), d_uint(0)
+    {
+    }
+
+    meta_value::meta_value(int val) : d_kind(INT64), d_int(val)
+    {
+    }
+
+    meta_value::meta_value(long val) : d_kind(INT64), d_int(val)
+    {
+    }
+
+    meta_value::meta_value(unsigned long val) : d_kind(UINT64), d_uint(val)
+    {
+    }
+
+    meta_value::meta_value(unsigned long long val) : d_kind(UINT64), d_uint(val)
+    {
+    }
+
+    meta_value::meta_value(double val) : d_kind(DOUBLE), d_double(val)
+    {
+    }
+
+    meta_value::meta_value(const std::string &val) : d_kind(STRING), d_uint(0), d_str(val)
+    {
+    }
+
+    meta_value::meta_value(const char *val) : d_kind(STRING), d_uint(0), d_str(val)
+    {
+    }
+
+    meta_value::meta_value(const pmt::pmt_t &val) : d_kind(PMT), d_uint(0)
+    {
+      if(pmt::is_null(val)) {
+        d_kind = NIL;
+      } else if(pmt::is_bool(val)) {
+        d_kind = BOOL;
+        d_bool = pmt::to_bool(val);
+      } else if(pmt::is_integer(val)) {
+        d_kind = INT64;
+        d_int = pmt::to_long(val);
+      } else if(pmt::is_uint64(val)) {
+        d_kind = UINT64;
+        d_uint = pmt::to_uint64(val);
+      } else if(pmt::is_real(val)) {
+        d_kind = DOUBLE;
+        d_double = pmt::to_double(val);
+      } else if(pmt::is_symbol(val)) {
+        d_kind = STRING;
+        d_str = pmt::symbol_to_string(val);
+      } else {
+        d_pmt = val;
+      }
+    }
+
+    meta_value
+    meta_value::from_bool(bool val)
+    {
+      meta_value v;
+      v.d_kind = BOOL;
+      v.d_bool = val;
+      return v;
+    }
+
+    pmt::pmt_t
+    meta_value::to_pmt() const
+    {
+      switch(d_kind) {
+        case BOOL:
+          return pmt::from_bool(d_bool);
+        case INT64:
+          return pmt::from_long(d_int);
+        case UINT64:
+          return pmt::from_uint64(d_uint);
+        case DOUBLE:
+          return pmt::from_double(d_double);
+        case STRING:
+          return pmt::string_to_symbol(d_str);
+        case PMT:
+          return d_pmt;
+        default:
+          return pmt::get_PMT_NIL();
+      }
+    }
+
+    meta_map::meta_map() : d_core()
+    {
+    }
+
+    size_t
+    meta_map::find_slot(const meta_key &key) const
+    {
+      size_t mask = d_slots.size() - 1;
+      size_t slot = key.hash() & mask;
+      while(d_slots[slot] != 0 && d_entries[d_slots[slot] - 1].key != &key) {
+        slot = (slot + 1) & mask;
+      }
+      return slot;
+    }
+
+    const meta_value *
+    meta_map::find(const meta_key &key) const
+    {
+      if(key.field() != meta_key::NOT_CORE) {
+        return find(key.field());
+      }
+      if(d_entries.empty()) {
+        return NULL;
+      }
+      uint32_t index = d_slots[find_slot(key)];
+      return index == 0 ? NULL : &d_entries[index - 1].value;
+    }
+
+    meta_value *
+    meta_map::find(const meta_key &key)
+    {
+      return const_cast<meta_value *>(static_cast<const meta_map *>(this)->find(key));
+    }
+
+    const meta_value *
+    meta_map::find(const std::string &key) const
+    {
+      // A key that was never interned can't be in any map
+      const meta_key *interned = meta_key::lookup(key);
+      return interned == NULL ? NULL : find(*interned);
+    }
+
+    void
+    meta_map::set(const meta_key &key, const meta_value &val)
+    {
+      // Keep the table at most half full
+      if((d_entries.size() + 1) * 2 > d_slots.size()) {
+        rehash(std::max(MIN_SLOTS, d_slots.size() * 2));
+      }
+      size_t slot = find_slot(key);
+      if(d_slots[slot] != 0) {
+        d_entries[d_slots[slot] - 1].value = val;
+      } else {
+        d_entries.push_back(entry{&key, val});
+        d_slots[slot] = d_entries.size();
+        if(key.field() != meta_key::NOT_CORE) {
+          d_core[key.field()] = d_entries.size();
+        }
+      }
+    }
+
+    bool
+    meta_map::erase(const meta_key &key)
+    {
+      if(d_entries.empty()) {
+        return false;
+      }
+      uint32_t index = d_slots[find_slot(key)];
+      if(index == 0) {
+        return false;
+      }
+      // Deletes are rare, so keep the entries in order and rebuild the
+      // table rather than leaving tombstones in it
+      d_entries.erase(d_entries.begin() + (index - 1));
+      rehash(d_slots.size());
+      return true;
+    }
+
+    void
+    meta_map::reserve(size_t count)
+    {
+      d_entries.reserve(count);
+      size_t num_slots = std::max(MIN_SLOTS, d_slots.size());
+      while(count * 2 > num_slots) {
+        num_slots *= 2;
+      }
+      if(num_slots != d_slots.size()) {
+        rehash(num_slots);
+      }
+    }
+
+    void
+    meta_map::rehash(size_t num_slots)
+    {
+      d_slots.assign(num_slots, 0);
+      std::fill(d_core, d_core + meta_key::NUM_CORE_FIELDS, 0);
+      size_t mask = num_slots - 1;
+      for(size_t i = 0; i < d_entries.size(); i++) {
+        if(d_entries[i].key->field() != meta_key::NOT_CORE) {
+          d_core[d_entries[i].key->field()] = i + 1;
+        }
+        size_t slot = d_entries[i].key->hash() & mask;
+        while(d_slots[slot] != 0) {
+          slot = (slot + 1) & mask;
+        }
+        d_slots[slot] = i + 1;
+      }
+    }
+
+  } // namespace sigmf
+} // namespace gr
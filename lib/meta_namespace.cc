@@ -19,46 +19,305 @@
  */
 
 #include "sigmf/meta_namespace.h"
-#include <boost/regex.hpp>
+#include "meta_sax_handler.h"
+#include "metafile_layout.h"
+#include <gnuradio/thread/thread.h>
 #include <rapidjson/filereadstream.h>
+#include <rapidjson/memorystream.h>
 #include <rapidjson/prettywriter.h>
 #include <rapidjson/reader.h>
 #include <rapidjson/writer.h>
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <sys/stat.h>
+#include <vector>
 
 using namespace rapidjson;
 namespace gr {
   namespace sigmf {
 
+    namespace {
+      // Below this, splitting the annotations up costs more than it saves
+      const off_t PARALLEL_LOAD_MIN_SIZE = 4 << 20;
+      // Annotation JSON each thread parses before the annotations are
+      // handed over, when they're handed over one at a time
+      const size_t HANDOVER_SLICE_SIZE = 1 << 20;
+
+      typedef std::function<void(meta_namespace &)> annotation_callback;
+
+      template <typename InputStream>
+      void
+      parse_metafile(InputStream &stream,
+                     meta_namespace &global,
+                     std::vector<meta_namespace> &captures,
+                     const annotation_callback &on_annotation,
+                     annotations_end *end = NULL)
+      {
+        metafile_sax_handler handler(global, captures, on_annotation);
+        if(end) {
+          handler.track_annotations_end([&stream]() { return stream.Tell(); }, end);
+        }
+        Reader reader;
+        ParseResult ok = reader.Parse(stream, handler);
+
+        if(!ok || !handler.has_global()) {
+          throw std::runtime_error("Meta namespace parse error - invalid metadata.");
+        }
+      }
+
+      size_t
+      resolve_num_threads(size_t num_threads)
+      {
+        if(num_threads == 0) {
+          num_threads = std::max(1u, gr::thread::thread::hardware_concurrency());
+        }
+        return num_threads;
+      }
+
+      // Read fp from its current position to the end if it's worth
+      // splitting across threads. Pipes and small files are left to be
+      // parsed as they're read.
+      bool
+      read_for_parallel(FILE *fp, size_t num_threads, std::vector<char> &json)
+      {
+        struct stat st;
+        long position = std::ftell(fp);
+        if(num_threads == 1 || position < 0 || fstat(fileno(fp), &st) != 0 ||
+           !S_ISREG(st.st_mode) || st.st_size - position < PARALLEL_LOAD_MIN_SIZE) {
+          return false;
+        }
+
+        // Read rather than mapped: a file that's truncated while it's
+        // mapped kills the process instead of failing to parse, and the
+        // annotation sink rewrites metadata files in place. This costs a
+        // copy of the file, see the doc comment.
+        // One byte spare, so a full buffer means the file grew since the stat
+        json.resize(st.st_size - position + 1);
+        size_t length = std::fread(json.data(), 1, json.size(), fp);
+        while(length == json.size()) {
+          json.resize(json.size() * 2);
+          length += std::fread(json.data() + length, 1, json.size() - length, fp);
+        }
+        json.resize(length);
+        return true;
+      }
+
+      // Everything but the annotations array, which is cut out
+      void
+      parse_outside_annotations(const std::vector<char> &json,
+                                const metafile_layout &layout,
+                                meta_namespace &global,
+                                std::vector<meta_namespace> &captures)
+      {
+        std::string rest(json.data(), layout.annotations_open + 1);
+        rest.append(json.data() + layout.annotations_close,
+                    json.size() - layout.annotations_close);
+        MemoryStream stream(rest.data(), rest.size());
+        parse_metafile(stream, global, captures, [](meta_namespace &) {});
+      }
+
+      // Parse the annotations [first, last) of the layout into out
+      void
+      parse_annotations(const std::vector<char> &json,
+                        const metafile_layout &layout,
+                        size_t first,
+                        size_t last,
+                        meta_namespace *out)
+      {
+        meta_namespace_sax_handler handler;
+        Reader reader;
+        for(size_t i = first; i < last; i++) {
+          const metafile_layout::range &segment = layout.annotations[i];
+          MemoryStream stream(json.data() + segment.offset, segment.length);
+          handler.reset();
+          reader.Parse(stream, handler);
+          if(reader.HasParseError() || !handler.complete()) {
+            throw std::runtime_error("Meta namespace parse error - invalid metadata.");
+          }
+          out[i - first] = handler.take();
+        }
+      }
+
+      // Split the annotations into num_slices slices of about the same
+      // number of bytes. Slice i is [bounds[i], bounds[i + 1]).
+      std::vector<size_t>
+      slice_bounds(const metafile_layout &layout, size_t num_slices)
+      {
+        size_t num_annotations = layout.annotations.size();
+        size_t annotation_bytes = layout.annotations_close - layout.annotations_open;
+        std::vector<size_t> bounds(num_slices + 1, num_annotations);
+        bounds[0] = 0;
+        for(size_t i = 1; i < num_slices; i++) {
+          size_t target = layout.annotations_open + annotation_bytes * i / num_slices;
+          bounds[i] = std::lower_bound(layout.annotations.begin(), layout.annotations.end(),
+                                       target,
+                                       [](const metafile_layout::range &r, size_t offset) {
+                                         return r.offset < offset;
+                                       }) -
+                      layout.annotations.begin();
+        }
+        return bounds;
+      }
+
+      // Run task(0) to task(count - 1) at once, task(0) on this thread,
+      // and rethrow the first error once they've all finished
+      void
+      run_tasks(size_t count, const std::function<void(size_t)> &task)
+      {
+        std::vector<std::exception_ptr> errors(count);
+        std::vector<gr::thread::thread> threads;
+        for(size_t i = 1; i < count; i++) {
+          threads.emplace_back([&, i]() {
+            try {
+              task(i);
+            } catch(...) {
+              errors[i] = std::current_exception();
+            }
+          });
+        }
+        try {
+          task(0);
+        } catch(...) {
+          errors[0] = std::current_exception();
+        }
+        for(gr::thread::thread &t : threads) {
+          t.join();
+        }
+        for(const std::exception_ptr &error : errors) {
+          if(error) {
+            std::rethrow_exception(error);
+          }
+        }
+      }
+
+      metafile_namespaces
+      load_metafile_sequential(FILE *fp, annotations_end &end)
+      {
+        metafile_namespaces meta_ns;
+        char buffer[65536];
+        FileReadStream file_stream(fp, buffer, sizeof(buffer));
+        parse_metafile(file_stream, meta_ns.global, meta_ns.captures,
+                       [&](meta_namespace &annotation) {
+                         meta_ns.annotations.push_back(std::move(annotation));
+                       },
+                       &end);
+        return meta_ns;
+      }
+    } // namespace
+
     metafile_namespaces
     load_metafile(FILE *fp)
     {
-      char buffer[65536];
-      metafile_namespaces meta_ns;
-      FileReadStream file_stream(fp, buffer, sizeof(buffer));
-      Document doc;
-      doc.ParseStream<0, UTF8<>, FileReadStream>(file_stream);
+      return load_metafile(fp, 0);
+    }
+
+    metafile_namespaces
+    load_metafile(FILE *fp, size_t num_threads)
+    {
+      annotations_end end;
+      return load_metafile(fp, num_threads, end);
+    }
+
+    metafile_namespaces
+    load_metafile(FILE *fp, size_t num_threads, annotations_end &end)
+    {
+      num_threads = resolve_num_threads(num_threads);
+      std::vector<char> json;
+      if(!read_for_parallel(fp, num_threads, json)) {
+        return load_metafile_sequential(fp, end);
+      }
 
-      if(doc.HasParseError()) {
-        throw std::runtime_error("Meta namespace parse error - invalid metadata.");
+      metafile_namespaces meta_ns;
+      metafile_layout layout;
+      if(!find_metafile_layout(json.data(), json.size(), layout)) {
+        MemoryStream stream(json.data(), json.size());
+        parse_metafile(stream, meta_ns.global, meta_ns.captures,
+                       [&](meta_namespace &annotation) {
+                         meta_ns.annotations.push_back(std::move(annotation));
+                       },
+                       &end);
+        return meta_ns;
       }
+      // The layout already has it
+      end.num_arrays = 1;
+      end.count = layout.annotations.size();
+      end.append_offset = layout.annotations.empty()
+                            ? layout.annotations_open + 1
+                            : layout.annotations.back().offset + layout.annotations.back().length;
+      end.close = layout.annotations_close;
+
+      // One slice per thread, each parsed straight into its place.
+      // Meanwhile this thread parses everything else, then the first slice.
+      size_t num_annotations = layout.annotations.size();
+      meta_ns.annotations.resize(num_annotations);
+      size_t num_slices = std::max<size_t>(1, std::min(num_threads, num_annotations));
+      std::vector<size_t> bounds = slice_bounds(layout, num_slices);
+      run_tasks(num_slices, [&](size_t i) {
+        if(i == 0) {
+          parse_outside_annotations(json, layout, meta_ns.global, meta_ns.captures);
+        }
+        parse_annotations(json, layout, bounds[i], bounds[i + 1],
+                          meta_ns.annotations.data() + bounds[i]);
+      });
+      return meta_ns;
+    }
 
-      meta_ns.global = json_value_to_pmt(doc["global"]);
-      size_t num_captures = doc["captures"].Size();
+    void
+    load_metafile(FILE *fp,
+                  meta_namespace &global,
+                  std::vector<meta_namespace> &captures,
+                  const std::function<void(meta_namespace &)> &on_annotation)
+    {
+      char buffer[65536];
+      FileReadStream file_stream(fp, buffer, sizeof(buffer));
+      parse_metafile(file_stream, global, captures, on_annotation);
+    }
 
-      for(size_t i = 0; i < num_captures; i++) {
-        meta_ns.captures.push_back(json_value_to_pmt(doc["captures"][i]));
+    void
+    load_metafile(FILE *fp,
+                  size_t num_threads,
+                  meta_namespace &global,
+                  std::vector<meta_namespace> &captures,
+                  const std::function<void(meta_namespace &)> &on_annotation)
+    {
+      num_threads = resolve_num_threads(num_threads);
+      std::vector<char> json;
+      if(!read_for_parallel(fp, num_threads, json)) {
+        load_metafile(fp, global, captures, on_annotation);
+        return;
       }
-      size_t num_annotations;
-      if(doc.HasMember("annotations")) {
-        num_annotations = doc["annotations"].Size();
-      } else {
-        num_annotations = 0;
+
+      metafile_layout layout;
+      if(!find_metafile_layout(json.data(), json.size(), layout)) {
+        MemoryStream stream(json.data(), json.size());
+        parse_metafile(stream, global, captures, on_annotation);
+        return;
       }
+      parse_outside_annotations(json, layout, global, captures);
 
-      for(size_t i = 0; i < num_annotations; i++) {
-        meta_ns.annotations.push_back(json_value_to_pmt(doc["annotations"][i]));
+      // Slices of about HANDOVER_SLICE_SIZE, num_threads at a time. Each
+      // round is handed over and freed before the next is parsed.
+      size_t num_annotations = layout.annotations.size();
+      size_t annotation_bytes = layout.annotations_close - layout.annotations_open;
+      size_t num_slices = std::max(num_threads, annotation_bytes / HANDOVER_SLICE_SIZE);
+      num_slices = std::max<size_t>(1, std::min(num_slices, num_annotations));
+      std::vector<size_t> bounds = slice_bounds(layout, num_slices);
+      std::vector<std::vector<meta_namespace>> round(num_threads);
+      for(size_t first = 0; first < num_slices; first += num_threads) {
+        size_t count = std::min(num_threads, num_slices - first);
+        run_tasks(count, [&](size_t i) {
+          size_t slice = first + i;
+          round[i].resize(bounds[slice + 1] - bounds[slice]);
+          parse_annotations(json, layout, bounds[slice], bounds[slice + 1], round[i].data());
+        });
+        for(size_t i = 0; i < count; i++) {
+          for(meta_namespace &annotation : round[i]) {
+            on_annotation(annotation);
+          }
+          round[i].clear();
+        }
       }
-      return meta_ns;
     }
 
     pmt::pmt_t
@@ -134,13 +393,31 @@ namespace gr {
       return ns;
     }
 
-    meta_namespace::meta_namespace(pmt::pmt_t data) : d_data(data)
+    meta_namespace::meta_namespace(pmt::pmt_t data)
+    {
+      if(!pmt::is_dict(data)) {
+        throw std::invalid_argument("meta_namespace data must be a dict");
+      }
+      // dict_add puts new keys at the front, so walk backwards to add them
+      // in the order they were added to the dict
+      pmt::pmt_t items = pmt::dict_items(data);
+      std::vector<pmt::pmt_t> pairs;
+      for(; pmt::is_pair(items); items = pmt::cdr(items)) {
+        pairs.push_back(pmt::car(items));
+      }
+      d_data.reserve(pairs.size());
+      for(auto it = pairs.rbegin(); it != pairs.rend(); ++it) {
+        d_data.set(meta_key::intern(pmt::symbol_to_string(pmt::car(*it))),
+                   meta_value(pmt::cdr(*it)));
+      }
+    }
+
+    meta_namespace::meta_namespace(meta_map data) : d_data(std::move(data))
     {
     }
 
     meta_namespace::meta_namespace()
     {
-      d_data = pmt::make_dict();
     }
 
     meta_namespace::~meta_namespace()
@@ -150,33 +427,40 @@ namespace gr {
     pmt::pmt_t
     meta_namespace::data()
     {
-      return d_data;
+      return get();
     }
 
     void
     meta_namespace::set(const std::string &key, pmt::pmt_t val)
     {
-      if(!validate_key(key)) {
-        throw std::invalid_argument("key format is invalid:'" + key + "'");
+      set(meta_key::intern(key), meta_value(val));
+    }
+
+    void
+    meta_namespace::set(const meta_key &key, const meta_value &val)
+    {
+      if(!key.valid()) {
+        throw std::invalid_argument("key format is invalid:'" + key.str() + "'");
       }
-      d_data = pmt::dict_add(d_data, pmt::mp(key), val);
+      d_data.set(key, val);
     }
 
     pmt::pmt_t
     meta_namespace::get(const std::string &key) const
     {
-      return get(pmt::mp(key));
+      return get(key, pmt::get_PMT_NIL());
     }
 
     pmt::pmt_t
     meta_namespace::get(const std::string &key, pmt::pmt_t default_val) const
     {
-      return get(pmt::mp(key), default_val);
+      const meta_value *val = d_data.find(key);
+      return val == NULL ? default_val : val->to_pmt();
     }
 
     pmt::pmt_t
     meta_namespace::get(pmt::pmt_t key, pmt::pmt_t default_val) const {
-      return pmt::dict_ref(d_data, key, default_val);
+      return get(pmt::symbol_to_string(key), default_val);
     }
 
     pmt::pmt_t
@@ -188,35 +472,48 @@ namespace gr {
     pmt::pmt_t
     meta_namespace::get() const
     {
-      return d_data;
+      // Built newest first, like dict_add would have
+      pmt::pmt_t dict = pmt::make_dict();
+      for(const meta_map::entry &e : d_data) {
+        dict = pmt::acons(e.key->symbol(), e.value.to_pmt(), dict);
+      }
+      return dict;
     }
 
     std::string
     meta_namespace::get_str(const std::string &key) const
     {
-      pmt::pmt_t ref = pmt::dict_ref(d_data, pmt::mp(key), pmt::get_PMT_NIL());
-      if(pmt::eqv(ref, pmt::get_PMT_NIL())) {
+      const meta_value *val = d_data.find(key);
+      if(val == NULL || val->kind() == meta_value::NIL) {
         throw std::runtime_error("key not found");
-      } else if(!pmt::is_symbol(ref)) {
+      } else if(val->kind() != meta_value::STRING) {
         throw std::runtime_error("val is not str");
       }
-      return pmt::symbol_to_string(ref);
+      return val->str();
     }
 
     bool
     meta_namespace::has(const std::string &key) const
     {
-      return pmt::dict_has_key(d_data, pmt::mp(key));
+      return d_data.find(key) != NULL;
     }
 
     std::set<std::string>
     meta_namespace::keys() const
     {
-      pmt::pmt_t keys_pmt = pmt::dict_keys(d_data);
       std::set<std::string> keys;
-      size_t num_keys = pmt::length(keys_pmt);
-      for(size_t i = 0; i < num_keys; i++) {
-        keys.insert(pmt::symbol_to_string(pmt::nth(i, keys_pmt)));
+      for(const meta_map::entry &e : d_data) {
+        keys.insert(e.key->str());
+      }
+      return keys;
+    }
+
+    std::set<pmt::pmt_t>
+    meta_namespace::pmt_keys() const
+    {
+      std::set<pmt::pmt_t> keys;
+      for(const meta_map::entry &e : d_data) {
+        keys.insert(e.key->symbol());
       }
       return keys;
     }
@@ -224,20 +521,22 @@ namespace gr {
     bool
     meta_namespace::validate_key(const std::string &key)
     {
-      boost::regex key_regex("(^\\w+:\\w+$)");
-      return boost::regex_match(key, key_regex);
+      return meta_key::intern(key).valid();
     }
 
     void
     meta_namespace::del(const std::string &key)
     {
-      d_data = pmt::dict_delete(d_data, pmt::mp(key));
+      const meta_key *interned = meta_key::lookup(key);
+      if(interned != NULL) {
+        d_data.erase(*interned);
+      }
     }
 
     void
     meta_namespace::print() const
     {
-      pmt::print(d_data);
+      pmt::print(get());
     }
 
   } // namespace sigmf
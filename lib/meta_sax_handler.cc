@@ -0,0 +1,409 @@
+#include "meta_sax_handler.h"
+#include <cstring>
+
+namespace gr {
+  namespace sigmf {
+
+    static const char *SAMPLE_RATE_KEY_STR = "core:sample_rate";
+
+    meta_namespace_sax_handler::meta_namespace_sax_handler()
+    : d_started(false), d_complete(false), d_in_nested(false), d_coerce_to_double(false),
+      d_key(NULL)
+    {
+    }
+
+    bool
+    meta_namespace_sax_handler::complete() const
+    {
+      return d_complete;
+    }
+
+    meta_namespace
+    meta_namespace_sax_handler::take()
+    {
+      return meta_namespace(std::move(d_data));
+    }
+
+    void
+    meta_namespace_sax_handler::reset()
+    {
+      d_started = false;
+      d_complete = false;
+      d_in_nested = false;
+      d_coerce_to_double = false;
+      d_key = NULL;
+      d_data = meta_map();
+      d_nested.reset();
+    }
+
+    bool
+    meta_namespace_sax_handler::add_value(const meta_value &val)
+    {
+      // Only valid directly inside the object, after a key
+      if(!d_started || d_complete || d_key == NULL) {
+        return false;
+      }
+      d_data.set(*d_key, val);
+      d_key = NULL;
+      d_coerce_to_double = false;
+      return true;
+    }
+
+    bool
+    meta_namespace_sax_handler::add_number(const meta_value &val, double as_double)
+    {
+      if(d_coerce_to_double) {
+        // Coerce this to a double to prevent badness, same as json_value_to_pmt
+        return add_value(meta_value(as_double));
+      }
+      return add_value(val);
+    }
+
+    bool
+    meta_namespace_sax_handler::nested_event(bool ok)
+    {
+      if(!ok) {
+        return false;
+      }
+      if(d_nested.complete()) {
+        d_in_nested = false;
+        d_coerce_to_double = false;
+        pmt::pmt_t val = d_nested.result();
+        d_nested.reset();
+        return add_value(meta_value(val));
+      }
+      return true;
+    }
+
+    bool
+    meta_namespace_sax_handler::Null()
+    {
+      if(d_in_nested) {
+        return nested_event(d_nested.Null());
+      }
+      return add_value(meta_value());
+    }
+
+    bool
+    meta_namespace_sax_handler::Bool(bool b)
+    {
+      if(d_in_nested) {
+        return nested_event(d_nested.Bool(b));
+      }
+      return add_value(meta_value::from_bool(b));
+    }
+
+    // Non-negative integers are uint64, like pmt_sax_handler
+    bool
+    meta_namespace_sax_handler::Int(int i)
+    {
+      if(d_in_nested) {
+        return nested_event(d_nested.Int(i));
+      }
+      if(i >= 0) {
+        return add_number(meta_value(static_cast<uint64_t>(i)), i);
+      }
+      return add_number(meta_value(static_cast<int64_t>(i)), i);
+    }
+
+    bool
+    meta_namespace_sax_handler::Uint(unsigned u)
+    {
+      if(d_in_nested) {
+        return nested_event(d_nested.Uint(u));
+      }
+      return add_number(meta_value(static_cast<uint64_t>(u)), u);
+    }
+
+    bool
+    meta_namespace_sax_handler::Int64(int64_t i)
+    {
+      if(d_in_nested) {
+        return nested_event(d_nested.Int64(i));
+      }
+      if(i >= 0) {
+        return add_number(meta_value(static_cast<uint64_t>(i)), static_cast<double>(i));
+      }
+      return add_number(meta_value(i), static_cast<double>(i));
+    }
+
+    bool
+    meta_namespace_sax_handler::Uint64(uint64_t u)
+    {
+      if(d_in_nested) {
+        return nested_event(d_nested.Uint64(u));
+      }
+      return add_number(meta_value(u), static_cast<double>(u));
+    }
+
+    bool
+    meta_namespace_sax_handler::Double(double d)
+    {
+      if(d_in_nested) {
+        return nested_event(d_nested.Double(d));
+      }
+      return add_number(meta_value(d), d);
+    }
+
+    bool
+    meta_namespace_sax_handler::String(const char *str, rapidjson::SizeType length, bool copy)
+    {
+      if(d_in_nested) {
+        return nested_event(d_nested.String(str, length, copy));
+      }
+      return add_value(meta_value(std::string(str, length)));
+    }
+
+    bool
+    meta_namespace_sax_handler::StartObject()
+    {
+      if(d_in_nested) {
+        return nested_event(d_nested.StartObject());
+      }
+      if(!d_started) {
+        d_started = true;
+        return true;
+      }
+      if(d_complete || d_key == NULL) {
+        return false;
+      }
+      d_in_nested = true;
+      return nested_event(d_nested.StartObject());
+    }
+
+    bool
+    meta_namespace_sax_handler::Key(const char *str, rapidjson::SizeType length, bool copy)
+    {
+      if(d_in_nested) {
+        return nested_event(d_nested.Key(str, length, copy));
+      }
+      d_key = &meta_key::intern(std::string(str, length));
+      d_coerce_to_double = (length == std::strlen(SAMPLE_RATE_KEY_STR)) &&
+        std::strncmp(str, SAMPLE_RATE_KEY_STR, length) == 0;
+      return true;
+    }
+
+    bool
+    meta_namespace_sax_handler::EndObject(rapidjson::SizeType member_count)
+    {
+      if(d_in_nested) {
+        return nested_event(d_nested.EndObject(member_count));
+      }
+      d_complete = true;
+      return true;
+    }
+
+    bool
+    meta_namespace_sax_handler::StartArray()
+    {
+      if(d_in_nested) {
+        return nested_event(d_nested.StartArray());
+      }
+      // The root has to be an object
+      if(!d_started || d_complete || d_key == NULL) {
+        return false;
+      }
+      d_in_nested = true;
+      return nested_event(d_nested.StartArray());
+    }
+
+    bool
+    meta_namespace_sax_handler::EndArray(rapidjson::SizeType element_count)
+    {
+      if(d_in_nested) {
+        return nested_event(d_nested.EndArray(element_count));
+      }
+      return false;
+    }
+
+    metafile_sax_handler::metafile_sax_handler(meta_namespace &global,
+                                               std::vector<meta_namespace> &captures,
+                                               annotation_callback on_annotation)
+    : d_global(global), d_captures(captures), d_on_annotation(on_annotation), d_depth(0),
+      d_section(SECTION_OTHER), d_in_segment_array(false), d_in_segment(false),
+      d_has_global(false), d_end(NULL)
+    {
+    }
+
+    bool
+    metafile_sax_handler::has_global() const
+    {
+      return d_has_global;
+    }
+
+    void
+    metafile_sax_handler::track_annotations_end(const std::function<size_t()> &tell,
+                                                annotations_end *end)
+    {
+      d_tell = tell;
+      d_end = end;
+      *d_end = annotations_end();
+    }
+
+    bool
+    metafile_sax_handler::skip_scalar() const
+    {
+      return d_depth > 0 && !(d_depth == 2 && d_in_segment_array);
+    }
+
+    bool
+    metafile_sax_handler::segment_event(bool ok)
+    {
+      if(!ok) {
+        return false;
+      }
+      if(d_segment.complete()) {
+        d_in_segment = false;
+        meta_namespace ns = d_segment.take();
+        d_segment.reset();
+        if(d_section == SECTION_GLOBAL) {
+          d_global = std::move(ns);
+          d_has_global = true;
+        } else if(d_section == SECTION_CAPTURES) {
+          d_captures.push_back(std::move(ns));
+        } else {
+          if(d_end) {
+            d_end->count++;
+            d_end->append_offset = d_tell();
+          }
+          d_on_annotation(ns);
+        }
+      }
+      return true;
+    }
+
+    // Scalars outside of segments aren't part of any namespace, so they
+    // are skipped, unless they're in place of a segment
+    bool
+    metafile_sax_handler::Null()
+    {
+      return d_in_segment ? segment_event(d_segment.Null()) : skip_scalar();
+    }
+
+    bool
+    metafile_sax_handler::Bool(bool b)
+    {
+      return d_in_segment ? segment_event(d_segment.Bool(b)) : skip_scalar();
+    }
+
+    bool
+    metafile_sax_handler::Int(int i)
+    {
+      return d_in_segment ? segment_event(d_segment.Int(i)) : skip_scalar();
+    }
+
+    bool
+    metafile_sax_handler::Uint(unsigned u)
+    {
+      return d_in_segment ? segment_event(d_segment.Uint(u)) : skip_scalar();
+    }
+
+    bool
+    metafile_sax_handler::Int64(int64_t i)
+    {
+      return d_in_segment ? segment_event(d_segment.Int64(i)) : skip_scalar();
+    }
+
+    bool
+    metafile_sax_handler::Uint64(uint64_t u)
+    {
+      return d_in_segment ? segment_event(d_segment.Uint64(u)) : skip_scalar();
+    }
+
+    bool
+    metafile_sax_handler::Double(double d)
+    {
+      return d_in_segment ? segment_event(d_segment.Double(d)) : skip_scalar();
+    }
+
+    bool
+    metafile_sax_handler::String(const char *str, rapidjson::SizeType length, bool copy)
+    {
+      return d_in_segment ? segment_event(d_segment.String(str, length, copy)) : skip_scalar();
+    }
+
+    bool
+    metafile_sax_handler::StartObject()
+    {
+      if(d_in_segment) {
+        return segment_event(d_segment.StartObject());
+      }
+      if((d_depth == 1 && d_section == SECTION_GLOBAL) || (d_depth == 2 && d_in_segment_array)) {
+        d_in_segment = true;
+        return segment_event(d_segment.StartObject());
+      }
+      d_depth++;
+      return true;
+    }
+
+    bool
+    metafile_sax_handler::Key(const char *str, rapidjson::SizeType length, bool copy)
+    {
+      if(d_in_segment) {
+        return segment_event(d_segment.Key(str, length, copy));
+      }
+      if(d_depth == 1) {
+        std::string section(str, length);
+        if(section == "global") {
+          d_section = SECTION_GLOBAL;
+        } else if(section == "captures") {
+          d_section = SECTION_CAPTURES;
+        } else if(section == "annotations") {
+          d_section = SECTION_ANNOTATIONS;
+        } else {
+          d_section = SECTION_OTHER;
+        }
+      }
+      return true;
+    }
+
+    bool
+    metafile_sax_handler::EndObject(rapidjson::SizeType member_count)
+    {
+      if(d_in_segment) {
+        return segment_event(d_segment.EndObject(member_count));
+      }
+      d_depth--;
+      return true;
+    }
+
+    bool
+    metafile_sax_handler::StartArray()
+    {
+      if(d_in_segment) {
+        return segment_event(d_segment.StartArray());
+      }
+      // The root and segments have to be objects
+      if(d_depth == 0 || (d_depth == 2 && d_in_segment_array)) {
+        return false;
+      }
+      if(d_depth == 1 && (d_section == SECTION_CAPTURES || d_section == SECTION_ANNOTATIONS)) {
+        d_in_segment_array = true;
+        if(d_end && d_section == SECTION_ANNOTATIONS) {
+          d_end->num_arrays++;
+          d_end->count = 0;
+          d_end->append_offset = d_tell();
+        }
+      }
+      d_depth++;
+      return true;
+    }
+
+    bool
+    metafile_sax_handler::EndArray(rapidjson::SizeType element_count)
+    {
+      if(d_in_segment) {
+        return segment_event(d_segment.EndArray(element_count));
+      }
+      d_depth--;
+      if(d_depth == 1) {
+        d_in_segment_array = false;
+        if(d_end && d_section == SECTION_ANNOTATIONS) {
+          d_end->close = d_tell() - 1;
+        }
+      }
+      return true;
+    }
+
+  } // namespace sigmf
+} // namespace gr
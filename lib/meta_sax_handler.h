@@ -0,0 +1,132 @@
+#ifndef INCLUDED_SIGMF_META_SAX_HANDLER_H
+#define INCLUDED_SIGMF_META_SAX_HANDLER_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <sigmf/meta_namespace.h>
+#include <rapidjson/reader.h>
+#include "pmt_sax_handler.h"
+#include "metafile_layout.h"
+
+namespace gr {
+  namespace sigmf {
+
+    /**
+     * Builds a single meta_namespace from the SAX events of one json
+     * object. Top level values are stored straight into the namespace
+     * without going through a pmt; nested objects and arrays are built
+     * with a pmt_sax_handler. The mapping of json types is the same as
+     * json_value_to_pmt, including coercing core:sample_rate to a double.
+     *
+     * One handler builds one namespace. Call reset() before reusing it.
+     */
+    class meta_namespace_sax_handler
+    : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, meta_namespace_sax_handler> {
+      public:
+      meta_namespace_sax_handler();
+
+      bool Null();
+      bool Bool(bool b);
+      bool Int(int i);
+      bool Uint(unsigned u);
+      bool Int64(int64_t i);
+      bool Uint64(uint64_t u);
+      bool Double(double d);
+      bool String(const char *str, rapidjson::SizeType length, bool copy);
+      bool StartObject();
+      bool Key(const char *str, rapidjson::SizeType length, bool copy);
+      bool EndObject(rapidjson::SizeType member_count);
+      bool StartArray();
+      bool EndArray(rapidjson::SizeType element_count);
+
+      //! true once a complete object has been built
+      bool complete() const;
+
+      //! move the namespace that was built out of the handler
+      meta_namespace take();
+
+      //! discard any state so another namespace can be built
+      void reset();
+
+      private:
+      bool d_started;
+      bool d_complete;
+      bool d_in_nested;
+      bool d_coerce_to_double;
+      const meta_key *d_key;
+      meta_map d_data;
+      pmt_sax_handler d_nested;
+
+      bool add_value(const meta_value &val);
+      bool add_number(const meta_value &val, double as_double);
+      // Store the nested value once it's complete
+      bool nested_event(bool ok);
+    };
+
+    /**
+     * Builds the global object and capture segments of a whole metadata
+     * file, and hands each annotation to a callback as soon as it has
+     * been parsed. Top level members other than global, captures and
+     * annotations are skipped. Anything other than an object where a
+     * segment belongs is a parse error.
+     */
+    class metafile_sax_handler
+    : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, metafile_sax_handler> {
+      public:
+      typedef std::function<void(meta_namespace &)> annotation_callback;
+
+      metafile_sax_handler(meta_namespace &global,
+                           std::vector<meta_namespace> &captures,
+                           annotation_callback on_annotation);
+
+      bool Null();
+      bool Bool(bool b);
+      bool Int(int i);
+      bool Uint(unsigned u);
+      bool Int64(int64_t i);
+      bool Uint64(uint64_t u);
+      bool Double(double d);
+      bool String(const char *str, rapidjson::SizeType length, bool copy);
+      bool StartObject();
+      bool Key(const char *str, rapidjson::SizeType length, bool copy);
+      bool EndObject(rapidjson::SizeType member_count);
+      bool StartArray();
+      bool EndArray(rapidjson::SizeType element_count);
+
+      bool has_global() const;
+
+      /**
+       * Fill in end while parsing. tell gives the offset the parser is
+       * at, which is just past the last character of each event.
+       */
+      void track_annotations_end(const std::function<size_t()> &tell, annotations_end *end);
+
+      private:
+      enum section_t { SECTION_OTHER, SECTION_GLOBAL, SECTION_CAPTURES, SECTION_ANNOTATIONS };
+
+      meta_namespace &d_global;
+      std::vector<meta_namespace> &d_captures;
+      annotation_callback d_on_annotation;
+
+      // Open containers outside of segments, the root object is depth 1
+      int d_depth;
+      section_t d_section;
+      // true while directly inside the captures or annotations array
+      bool d_in_segment_array;
+      bool d_in_segment;
+      bool d_has_global;
+      meta_namespace_sax_handler d_segment;
+      std::function<size_t()> d_tell;
+      annotations_end *d_end;
+
+      // Hand the segment off once it's complete
+      bool segment_event(bool ok);
+      // false if a scalar is somewhere only a segment can be
+      bool skip_scalar() const;
+    };
+
+  } // namespace sigmf
+} // namespace gr
+
+#endif /* INCLUDED_SIGMF_META_SAX_HANDLER_H */
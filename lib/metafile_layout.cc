@@ -0,0 +1,156 @@
+#include "metafile_layout.h"
+#include <cstring>
+
+namespace gr {
+  namespace sigmf {
+
+    namespace {
+      const char ANNOTATIONS_KEY[] = "annotations";
+      const size_t ANNOTATIONS_KEY_LEN = sizeof(ANNOTATIONS_KEY) - 1;
+
+      bool
+      is_space(char c)
+      {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+      }
+
+      const char *
+      skip_space(const char *p, const char *end)
+      {
+        while(p < end && is_space(*p)) {
+          p++;
+        }
+        return p;
+      }
+
+      // The closing quote of the string whose contents start at str, or
+      // NULL if it isn't closed. A quote is escaped if an odd number of
+      // backslashes come right before it.
+      const char *
+      string_end(const char *str, const char *end)
+      {
+        const char *p = str;
+        while(p < end) {
+          const char *quote =
+            static_cast<const char *>(std::memchr(p, '"', end - p));
+          if(quote == NULL) {
+            return NULL;
+          }
+          const char *b = quote;
+          while(b > str && b[-1] == '\\') {
+            b--;
+          }
+          if((quote - b) % 2 == 0) {
+            return quote;
+          }
+          p = quote + 1;
+        }
+        return NULL;
+      }
+    } // namespace
+
+    bool
+    find_metafile_layout(const char *json, size_t length, metafile_layout &layout)
+    {
+      layout = metafile_layout();
+      const char *p = skip_space(json, json + length);
+      const char *end = json + length;
+      if(p == end || *p != '{') {
+        return false;
+      }
+
+      int depth = 0;
+      // true where the next string in the root object is a key
+      bool expect_key = false;
+      bool in_annotations = false;
+      bool found = false;
+      const char *segment = NULL;
+
+      while(p < end) {
+        char c = *p;
+        if(in_annotations && depth == 2) {
+          // Directly in the annotations array, only objects may be here
+          if(c == '{') {
+            segment = p;
+            depth++;
+          } else if(c == ']') {
+            layout.annotations_close = p - json;
+            in_annotations = false;
+            found = true;
+            depth--;
+          } else if(c != ',' && !is_space(c)) {
+            return false;
+          }
+          p++;
+          continue;
+        }
+
+        switch(c) {
+          case '"': {
+            const char *str = p + 1;
+            const char *close = string_end(str, end);
+            if(close == NULL) {
+              return false;
+            }
+            p = close + 1;
+            if(depth != 1 || !expect_key) {
+              continue;
+            }
+            expect_key = false;
+            size_t len = close - str;
+            if(std::memchr(str, '\\', len) != NULL) {
+              return false;
+            }
+            if(len != ANNOTATIONS_KEY_LEN || std::memcmp(str, ANNOTATIONS_KEY, len) != 0) {
+              continue;
+            }
+            if(found) {
+              return false;
+            }
+            p = skip_space(p, end);
+            if(p == end || *p != ':') {
+              return false;
+            }
+            p = skip_space(p + 1, end);
+            if(p == end || *p != '[') {
+              return false;
+            }
+            layout.annotations_open = p - json;
+            in_annotations = true;
+            depth++;
+            break;
+          }
+          case '{':
+          case '[':
+            depth++;
+            expect_key = (depth == 1);
+            break;
+          case '}':
+          case ']':
+            if(depth == 0) {
+              return false;
+            }
+            depth--;
+            if(in_annotations && depth == 2) {
+              if(c != '}') {
+                return false;
+              }
+              layout.annotations.push_back({static_cast<size_t>(segment - json),
+                                            static_cast<size_t>(p + 1 - segment)});
+            }
+            break;
+          case ',':
+            if(depth == 1) {
+              expect_key = true;
+            }
+            break;
+          default:
+            break;
+        }
+        p++;
+      }
+      return found && depth == 0;
+    }
+
+  } // namespace sigmf
+} // namespace gr
@@ -0,0 +1,68 @@
+#ifndef INCLUDED_SIGMF_METAFILE_LAYOUT_H
+#define INCLUDED_SIGMF_METAFILE_LAYOUT_H
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+#include <sigmf/meta_namespace.h>
+
+namespace gr {
+  namespace sigmf {
+
+    /**
+     * Where the annotations array and each of its segments are in the
+     * text of a metadata file. Offsets are from the start of the text.
+     */
+    struct metafile_layout {
+      struct range {
+        size_t offset;
+        size_t length;
+      };
+
+      // Offsets of the array's '[' and ']'
+      size_t annotations_open;
+      size_t annotations_close;
+      std::vector<range> annotations;
+    };
+
+    /**
+     * Find the annotations array of a metadata file and the bounds of
+     * every segment in it, without parsing them. This only follows
+     * strings and nesting, so it's several times faster than parsing;
+     * the segments still have to be parsed to know if they are valid.
+     *
+     * Returns false if the layout can't be found with certainty: the
+     * root isn't an object, there is no annotations array or more than
+     * one, an element of it isn't an object, a top level key has an
+     * escape in it, or the text is truncated. The file should be parsed
+     * as a whole then, which gives the proper error if there is one.
+     */
+    bool find_metafile_layout(const char *json, size_t length, metafile_layout &layout);
+
+    /**
+     * Where the annotations array of a metadata file ends. Offsets are
+     * from where reading the file started.
+     */
+    struct annotations_end {
+      // Top level annotations arrays; the rest only means something if
+      // there is exactly one
+      size_t num_arrays;
+      size_t count;
+      // Just past the last annotation, or past the '[' if there are none
+      size_t append_offset;
+      // Offset of the array's ']'
+      size_t close;
+    };
+
+    /**
+     * load_metafile(fp, num_threads), also finding where the annotations
+     * array ends while it's parsed, so annotations can be added to the
+     * file without reading it again.
+     */
+    metafile_namespaces
+    load_metafile(FILE *fp, size_t num_threads, annotations_end &end);
+
+  } // namespace sigmf
+} // namespace gr
+
+#endif /* INCLUDED_SIGMF_METAFILE_LAYOUT_H */
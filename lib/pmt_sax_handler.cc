@@ -0,0 +1,175 @@
+#include "pmt_sax_handler.h"
+#include <cstring>
+
+namespace gr {
+  namespace sigmf {
+
+    static const char *SAMPLE_RATE_KEY_STR = "core:sample_rate";
+
+    pmt_sax_handler::pmt_sax_handler()
+    : d_result(pmt::get_PMT_NIL()), d_complete(false), d_coerce_to_double(false)
+    {
+    }
+
+    bool
+    pmt_sax_handler::complete() const
+    {
+      return d_complete;
+    }
+
+    pmt::pmt_t
+    pmt_sax_handler::result() const
+    {
+      return d_complete ? d_result : pmt::get_PMT_NIL();
+    }
+
+    void
+    pmt_sax_handler::reset()
+    {
+      d_stack.clear();
+      d_result = pmt::get_PMT_NIL();
+      d_complete = false;
+      d_coerce_to_double = false;
+    }
+
+    bool
+    pmt_sax_handler::add_value(const pmt::pmt_t &val)
+    {
+      d_coerce_to_double = false;
+      if(d_stack.empty()) {
+        d_result = val;
+        d_complete = true;
+        return true;
+      }
+      frame &top = d_stack.back();
+      if(top.is_object) {
+        top.dict = pmt::dict_add(top.dict, top.key, val);
+      } else {
+        top.elements.push_back(val);
+      }
+      return true;
+    }
+
+    bool
+    pmt_sax_handler::add_number(const pmt::pmt_t &val, double as_double)
+    {
+      if(d_coerce_to_double) {
+        // Coerce this to a double to prevent badness, same as json_value_to_pmt
+        return add_value(pmt::from_double(as_double));
+      }
+      return add_value(val);
+    }
+
+    bool
+    pmt_sax_handler::Null()
+    {
+      return add_value(pmt::get_PMT_NIL());
+    }
+
+    bool
+    pmt_sax_handler::Bool(bool b)
+    {
+      return add_value(pmt::from_bool(b));
+    }
+
+    // A DOM value reports IsUint64() for any non-negative integer, so
+    // json_value_to_pmt turns those into uint64 pmts. Do the same here.
+    bool
+    pmt_sax_handler::Int(int i)
+    {
+      if(i >= 0) {
+        return add_number(pmt::from_uint64(static_cast<uint64_t>(i)), i);
+      }
+      return add_number(pmt::from_long(i), i);
+    }
+
+    bool
+    pmt_sax_handler::Uint(unsigned u)
+    {
+      return add_number(pmt::from_uint64(u), u);
+    }
+
+    bool
+    pmt_sax_handler::Int64(int64_t i)
+    {
+      if(i >= 0) {
+        return add_number(pmt::from_uint64(static_cast<uint64_t>(i)), static_cast<double>(i));
+      }
+      return add_number(pmt::from_long(i), static_cast<double>(i));
+    }
+
+    bool
+    pmt_sax_handler::Uint64(uint64_t u)
+    {
+      return add_number(pmt::from_uint64(u), static_cast<double>(u));
+    }
+
+    bool
+    pmt_sax_handler::Double(double d)
+    {
+      return add_number(pmt::from_double(d), d);
+    }
+
+    bool
+    pmt_sax_handler::String(const char *str, rapidjson::SizeType length, bool copy)
+    {
+      return add_value(pmt::string_to_symbol(std::string(str, length)));
+    }
+
+    bool
+    pmt_sax_handler::StartObject()
+    {
+      d_coerce_to_double = false;
+      frame f;
+      f.is_object = true;
+      f.dict = pmt::make_dict();
+      f.key = pmt::get_PMT_NIL();
+      d_stack.push_back(f);
+      return true;
+    }
+
+    bool
+    pmt_sax_handler::Key(const char *str, rapidjson::SizeType length, bool copy)
+    {
+      frame &top = d_stack.back();
+      top.key = pmt::string_to_symbol(std::string(str, length));
+      d_coerce_to_double = (length == std::strlen(SAMPLE_RATE_KEY_STR)) &&
+        std::strncmp(str, SAMPLE_RATE_KEY_STR, length) == 0;
+      return true;
+    }
+
+    bool
+    pmt_sax_handler::EndObject(rapidjson::SizeType member_count)
+    {
+      pmt::pmt_t obj = d_stack.back().dict;
+      d_stack.pop_back();
+      return add_value(obj);
+    }
+
+    bool
+    pmt_sax_handler::StartArray()
+    {
+      d_coerce_to_double = false;
+      frame f;
+      f.is_object = false;
+      f.dict = pmt::get_PMT_NIL();
+      f.key = pmt::get_PMT_NIL();
+      d_stack.push_back(f);
+      return true;
+    }
+
+    bool
+    pmt_sax_handler::EndArray(rapidjson::SizeType element_count)
+    {
+      std::vector<pmt::pmt_t> elements;
+      elements.swap(d_stack.back().elements);
+      d_stack.pop_back();
+      pmt::pmt_t array = pmt::make_vector(elements.size(), pmt::get_PMT_NIL());
+      for(size_t i = 0; i < elements.size(); i++) {
+        pmt::vector_set(array, i, elements[i]);
+      }
+      return add_value(array);
+    }
+
+  } // namespace sigmf
+} // namespace gr
@@ -0,0 +1,72 @@
+#ifndef INCLUDED_SIGMF_PMT_SAX_HANDLER_H
+#define INCLUDED_SIGMF_PMT_SAX_HANDLER_H
+
+#include <string>
+#include <vector>
+#include <pmt/pmt.h>
+#include <sigmf/meta_namespace.h>
+#include <rapidjson/reader.h>
+
+/**
+ * A rapidjson SAX handler that builds a pmt directly from parse events,
+ * without materializing a rapidjson Document first.
+ */
+namespace gr {
+  namespace sigmf {
+
+    /**
+     * Builds a single pmt value from a stream of SAX events. The mapping of
+     * json types to pmt types is the same as json_value_to_pmt, including
+     * coercing core:sample_rate to a double.
+     *
+     * One handler builds one value. Call reset() before reusing it.
+     */
+    class pmt_sax_handler
+    : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, pmt_sax_handler> {
+      public:
+      pmt_sax_handler();
+
+      bool Null();
+      bool Bool(bool b);
+      bool Int(int i);
+      bool Uint(unsigned u);
+      bool Int64(int64_t i);
+      bool Uint64(uint64_t u);
+      bool Double(double d);
+      bool String(const char *str, rapidjson::SizeType length, bool copy);
+      bool StartObject();
+      bool Key(const char *str, rapidjson::SizeType length, bool copy);
+      bool EndObject(rapidjson::SizeType member_count);
+      bool StartArray();
+      bool EndArray(rapidjson::SizeType element_count);
+
+      //! true once a complete value has been built
+      bool complete() const;
+
+      //! the value that was built, PMT_NIL if not complete
+      pmt::pmt_t result() const;
+
+      //! discard any state so another value can be built
+      void reset();
+
+      private:
+      struct frame {
+        bool is_object;
+        pmt::pmt_t dict;
+        std::vector<pmt::pmt_t> elements;
+        pmt::pmt_t key;
+      };
+
+      std::vector<frame> d_stack;
+      pmt::pmt_t d_result;
+      bool d_complete;
+      bool d_coerce_to_double;
+
+      bool add_value(const pmt::pmt_t &val);
+      bool add_number(const pmt::pmt_t &val, double as_double);
+    };
+
+  } // namespace sigmf
+} // namespace gr
+
+#endif /* INCLUDED_SIGMF_PMT_SAX_HANDLER_H */
@@ -15,6 +15,16 @@ namespace gr {
         double frac_seconds = pmt::to_double(pmt::tuple_ref(uhd_time, 1));
         return std::make_pair(seconds, frac_seconds);
       }
+
+      // JSON numbers can be parsed as any of the pmt number types
+      inline double
+      number_to_double(pmt::pmt_t val)
+      {
+        if(pmt::is_uint64(val)) {
+          return static_cast<double>(pmt::to_uint64(val));
+        }
+        return pmt::to_double(val);
+      }
     } // namespace pmt_utils
   } // namespace sigmf
 } // namespace gr
@@ -0,0 +1,147 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <sigmf/annotation_index.h>
+
+using namespace gr::sigmf;
+
+namespace {
+  std::vector<size_t>
+  brute_force(const std::vector<annotation_index::interval> &intervals,
+              uint64_t start,
+              uint64_t end)
+  {
+    std::vector<size_t> result;
+    for(const annotation_index::interval &i : intervals) {
+      uint64_t i_end = i.sample_start + std::max<uint64_t>(i.sample_count, 1);
+      if(start < end && i.sample_start < end && i_end > start) {
+        result.push_back(i.index);
+      }
+    }
+    return result;
+  }
+
+  std::vector<size_t>
+  sorted(std::vector<size_t> v)
+  {
+    std::sort(v.begin(), v.end());
+    return v;
+  }
+} // namespace
+
+BOOST_AUTO_TEST_CASE(t_index_matches_brute_force)
+{
+  std::mt19937_64 rng(1);
+  std::uniform_int_distribution<uint64_t> start(0, 100000);
+  std::uniform_int_distribution<uint64_t> count(0, 2000);
+  std::vector<annotation_index::interval> intervals;
+  for(size_t i = 0; i < 5000; i++) {
+    // Some long ones, some empty ones, in no particular order
+    uint64_t c = i % 100 == 0 ? count(rng) * 20 : (i % 7 == 0 ? 0 : count(rng));
+    intervals.push_back({start(rng), c, i});
+  }
+  annotation_index index(intervals);
+  BOOST_CHECK_EQUAL(index.size(), intervals.size());
+
+  for(size_t q = 0; q < 2000; q++) {
+    uint64_t s = start(rng);
+    uint64_t e = s + count(rng);
+    std::vector<size_t> found = index.overlapping(s, e);
+    // Results come out in order of sample_start
+    for(size_t i = 1; i < found.size(); i++) {
+      BOOST_REQUIRE(intervals[found[i - 1]].sample_start <= intervals[found[i]].sample_start);
+    }
+    std::vector<size_t> expected = brute_force(intervals, s, e);
+    found = sorted(found);
+    BOOST_REQUIRE_EQUAL_COLLECTIONS(found.begin(), found.end(), expected.begin(),
+                                    expected.end());
+
+    found = sorted(index.at(s));
+    expected = brute_force(intervals, s, s + 1);
+    BOOST_REQUIRE_EQUAL_COLLECTIONS(found.begin(), found.end(), expected.begin(),
+                                    expected.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(t_index_edges)
+{
+  std::vector<annotation_index::interval> intervals = {
+    {10, 5, 0}, {15, 0, 1}, {0, 0, 2}, {12, 1, 3}, {UINT64_MAX - 1, 10, 4}};
+  annotation_index index(intervals);
+
+  // Ranges are half open
+  BOOST_CHECK(index.overlapping(0, 0).empty());
+  BOOST_CHECK(index.overlapping(5, 2).empty());
+  BOOST_CHECK(index.overlapping(1, 10).empty());
+  BOOST_CHECK(sorted(index.overlapping(14, 15)) == std::vector<size_t>({0}));
+  BOOST_CHECK(sorted(index.overlapping(0, 16)) == std::vector<size_t>({0, 1, 2, 3}));
+
+  // An annotation without a count covers its first sample
+  BOOST_CHECK(index.at(0) == std::vector<size_t>({2}));
+  BOOST_CHECK(index.at(15) == std::vector<size_t>({1}));
+  BOOST_CHECK(index.at(12) == std::vector<size_t>({0, 3}));
+  BOOST_CHECK(index.at(UINT64_MAX - 1) == std::vector<size_t>({4}));
+
+  // Appends to the caller's vector
+  std::vector<size_t> out = {99};
+  index.overlapping(16, 20, out);
+  BOOST_CHECK(out == std::vector<size_t>({99}));
+  index.overlapping(11, 12, out);
+  BOOST_CHECK(out == std::vector<size_t>({99, 0}));
+}
+
+BOOST_AUTO_TEST_CASE(t_index_empty)
+{
+  annotation_index index;
+  BOOST_CHECK(index.empty());
+  BOOST_CHECK(index.overlapping(0, UINT64_MAX).empty());
+  BOOST_CHECK(index.at(0).empty());
+}
+
+BOOST_AUTO_TEST_CASE(t_index_from_segments)
+{
+  std::vector<meta_namespace> annotations;
+  annotations.push_back(meta_namespace::build_annotation_segment(100, 50));
+  annotations.push_back(meta_namespace::build_annotation_segment(0, 10));
+  meta_namespace no_count;
+  no_count.set("core:sample_start", 120);
+  annotations.push_back(no_count);
+
+  arena_segments segments;
+  for(const meta_namespace &ns : annotations) {
+    segments.push_back(ns);
+  }
+
+  annotation_index from_vector(annotations);
+  annotation_index from_arena(segments);
+  BOOST_CHECK(from_vector.overlapping(5, 121) == std::vector<size_t>({1, 0, 2}));
+  BOOST_CHECK(from_arena.overlapping(5, 121) == std::vector<size_t>({1, 0, 2}));
+  BOOST_CHECK(from_arena.at(149) == std::vector<size_t>({0}));
+
+  meta_namespace no_start;
+  no_start.set("core:sample_count", 10);
+  annotations.push_back(no_start);
+  BOOST_CHECK_THROW(annotation_index bad(annotations), std::runtime_error);
+}
@@ -0,0 +1,223 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <boost/test/unit_test.hpp>
+#include <sigmf/meta_namespace.h>
+
+using namespace gr::sigmf;
+
+namespace {
+  // A temporary file holding json, positioned at its start
+  FILE *
+  json_file(const std::string &json)
+  {
+    FILE *fp = std::tmpfile();
+    BOOST_REQUIRE(fp != NULL);
+    BOOST_REQUIRE_EQUAL(std::fwrite(json.data(), 1, json.size(), fp), json.size());
+    std::rewind(fp);
+    return fp;
+  }
+
+  metafile_namespaces
+  load_json(const std::string &json, size_t num_threads = 1)
+  {
+    FILE *fp = json_file(json);
+    metafile_namespaces meta_ns;
+    try {
+      meta_ns = load_metafile(fp, num_threads);
+    } catch(...) {
+      std::fclose(fp);
+      throw;
+    }
+    std::fclose(fp);
+    return meta_ns;
+  }
+
+  // Big enough to be split across threads
+  std::string
+  big_metafile_json(size_t count)
+  {
+    std::string json = "{\"global\": {\"core:datatype\": \"cf32_le\"},"
+                       " \"captures\": [{\"core:sample_start\": 0}],"
+                       " \"annotations\": [";
+    for(size_t i = 0; i < count; i++) {
+      json += (i ? ",\n" : "\n");
+      json += "{\"core:sample_start\": " + std::to_string(i) +
+              ", \"test:big\": " + std::to_string(std::numeric_limits<uint64_t>::max() - i) +
+              ", \"test:nested\": {\"list\": [" + std::to_string(i) +
+              ", {\"label\": \"a \\\"quoted\\\" ]} label\"}]}}";
+    }
+    json += "\n]}\n";
+    BOOST_REQUIRE(json.size() > (4 << 20));
+    return json;
+  }
+
+  uint64_t
+  sample_start(const meta_namespace &ns)
+  {
+    return ns.get_as<uint64_t>(meta_key::SAMPLE_START);
+  }
+} // namespace
+
+BOOST_AUTO_TEST_CASE(t_load_missing_captures)
+{
+  // Loads, it's up to whoever uses the captures to check there are some
+  metafile_namespaces meta_ns =
+    load_json("{\"global\": {\"core:datatype\": \"cf32_le\"},"
+              " \"annotations\": [{\"core:sample_start\": 3}]}");
+  BOOST_CHECK(meta_ns.captures.empty());
+  BOOST_REQUIRE_EQUAL(meta_ns.annotations.size(), 1);
+  BOOST_CHECK_EQUAL(sample_start(meta_ns.annotations[0]), 3);
+
+  meta_ns = load_json("{\"global\": {\"core:datatype\": \"cf32_le\"},"
+                      " \"captures\": [], \"annotations\": []}");
+  BOOST_CHECK(meta_ns.captures.empty());
+  BOOST_CHECK(meta_ns.annotations.empty());
+  BOOST_CHECK_EQUAL(meta_ns.global.get_as<std::string>("core:datatype"), "cf32_le");
+
+  // Without a global object it's not metadata at all
+  BOOST_CHECK_THROW(load_json("{\"captures\": [{\"core:sample_start\": 0}]}"),
+                    std::runtime_error);
+  BOOST_CHECK_THROW(load_json("{\"global\": {}, \"captures\": [1]}"), std::runtime_error);
+  BOOST_CHECK_THROW(load_json("[]"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(t_load_annotations_before_captures)
+{
+  std::string json = "{\"annotations\": [{\"core:sample_start\": 1},"
+                     " {\"core:sample_start\": 2}],"
+                     " \"captures\": [{\"core:sample_start\": 7}],"
+                     " \"global\": {\"core:datatype\": \"ri8\"}}";
+  metafile_namespaces meta_ns = load_json(json);
+  BOOST_REQUIRE_EQUAL(meta_ns.annotations.size(), 2);
+  BOOST_CHECK_EQUAL(sample_start(meta_ns.annotations[0]), 1);
+  BOOST_CHECK_EQUAL(sample_start(meta_ns.annotations[1]), 2);
+  BOOST_REQUIRE_EQUAL(meta_ns.captures.size(), 1);
+  BOOST_CHECK_EQUAL(sample_start(meta_ns.captures[0]), 7);
+  BOOST_CHECK_EQUAL(meta_ns.global.get_as<std::string>("core:datatype"), "ri8");
+
+  // The callback sees the annotations before the captures are filled in
+  FILE *fp = json_file(json);
+  meta_namespace global;
+  std::vector<meta_namespace> captures;
+  size_t seen = 0;
+  load_metafile(fp, global, captures, [&](meta_namespace &annotation) {
+    BOOST_CHECK(captures.empty());
+    BOOST_CHECK_EQUAL(sample_start(annotation), ++seen);
+  });
+  std::fclose(fp);
+  BOOST_CHECK_EQUAL(seen, 2);
+  BOOST_CHECK_EQUAL(captures.size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(t_load_nested_values)
+{
+  metafile_namespaces meta_ns =
+    load_json("{\"global\": {\"test:nested\": {\"a\": [1, {\"b\": \"c\"}, []], \"d\": {}}},"
+              " \"captures\": [{\"core:sample_start\": 0, \"test:list\": [[1, 2], [3]]}],"
+              " \"other\": {\"captures\": [{\"skipped\": 1}], \"global\": 5}}");
+
+  pmt::pmt_t nested = meta_ns.global.get("test:nested");
+  BOOST_REQUIRE(pmt::is_dict(nested));
+  pmt::pmt_t a = pmt::dict_ref(nested, pmt::mp("a"), pmt::PMT_NIL);
+  BOOST_REQUIRE(pmt::is_vector(a));
+  BOOST_REQUIRE_EQUAL(pmt::length(a), 3);
+  // Non-negative integers are uint64 everywhere, as json_value_to_pmt makes them
+  BOOST_REQUIRE(pmt::is_uint64(pmt::vector_ref(a, 0)));
+  BOOST_CHECK_EQUAL(pmt::to_uint64(pmt::vector_ref(a, 0)), 1);
+  pmt::pmt_t b = pmt::dict_ref(pmt::vector_ref(a, 1), pmt::mp("b"), pmt::PMT_NIL);
+  BOOST_CHECK_EQUAL(pmt::symbol_to_string(b), "c");
+  BOOST_CHECK_EQUAL(pmt::length(pmt::vector_ref(a, 2)), 0);
+  BOOST_CHECK(pmt::is_dict(pmt::dict_ref(nested, pmt::mp("d"), pmt::PMT_NIL)));
+
+  // Sections nested in something else aren't the top level ones
+  BOOST_REQUIRE_EQUAL(meta_ns.captures.size(), 1);
+  pmt::pmt_t list = meta_ns.captures[0].get("test:list");
+  BOOST_REQUIRE(pmt::is_vector(list));
+  BOOST_REQUIRE_EQUAL(pmt::length(list), 2);
+  BOOST_CHECK_EQUAL(pmt::length(pmt::vector_ref(list, 0)), 2);
+  BOOST_CHECK_EQUAL(pmt::to_uint64(pmt::vector_ref(pmt::vector_ref(list, 1), 0)), 3);
+}
+
+BOOST_AUTO_TEST_CASE(t_load_large_uint64)
+{
+  const uint64_t big = std::numeric_limits<uint64_t>::max();
+  const uint64_t just_over = uint64_t(std::numeric_limits<int64_t>::max()) + 1;
+  metafile_namespaces meta_ns =
+    load_json("{\"global\": {\"test:big\": " + std::to_string(big) + "},"
+              " \"captures\": [{\"core:sample_start\": " + std::to_string(just_over) + "}],"
+              " \"annotations\": [{\"core:sample_start\": 0,"
+              " \"test:nested\": [" + std::to_string(big) + "]}]}");
+
+  pmt::pmt_t val = meta_ns.global.get("test:big");
+  BOOST_REQUIRE(pmt::is_uint64(val));
+  BOOST_CHECK_EQUAL(pmt::to_uint64(val), big);
+  BOOST_CHECK_EQUAL(meta_ns.global.get_as<uint64_t>("test:big"), big);
+  int64_t s = 0;
+  BOOST_CHECK(!meta_ns.global.try_get("test:big", s));
+
+  BOOST_CHECK_EQUAL(sample_start(meta_ns.captures[0]), just_over);
+  pmt::pmt_t nested = meta_ns.annotations[0].get("test:nested");
+  BOOST_REQUIRE(pmt::is_uint64(pmt::vector_ref(nested, 0)));
+  BOOST_CHECK_EQUAL(pmt::to_uint64(pmt::vector_ref(nested, 0)), big);
+}
+
+BOOST_AUTO_TEST_CASE(t_load_parallel_matches_sequential)
+{
+  const size_t count = 60000;
+  std::string json = big_metafile_json(count);
+  metafile_namespaces sequential = load_json(json, 1);
+  metafile_namespaces parallel = load_json(json, 4);
+  BOOST_REQUIRE_EQUAL(sequential.annotations.size(), count);
+  BOOST_REQUIRE_EQUAL(parallel.annotations.size(), count);
+  BOOST_CHECK_EQUAL(parallel.captures.size(), 1);
+  for(size_t i = 0; i < count; i += 997) {
+    BOOST_CHECK_EQUAL(sample_start(parallel.annotations[i]), i);
+    BOOST_CHECK_EQUAL(parallel.annotations[i].get_as<uint64_t>("test:big"),
+                      std::numeric_limits<uint64_t>::max() - i);
+    BOOST_CHECK(pmt::equal(parallel.annotations[i].get("test:nested"),
+                           sequential.annotations[i].get("test:nested")));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(t_load_parallel_handover)
+{
+  // Several rounds of slices, handed over in file order
+  const size_t count = 60000;
+  FILE *fp = json_file(big_metafile_json(count));
+  meta_namespace global;
+  std::vector<meta_namespace> captures;
+  size_t seen = 0;
+  load_metafile(fp, 3, global, captures, [&](meta_namespace &annotation) {
+    if(seen == 0) {
+      BOOST_CHECK_EQUAL(captures.size(), 1);
+      BOOST_CHECK(global.has("core:datatype"));
+    }
+    BOOST_REQUIRE_EQUAL(sample_start(annotation), seen);
+    seen++;
+  });
+  std::fclose(fp);
+  BOOST_CHECK_EQUAL(seen, count);
+}
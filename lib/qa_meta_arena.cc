@@ -0,0 +1,133 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <boost/test/unit_test.hpp>
+#include <sigmf/meta_arena.h>
+
+using namespace gr::sigmf;
+
+BOOST_AUTO_TEST_CASE(t_arena_alignment)
+{
+  meta_arena arena(4096);
+  for(size_t i = 0; i < 10000; i++) {
+    size_t align = size_t(1) << (i % 5);
+    size_t size = i % 1500 + 1;
+    char *p = static_cast<char *>(arena.allocate(size, align));
+    BOOST_REQUIRE_EQUAL(reinterpret_cast<uintptr_t>(p) % align, 0);
+    std::memset(p, 0, size);
+  }
+  BOOST_CHECK(arena.capacity() > 0);
+  arena.clear();
+  BOOST_CHECK_EQUAL(arena.capacity(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(t_arena_segments_values)
+{
+  meta_namespace ns = meta_namespace::build_annotation_segment(1234, 56);
+  ns.set("core:label", "a label too long for the small string buffer");
+  ns.set("test:negative", -7);
+  ns.set("test:real", 2.5);
+  ns.set("test:flag", pmt::PMT_T);
+  pmt::pmt_t detail = pmt::make_dict();
+  detail = pmt::dict_add(detail, pmt::mp("snr"), pmt::from_double(12.5));
+  detail = pmt::dict_add(detail, pmt::mp("channel"), pmt::from_uint64(3));
+  ns.set("test:detail", detail);
+  ns.set("test:time", pmt::make_tuple(pmt::from_uint64(1), pmt::from_double(0.5)));
+
+  arena_segments segments;
+  for(size_t i = 0; i < 1000; i++) {
+    segments.push_back(ns);
+  }
+  // Moving keeps everything where it was
+  arena_segments moved(std::move(segments));
+  BOOST_REQUIRE_EQUAL(moved.size(), 1000);
+
+  const arena_segment &segment = moved[999];
+  BOOST_CHECK_EQUAL(segment.size(), ns.keys().size());
+  uint64_t start = 0;
+  BOOST_CHECK(segment.try_get(meta_key::SAMPLE_START, start));
+  BOOST_CHECK_EQUAL(start, 1234);
+  std::string label;
+  BOOST_CHECK(segment.find("core:label")->as(label));
+  BOOST_CHECK_EQUAL(label, "a label too long for the small string buffer");
+  BOOST_CHECK(segment.find("test:missing") == NULL);
+
+  meta_namespace back = segment.to_namespace();
+  for(const std::string &key : ns.keys()) {
+    if(key == "test:detail") {
+      continue;
+    }
+    BOOST_CHECK_MESSAGE(pmt::equal(back.get(key), ns.get(key)), key);
+    BOOST_CHECK_MESSAGE(pmt::equal(segment.get(key), ns.get(key)), key);
+  }
+  // Objects come back the way loading them from a file would build
+  // them, which doesn't keep the order of a dict's items
+  pmt::pmt_t detail_back = segment.get("test:detail");
+  BOOST_REQUIRE(pmt::is_dict(detail_back));
+  BOOST_CHECK_EQUAL(pmt::to_double(pmt::dict_ref(detail_back, pmt::mp("snr"), pmt::PMT_NIL)),
+                    12.5);
+  BOOST_CHECK_EQUAL(
+    pmt::to_uint64(pmt::dict_ref(detail_back, pmt::mp("channel"), pmt::PMT_NIL)), 3);
+
+  moved.clear();
+  BOOST_CHECK(moved.empty());
+  BOOST_CHECK_EQUAL(moved.memory_size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(t_arena_load_metafile)
+{
+  // Big enough to be parsed in rounds across threads
+  std::string json = "{\"global\": {\"core:datatype\": \"ri16_le\"},"
+                     " \"captures\": [{\"core:sample_start\": 0}], \"annotations\": [";
+  const size_t count = 50000;
+  for(size_t i = 0; i < count; i++) {
+    json += (i ? ",\n" : "\n");
+    json += "{\"core:sample_start\": " + std::to_string(i * 10) +
+            ", \"core:sample_count\": 10, \"core:comment\": \"annotation number " +
+            std::to_string(i) + " with some padding to fill out the file\"}";
+  }
+  json += "]}";
+  BOOST_REQUIRE(json.size() > (4 << 20));
+  FILE *fp = std::tmpfile();
+  BOOST_REQUIRE(fp != NULL);
+  BOOST_REQUIRE_EQUAL(std::fwrite(json.data(), 1, json.size(), fp), json.size());
+
+  std::rewind(fp);
+  metafile_namespaces expected = load_metafile(fp, 1);
+  std::rewind(fp);
+  meta_namespace global;
+  std::vector<meta_namespace> captures;
+  arena_segments annotations;
+  load_metafile(fp, global, captures, annotations);
+  std::fclose(fp);
+
+  BOOST_CHECK_EQUAL(global.get_as<std::string>("core:datatype"), "ri16_le");
+  BOOST_CHECK_EQUAL(captures.size(), 1);
+  BOOST_REQUIRE_EQUAL(annotations.size(), count);
+  for(size_t i = 0; i < count; i += 499) {
+    meta_namespace back = annotations[i].to_namespace();
+    for(const std::string &key : expected.annotations[i].keys()) {
+      BOOST_CHECK_MESSAGE(pmt::equal(back.get(key), expected.annotations[i].get(key)), key);
+    }
+  }
+}
@@ -0,0 +1,304 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include "meta_index.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+using namespace gr::sigmf;
+namespace fs = boost::filesystem;
+
+namespace {
+  // A directory that's removed when the test is done
+  struct temp_dir {
+    fs::path path;
+
+    temp_dir() : path(fs::temp_directory_path() / fs::unique_path("qa_meta_index-%%%%-%%%%"))
+    {
+      fs::create_directories(path);
+    }
+
+    ~temp_dir()
+    {
+      boost::system::error_code ec;
+      fs::remove_all(path, ec);
+    }
+
+    std::string
+    file(const std::string &name) const
+    {
+      return (path / name).string();
+    }
+  };
+
+  void
+  write_file(const std::string &path, const std::string &contents)
+  {
+    FILE *fp = std::fopen(path.c_str(), "wb");
+    BOOST_REQUIRE(fp != NULL);
+    BOOST_REQUIRE_EQUAL(std::fwrite(contents.data(), 1, contents.size(), fp),
+                        contents.size());
+    std::fclose(fp);
+  }
+
+  struct annotation {
+    uint64_t sample_start;
+    uint64_t sample_count;
+  };
+
+  std::string
+  metafile_json(const std::vector<annotation> &annotations)
+  {
+    std::string json = "{\"global\": {\"core:datatype\": \"cf32_le\"},\n"
+                       " \"captures\": [{\"core:sample_start\": 100},"
+                       " {\"core:sample_start\": 0}],\n"
+                       " \"annotations\": [";
+    for(size_t i = 0; i < annotations.size(); i++) {
+      json += (i ? ",\n" : "\n");
+      json += "{\"core:sample_start\": " + std::to_string(annotations[i].sample_start) +
+              ", \"core:sample_count\": " + std::to_string(annotations[i].sample_count) +
+              ", \"test:id\": " + std::to_string(i) + "}";
+    }
+    json += "\n]}\n";
+    return json;
+  }
+
+  uint64_t
+  sample_start(const meta_namespace &ns)
+  {
+    return ns.get_as<uint64_t>(meta_key::SAMPLE_START);
+  }
+
+#ifndef _WIN32
+  struct timespec
+  mtime_of(const std::string &path)
+  {
+    struct stat st;
+    BOOST_REQUIRE(::stat(path.c_str(), &st) == 0);
+#ifdef __APPLE__
+    return st.st_mtimespec;
+#else
+    return st.st_mtim;
+#endif
+  }
+
+  void
+  set_mtime(const std::string &path, const struct timespec &mtime)
+  {
+    struct timespec times[2] = {mtime, mtime};
+    BOOST_REQUIRE(::utimensat(AT_FDCWD, path.c_str(), times, 0) == 0);
+  }
+
+  // Overwrite a field of the index's header
+  void
+  patch_index(const std::string &meta_path, long offset, uint32_t value)
+  {
+    FILE *fp = std::fopen(meta_index::index_path(meta_path).c_str(), "r+b");
+    BOOST_REQUIRE(fp != NULL);
+    BOOST_REQUIRE(std::fseek(fp, offset, SEEK_SET) == 0);
+    BOOST_REQUIRE_EQUAL(std::fwrite(&value, sizeof(value), 1, fp), 1);
+    std::fclose(fp);
+  }
+#endif
+} // namespace
+
+#ifndef _WIN32
+
+BOOST_AUTO_TEST_CASE(t_meta_index_build)
+{
+  temp_dir dir;
+  std::string meta_path = dir.file("build.sigmf-meta");
+  write_file(meta_path, metafile_json({{30, 5}, {10, 0}, {20, 1}, {10, 3}}));
+
+  // Too small to be indexed unless asked
+  BOOST_CHECK(meta_index::open(meta_path) == nullptr);
+  BOOST_CHECK(!fs::exists(meta_index::index_path(meta_path)));
+
+  std::unique_ptr<meta_index> index = meta_index::open(meta_path, true);
+  BOOST_REQUIRE(index != nullptr);
+  BOOST_CHECK(fs::exists(meta_index::index_path(meta_path)));
+  BOOST_REQUIRE_EQUAL(index->num_captures(), 2);
+  BOOST_REQUIRE_EQUAL(index->num_annotations(), 4);
+  BOOST_CHECK_EQUAL(index->captures_begin()[0].sample_start, 0);
+  BOOST_CHECK_EQUAL(index->captures_begin()[1].sample_start, 100);
+
+  // Sorted by sample_start, ties in file order
+  const meta_index::entry *a = index->annotations_begin();
+  BOOST_CHECK_EQUAL(a[0].sample_start, 10);
+  BOOST_CHECK_EQUAL(a[0].sample_count, 0);
+  BOOST_CHECK_EQUAL(a[1].sample_start, 10);
+  BOOST_CHECK_EQUAL(a[1].sample_count, 3);
+  BOOST_CHECK_EQUAL(a[2].sample_start, 20);
+  BOOST_CHECK_EQUAL(a[3].sample_start, 30);
+
+  FILE *fp = std::fopen(meta_path.c_str(), "r");
+  BOOST_REQUIRE(fp != NULL);
+  meta_namespace global = meta_index::load(fp, index->global());
+  BOOST_CHECK_EQUAL(global.get_as<std::string>("core:datatype"), "cf32_le");
+  meta_namespace last = meta_index::load(fp, a[3]);
+  BOOST_CHECK_EQUAL(sample_start(last), 30);
+  BOOST_CHECK_EQUAL(last.get_as<uint64_t>("test:id"), 0);
+  meta_namespace tie = meta_index::load(fp, a[1]);
+  BOOST_CHECK_EQUAL(tie.get_as<uint64_t>("test:id"), 3);
+  std::fclose(fp);
+
+  // An existing index is used as is
+  BOOST_CHECK(meta_index::open(meta_path) != nullptr);
+
+  write_file(meta_path, "{\"captures\": []}");
+  BOOST_CHECK_THROW(meta_index::build(meta_path), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(t_meta_index_stale)
+{
+  temp_dir dir;
+  std::string meta_path = dir.file("stale.sigmf-meta");
+  std::string json = metafile_json({{10, 1}, {20, 1}});
+  write_file(meta_path, json);
+  BOOST_REQUIRE(meta_index::open(meta_path, true) != nullptr);
+  struct timespec mtime = mtime_of(meta_path);
+
+  // Modification time
+  struct timespec later = mtime;
+  later.tv_sec += 1;
+  set_mtime(meta_path, later);
+  BOOST_CHECK(meta_index::open(meta_path) == nullptr);
+  set_mtime(meta_path, mtime);
+  BOOST_CHECK(meta_index::open(meta_path) != nullptr);
+
+  // Size
+  write_file(meta_path, json + " ");
+  set_mtime(meta_path, mtime);
+  BOOST_CHECK(meta_index::open(meta_path) == nullptr);
+  write_file(meta_path, json);
+  set_mtime(meta_path, mtime);
+  BOOST_CHECK(meta_index::open(meta_path) != nullptr);
+
+  // Inode, a file with the same size and time renamed over it
+  std::string other_path = dir.file("other.sigmf-meta");
+  write_file(other_path, json);
+  set_mtime(other_path, mtime);
+  fs::rename(other_path, meta_path);
+  BOOST_CHECK(meta_index::open(meta_path) == nullptr);
+
+  // Rebuilt from the new contents
+  write_file(meta_path, metafile_json({{10, 1}, {20, 1}, {30, 1}}));
+  std::unique_ptr<meta_index> index = meta_index::open(meta_path, true);
+  BOOST_REQUIRE(index != nullptr);
+  BOOST_CHECK_EQUAL(index->num_annotations(), 3);
+  BOOST_CHECK(meta_index::open(meta_path) != nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(t_meta_index_rejects_foreign_header)
+{
+  temp_dir dir;
+  std::string meta_path = dir.file("header.sigmf-meta");
+  write_file(meta_path, metafile_json({{10, 1}}));
+
+  // The header starts with 8 bytes of magic, then the version and the
+  // byte order marker as uint32s
+  const long VERSION_OFFSET = 8;
+  const long BYTE_ORDER_OFFSET = 12;
+
+  // Written on a machine with the other byte order
+  BOOST_REQUIRE(meta_index::open(meta_path, true) != nullptr);
+  patch_index(meta_path, BYTE_ORDER_OFFSET, 0x04030201);
+  BOOST_CHECK(meta_index::open(meta_path) == nullptr);
+  BOOST_CHECK(meta_index::open(meta_path, true) != nullptr);
+  BOOST_CHECK(meta_index::open(meta_path) != nullptr);
+
+  // From some other version
+  patch_index(meta_path, VERSION_OFFSET, 0);
+  BOOST_CHECK(meta_index::open(meta_path) == nullptr);
+  BOOST_CHECK(meta_index::open(meta_path, true) != nullptr);
+
+  // Truncated
+  fs::resize_file(meta_index::index_path(meta_path), 4);
+  BOOST_CHECK(meta_index::open(meta_path) == nullptr);
+  BOOST_CHECK(meta_index::open(meta_path, true) != nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(t_meta_index_annotations_in)
+{
+  std::mt19937_64 rng(17);
+  std::vector<annotation> annotations(2000);
+  for(annotation &anno : annotations) {
+    anno.sample_start = rng() % 100000;
+    // Some that span a lot of the others, and some of no length
+    uint64_t kind = rng() % 10;
+    anno.sample_count = kind == 0 ? 0 : kind == 1 ? rng() % 20000 : rng() % 100;
+  }
+
+  temp_dir dir;
+  std::string meta_path = dir.file("ranges.sigmf-meta");
+  write_file(meta_path, metafile_json(annotations));
+  std::unique_ptr<meta_index> index = meta_index::open(meta_path, true);
+  BOOST_REQUIRE(index != nullptr);
+
+  std::vector<annotation> sorted(annotations);
+  std::stable_sort(sorted.begin(), sorted.end(), [](const annotation &a, const annotation &b) {
+    return a.sample_start < b.sample_start;
+  });
+  for(int query = 0; query < 500; query++) {
+    uint64_t start = rng() % 110000;
+    uint64_t end = start + (query % 5 == 0 ? 0 : query % 5 == 1 ? 1 : rng() % 5000);
+
+    std::vector<annotation> expected;
+    for(const annotation &anno : sorted) {
+      bool overlaps = anno.sample_count == 0
+                        ? anno.sample_start >= start && anno.sample_start < end
+                        : anno.sample_start < end && anno.sample_start + anno.sample_count > start;
+      if(overlaps) {
+        expected.push_back(anno);
+      }
+    }
+
+    std::vector<meta_index::entry> found = index->annotations_in(start, end);
+    BOOST_REQUIRE_EQUAL(found.size(), expected.size());
+    for(size_t i = 0; i < found.size(); i++) {
+      BOOST_CHECK_EQUAL(found[i].sample_start, expected[i].sample_start);
+      BOOST_CHECK_EQUAL(found[i].sample_count, expected[i].sample_count);
+    }
+  }
+}
+
+#else
+
+BOOST_AUTO_TEST_CASE(t_meta_index_unsupported)
+{
+  std::string meta_path = (fs::temp_directory_path() / fs::unique_path()).string();
+  write_file(meta_path, metafile_json({{10, 1}}));
+  BOOST_CHECK(meta_index::open(meta_path, true) == nullptr);
+  BOOST_CHECK_THROW(meta_index::build(meta_path), std::runtime_error);
+  fs::remove(meta_path);
+}
+
+#endif
@@ -0,0 +1,83 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string>
+#include <boost/regex.hpp>
+#include <boost/test/unit_test.hpp>
+#include <sigmf/meta_key.h>
+
+using namespace gr::sigmf;
+
+BOOST_AUTO_TEST_CASE(t_key_validation_matches_regex)
+{
+  // The check meta_key replaced
+  const boost::regex key_regex("(^\\w+:\\w+$)");
+  const std::string keys[] = {"core:sample_start",
+                              "a:b",
+                              "_:_",
+                              "A1:b2",
+                              "",
+                              ":",
+                              ":a",
+                              "a:",
+                              "a",
+                              "a:b:c",
+                              "a::b",
+                              " a:b",
+                              "a:b ",
+                              "a:b\n",
+                              "\na:b",
+                              "a-b:c",
+                              "a.b:c",
+                              "a:b c",
+                              std::string("a:\0b", 4),
+                              "caf\xc3\xa9:x",
+                              "x:caf\xc3\xa9",
+                              "\xff:a",
+                              "a:\x80"};
+  for(const std::string &key : keys) {
+    BOOST_CHECK_MESSAGE(meta_key::is_valid_key(key) == boost::regex_match(key, key_regex),
+                        "is_valid_key differs from the regex for '" << key << "'");
+  }
+
+  BOOST_CHECK(meta_key::is_valid_key("core:sample_start"));
+  BOOST_CHECK(meta_key::is_valid_key("_:_"));
+  BOOST_CHECK(!meta_key::is_valid_key(":a"));
+  BOOST_CHECK(!meta_key::is_valid_key("a:"));
+  BOOST_CHECK(!meta_key::is_valid_key("a:b:c"));
+  BOOST_CHECK(!meta_key::is_valid_key("caf\xc3\xa9:x"));
+}
+
+BOOST_AUTO_TEST_CASE(t_key_interning)
+{
+  const meta_key &key = meta_key::intern("test:interned");
+  BOOST_CHECK(&key == &meta_key::intern(std::string("test:") + "interned"));
+  BOOST_CHECK(meta_key::lookup("test:interned") == &key);
+  BOOST_CHECK(meta_key::lookup("test:never_interned_anywhere") == NULL);
+  BOOST_CHECK(key.valid());
+  BOOST_CHECK_EQUAL(key.ns(), "test");
+  BOOST_CHECK_EQUAL(key.name(), "interned");
+
+  // Invalid keys are interned too, with no namespace or name
+  const meta_key &invalid = meta_key::intern("no_namespace");
+  BOOST_CHECK(!invalid.valid());
+  BOOST_CHECK(invalid.ns().empty());
+  BOOST_CHECK(invalid.name().empty());
+}
@@ -0,0 +1,237 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <sigmf/meta_map.h>
+#include <sigmf/meta_namespace.h>
+
+using namespace gr::sigmf;
+
+namespace {
+  const meta_key &
+  test_key(size_t i)
+  {
+    return meta_key::intern("test:key_" + std::to_string(i));
+  }
+
+  int64_t
+  value_of(const meta_map &map, const meta_key &key)
+  {
+    const meta_value *val = map.find(key);
+    int64_t out = -1;
+    BOOST_REQUIRE(val != NULL);
+    BOOST_REQUIRE(val->as(out));
+    return out;
+  }
+
+  std::vector<std::string>
+  keys_in_order(const meta_map &map)
+  {
+    std::vector<std::string> keys;
+    for(const meta_map::entry &e : map) {
+      keys.push_back(e.key->str());
+    }
+    return keys;
+  }
+} // namespace
+
+BOOST_AUTO_TEST_CASE(t_map_set_replaces_in_place)
+{
+  meta_map map;
+  map.set(test_key(0), meta_value(0));
+  map.set(test_key(1), meta_value(1));
+  map.set(test_key(2), meta_value(2));
+  map.set(test_key(1), meta_value("replaced"));
+
+  BOOST_CHECK_EQUAL(map.size(), 3);
+  std::vector<std::string> expected = {"test:key_0", "test:key_1", "test:key_2"};
+  std::vector<std::string> found = keys_in_order(map);
+  BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(), expected.begin(), expected.end());
+  BOOST_REQUIRE(map.find(test_key(1)) != NULL);
+  BOOST_CHECK_EQUAL(map.find(test_key(1))->str(), "replaced");
+  BOOST_CHECK(map.find("test:key_1") == map.find(test_key(1)));
+  BOOST_CHECK(map.find("test:never_interned_anywhere") == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(t_map_growth)
+{
+  // Past several rehashes, from the minimum table size up
+  meta_map map;
+  const size_t count = 5000;
+  for(size_t i = 0; i < count; i++) {
+    map.set(test_key(i), meta_value(long(i)));
+    BOOST_REQUIRE_EQUAL(map.size(), i + 1);
+  }
+  for(size_t i = 0; i < count; i++) {
+    BOOST_REQUIRE_EQUAL(value_of(map, test_key(i)), int64_t(i));
+  }
+  size_t i = 0;
+  for(const meta_map::entry &e : map) {
+    BOOST_REQUIRE(e.key == &test_key(i++));
+  }
+
+  // Reserving up front gives the same map
+  meta_map reserved;
+  reserved.reserve(count);
+  for(size_t i = 0; i < count; i++) {
+    reserved.set(test_key(i), meta_value(long(i)));
+  }
+  BOOST_CHECK(keys_in_order(reserved) == keys_in_order(map));
+}
+
+BOOST_AUTO_TEST_CASE(t_map_erase)
+{
+  meta_map map;
+  const size_t count = 300;
+  for(size_t i = 0; i < count; i++) {
+    map.set(test_key(i), meta_value(long(i)));
+  }
+  for(size_t i = 0; i < count; i += 3) {
+    BOOST_REQUIRE(map.erase(test_key(i)));
+  }
+  BOOST_CHECK(!map.erase(test_key(0)));
+  BOOST_CHECK(!map.erase(meta_key::intern("test:not_in_map")));
+  BOOST_CHECK_EQUAL(map.size(), count - count / 3);
+
+  // The rest are still found after the table is rebuilt, in order
+  std::vector<std::string> expected;
+  for(size_t i = 0; i < count; i++) {
+    if(i % 3 == 0) {
+      BOOST_CHECK(map.find(test_key(i)) == NULL);
+    } else {
+      BOOST_CHECK_EQUAL(value_of(map, test_key(i)), int64_t(i));
+      expected.push_back(test_key(i).str());
+    }
+  }
+  std::vector<std::string> found = keys_in_order(map);
+  BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(), expected.begin(), expected.end());
+
+  // Set again, an erased key goes on the end
+  map.set(test_key(0), meta_value(42));
+  BOOST_CHECK_EQUAL(value_of(map, test_key(0)), 42);
+  BOOST_CHECK(map.begin()[map.size() - 1].key == &test_key(0));
+
+  // Erasing everything leaves an empty map that still works
+  for(size_t i = 0; i < count; i++) {
+    map.erase(test_key(i));
+  }
+  BOOST_CHECK(map.empty());
+  BOOST_CHECK(map.find(test_key(1)) == NULL);
+  map.set(test_key(1), meta_value(1));
+  BOOST_CHECK_EQUAL(value_of(map, test_key(1)), 1);
+}
+
+BOOST_AUTO_TEST_CASE(t_map_core_slots)
+{
+  const meta_key &start = meta_key::core(meta_key::SAMPLE_START);
+  const meta_key &count = meta_key::core(meta_key::SAMPLE_COUNT);
+  BOOST_CHECK(&start == &meta_key::intern("core:sample_start"));
+  BOOST_CHECK(meta_key::intern("core:sample_count").field() == meta_key::SAMPLE_COUNT);
+  BOOST_CHECK(test_key(0).field() == meta_key::NOT_CORE);
+
+  meta_map map;
+  BOOST_CHECK(map.find(meta_key::SAMPLE_START) == NULL);
+  map.set(test_key(0), meta_value(0));
+  map.set(start, meta_value(100));
+  map.set(test_key(1), meta_value(1));
+  map.set(count, meta_value(10));
+  BOOST_CHECK(map.find(meta_key::SAMPLE_START) == map.find(start));
+  BOOST_CHECK_EQUAL(value_of(map, start), 100);
+
+  // Replacing a core field keeps its slot and its place
+  map.set(start, meta_value(200));
+  BOOST_CHECK_EQUAL(map.size(), 4);
+  BOOST_CHECK(map.begin()[1].key == &start);
+  BOOST_CHECK(map.find(meta_key::SAMPLE_START) == &map.begin()[1].value);
+  BOOST_CHECK_EQUAL(value_of(map, start), 200);
+
+  // Erasing an entry before the core fields moves them down, and their
+  // slots have to follow
+  BOOST_REQUIRE(map.erase(test_key(0)));
+  BOOST_CHECK(map.find(meta_key::SAMPLE_START) == &map.begin()[0].value);
+  BOOST_CHECK(map.find(meta_key::SAMPLE_COUNT) == &map.begin()[2].value);
+  BOOST_CHECK_EQUAL(value_of(map, start), 200);
+  BOOST_CHECK_EQUAL(value_of(map, count), 10);
+
+  BOOST_REQUIRE(map.erase(start));
+  BOOST_CHECK(map.find(meta_key::SAMPLE_START) == NULL);
+  BOOST_CHECK(map.find(start) == NULL);
+  BOOST_CHECK(map.find(meta_key::SAMPLE_COUNT) == &map.begin()[1].value);
+  BOOST_CHECK_EQUAL(value_of(map, count), 10);
+
+  // And through growth
+  for(size_t i = 2; i < 1000; i++) {
+    map.set(test_key(i), meta_value(long(i)));
+  }
+  map.set(start, meta_value(300));
+  BOOST_CHECK(map.find(meta_key::SAMPLE_START) == &map.begin()[map.size() - 1].value);
+  BOOST_CHECK_EQUAL(value_of(map, start), 300);
+  BOOST_CHECK_EQUAL(value_of(map, count), 10);
+}
+
+BOOST_AUTO_TEST_CASE(t_namespace_typed_access)
+{
+  const uint64_t big = uint64_t(std::numeric_limits<int64_t>::max()) + 1;
+  meta_namespace ns = meta_namespace::build_annotation_segment(5, 10);
+  ns.set("test:negative", -7);
+  ns.set("test:big", big);
+  ns.set("test:real", 2.5);
+  ns.set("test:label", "text");
+
+  uint64_t u = 0;
+  int64_t s = 0;
+  double d = 0;
+  std::string str;
+  BOOST_CHECK(ns.try_get(meta_key::SAMPLE_START, u));
+  BOOST_CHECK_EQUAL(u, 5);
+  BOOST_CHECK_EQUAL(ns.get_as<uint64_t>(meta_key::SAMPLE_COUNT), 10);
+  BOOST_CHECK_EQUAL(ns.get_as<int64_t>("core:sample_count"), 10);
+
+  // A negative int isn't a uint64
+  BOOST_CHECK(!ns.try_get("test:negative", u));
+  BOOST_CHECK_THROW(ns.get_as<uint64_t>("test:negative"), std::runtime_error);
+  BOOST_CHECK_EQUAL(ns.get_as<int64_t>("test:negative"), -7);
+  BOOST_CHECK_EQUAL(ns.get_as<double>("test:negative"), -7.0);
+
+  // A uint64 above INT64_MAX isn't an int64
+  BOOST_CHECK(!ns.try_get("test:big", s));
+  BOOST_CHECK_THROW(ns.get_as<int64_t>("test:big"), std::runtime_error);
+  BOOST_CHECK_EQUAL(ns.get_as<uint64_t>("test:big"), big);
+
+  // Doubles and strings don't read as integers, or the other way round
+  BOOST_CHECK(!ns.try_get("test:real", u));
+  BOOST_CHECK(!ns.try_get("test:real", s));
+  BOOST_CHECK(ns.try_get("test:real", d));
+  BOOST_CHECK_EQUAL(d, 2.5);
+  BOOST_CHECK(!ns.try_get("test:label", d));
+  BOOST_CHECK(ns.try_get("test:label", str));
+  BOOST_CHECK_EQUAL(str, "text");
+  BOOST_CHECK(!ns.try_get("test:big", str));
+
+  // Missing keys, core or not
+  BOOST_CHECK(!ns.try_get("test:missing", u));
+  BOOST_CHECK(!ns.try_get(meta_key::FREQUENCY, d));
+  BOOST_CHECK_THROW(ns.get_as<double>(meta_key::FREQUENCY), std::runtime_error);
+}
@@ -0,0 +1,95 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "metafile_layout.h"
+
+using namespace gr::sigmf;
+
+namespace {
+  std::vector<std::string>
+  segments(const std::string &json, const metafile_layout &layout)
+  {
+    std::vector<std::string> result;
+    for(const metafile_layout::range &r : layout.annotations) {
+      result.push_back(json.substr(r.offset, r.length));
+    }
+    return result;
+  }
+
+  bool
+  has_layout(const std::string &json)
+  {
+    metafile_layout layout;
+    return find_metafile_layout(json.data(), json.size(), layout);
+  }
+} // namespace
+
+BOOST_AUTO_TEST_CASE(t_layout_segments)
+{
+  std::string json = "{\"global\": {\"annotations\": [1]},\n"
+                     " \"captures\": [{\"core:sample_start\": 0}],\n"
+                     " \"annotations\": [\n"
+                     "  {\"a\": \"}]\\\"{\"},\n"
+                     "  {\"b\": [1, {\"c\": \"\\\\\"}]} , {}\n"
+                     " ]}\n";
+  metafile_layout layout;
+  BOOST_REQUIRE(find_metafile_layout(json.data(), json.size(), layout));
+  BOOST_CHECK_EQUAL(json[layout.annotations_open], '[');
+  BOOST_CHECK_EQUAL(json[layout.annotations_close], ']');
+
+  std::vector<std::string> expected = {
+    "{\"a\": \"}]\\\"{\"}", "{\"b\": [1, {\"c\": \"\\\\\"}]}", "{}"};
+  std::vector<std::string> found = segments(json, layout);
+  BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(t_layout_empty_annotations)
+{
+  std::string json = "{\"annotations\": [ ], \"global\": {}}";
+  metafile_layout layout;
+  BOOST_REQUIRE(find_metafile_layout(json.data(), json.size(), layout));
+  BOOST_CHECK(layout.annotations.empty());
+  BOOST_CHECK_EQUAL(layout.annotations_close - layout.annotations_open, 2);
+}
+
+BOOST_AUTO_TEST_CASE(t_layout_ignores_values)
+{
+  // Only keys of the root object name the annotations array
+  std::string json = "{\"core:label\": \"annotations\", \"annotations\": [{\"a\": 1}]}";
+  metafile_layout layout;
+  BOOST_REQUIRE(find_metafile_layout(json.data(), json.size(), layout));
+  BOOST_CHECK_EQUAL(layout.annotations.size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(t_layout_not_found)
+{
+  BOOST_CHECK(!has_layout("{\"global\": {}}"));
+  BOOST_CHECK(!has_layout("[{\"annotations\": []}]"));
+  BOOST_CHECK(!has_layout("{\"annotations\": {}}"));
+  BOOST_CHECK(!has_layout("{\"annotations\": [1]}"));
+  BOOST_CHECK(!has_layout("{\"annotations\": [[]]}"));
+  BOOST_CHECK(!has_layout("{\"annotations\": [], \"annotations\": []}"));
+  BOOST_CHECK(!has_layout("{\"annot\\u0061tions\": []}"));
+  BOOST_CHECK(!has_layout("{\"annotations\": [{\"a\": 1}"));
+  BOOST_CHECK(!has_layout("{\"annotations\": [{\"a\": \"}]}"));
+}
@@ -0,0 +1,170 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "simd_kernels.h"
+
+using namespace gr::sigmf::simd;
+
+namespace {
+  // Odd lengths so every variant's scalar tail runs too
+  const size_t LENGTHS[] = {0, 1, 3, 7, 15, 17, 31, 33, 63, 65, 1000, 4099};
+
+  template <typename T>
+  std::vector<T>
+  random_ints(size_t count)
+  {
+    std::mt19937 rng(count);
+    std::uniform_int_distribution<int64_t> dist(std::numeric_limits<T>::lowest(),
+                                                std::numeric_limits<T>::max());
+    std::vector<T> v(count);
+    for(T &x : v) {
+      x = static_cast<T>(dist(rng));
+    }
+    return v;
+  }
+
+  // Halfway cases, values at the saturation edges, infinities, NaNs and
+  // random values
+  std::vector<float>
+  test_floats(size_t count)
+  {
+    const float special[] = {0.5f,
+                             1.5f,
+                             2.5f,
+                             -0.5f,
+                             -1.5f,
+                             -2.5f,
+                             2147483520.0f,
+                             2147483648.0f,
+                             -2147483520.0f,
+                             -2147483648.0f,
+                             1e20f,
+                             -1e20f,
+                             std::numeric_limits<float>::infinity(),
+                             -std::numeric_limits<float>::infinity(),
+                             std::numeric_limits<float>::quiet_NaN(),
+                             -std::numeric_limits<float>::quiet_NaN()};
+    const size_t num_special = sizeof(special) / sizeof(special[0]);
+    std::mt19937 rng(count);
+    std::uniform_real_distribution<float> dist(-3e9f, 3e9f);
+    std::vector<float> v(count);
+    for(size_t i = 0; i < count; i++) {
+      v[i] = (i % 3 == 0) ? special[(i / 3) % num_special] : dist(rng);
+    }
+    return v;
+  }
+
+  template <typename out_t, typename in_t>
+  void
+  check_kernel(void (*kernels::*kernel)(out_t *, const in_t *, size_t),
+               const std::vector<in_t> &in)
+  {
+    std::vector<out_t> expected(in.size());
+    (get_kernels(ISA_GENERIC).*kernel)(expected.data(), in.data(), in.size());
+    for(int isa = ISA_GENERIC + 1; isa < NUM_ISAS; isa++) {
+      if(!isa_supported(static_cast<isa_t>(isa))) {
+        BOOST_TEST_MESSAGE("skipping " << isa_name(static_cast<isa_t>(isa)));
+        continue;
+      }
+      std::vector<out_t> actual(in.size());
+      (get_kernels(static_cast<isa_t>(isa)).*kernel)(actual.data(), in.data(), in.size());
+      BOOST_CHECK_MESSAGE(
+        in.empty() ||
+          std::memcmp(expected.data(), actual.data(), in.size() * sizeof(out_t)) == 0,
+        isa_name(static_cast<isa_t>(isa)) << " differs from generic for " << in.size()
+                                          << " items");
+    }
+  }
+} // namespace
+
+BOOST_AUTO_TEST_CASE(t_i32_to_i16)
+{
+  for(size_t n : LENGTHS) {
+    check_kernel(&kernels::i32_to_i16, random_ints<int32_t>(n));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(t_i32_to_i8)
+{
+  for(size_t n : LENGTHS) {
+    check_kernel(&kernels::i32_to_i8, random_ints<int32_t>(n));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(t_i16_to_i32)
+{
+  for(size_t n : LENGTHS) {
+    check_kernel(&kernels::i16_to_i32, random_ints<int16_t>(n));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(t_i8_to_i32)
+{
+  for(size_t n : LENGTHS) {
+    check_kernel(&kernels::i8_to_i32, random_ints<int8_t>(n));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(t_f32_to_i32)
+{
+  for(size_t n : LENGTHS) {
+    check_kernel(&kernels::f32_to_i32, test_floats(n));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(t_f32_to_i32_saturates)
+{
+  const float in[] = {3e9f, -3e9f, 2147483648.0f, -2147483648.0f, 2.5f, -3.5f};
+  const int32_t min = std::numeric_limits<int32_t>::min();
+  const int32_t expected[] = {2147483647, min, 2147483647, min, 2, -4};
+  int32_t out[6];
+  dispatched().f32_to_i32(out, in, 6);
+  BOOST_CHECK_EQUAL_COLLECTIONS(out, out + 6, expected, expected + 6);
+}
+
+BOOST_AUTO_TEST_CASE(t_f32_to_i32_special)
+{
+  const float inf = std::numeric_limits<float>::infinity();
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  // Long enough that every variant handles some in vectors and some in
+  // its scalar tail
+  std::vector<float> in;
+  for(size_t i = 0; i < 37; i++) {
+    in.push_back(i % 3 == 0 ? nan : (i % 3 == 1 ? inf : -inf));
+  }
+  for(int isa = ISA_GENERIC; isa < NUM_ISAS; isa++) {
+    if(!isa_supported(static_cast<isa_t>(isa))) {
+      continue;
+    }
+    std::vector<int32_t> out(in.size());
+    get_kernels(static_cast<isa_t>(isa)).f32_to_i32(out.data(), in.data(), in.size());
+    for(size_t i = 0; i < in.size(); i++) {
+      int32_t expected = i % 3 == 1 ? 2147483647 : std::numeric_limits<int32_t>::min();
+      BOOST_CHECK_MESSAGE(out[i] == expected,
+                          isa_name(static_cast<isa_t>(isa)) << " gives " << out[i]
+                                                            << " for item " << i);
+    }
+  }
+}
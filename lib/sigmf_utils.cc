@@ -19,6 +19,7 @@
  */
 
 #include "sigmf/sigmf_utils.h"
+#include <boost/endian/conversion.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
@@ -47,21 +48,32 @@ namespace gr {
     parse_format_str(const std::string &format_str)
     {
 
-      boost::regex format_regex("(r|c)((f|i|u)(8|16|32))(_(le|be))?");
+      boost::regex format_regex("(r|c)((f|i|u)(8|16|32|64))(_(le|be))?");
+      // Packed sub-byte formats, only for complex samples
+      boost::regex packed_regex("(c)(i(4|12))(_(le|be))?");
       boost::smatch result;
 
+      format_detail_t detail;
+      boost::ssub_match endianness;
       if(boost::regex_match(format_str, result, format_regex)) {
-        format_detail_t detail;
-        detail.is_complex = result[1] == "c";
-        detail.type_str = result[2];
         detail.width = boost::lexical_cast<size_t>(result[4]);
-        if(result[6].matched) {
-          detail.endianness = result[6] == "le" ? LITTLE : BIG;
-        }
-        return detail;
+        endianness = result[6];
+      } else if(boost::regex_match(format_str, result, packed_regex)) {
+        detail.width = boost::lexical_cast<size_t>(result[3]);
+        endianness = result[5];
       } else {
         throw std::runtime_error("bad format str");
       }
+      detail.is_complex = result[1] == "c";
+      detail.type_str = result[2];
+      if(endianness.matched) {
+        detail.endianness = endianness == "le" ? LITTLE : BIG;
+      } else {
+        // No suffix, which is only valid for 8 bit types where it doesn't matter
+        detail.endianness =
+          boost::endian::order::native == boost::endian::order::little ? LITTLE : BIG;
+      }
+      return detail;
     }
   } // namespace sigmf
 } // namespace gr
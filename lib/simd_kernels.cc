@@ -0,0 +1,431 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "simd_kernels.h"
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+
+#if(defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define SIGMF_HAVE_X86_KERNELS 1
+#endif
+
+namespace gr {
+  namespace sigmf {
+    namespace simd {
+
+      namespace {
+        const int32_t MAX_INT = std::numeric_limits<int32_t>::max();
+        const int32_t MIN_INT = std::numeric_limits<int32_t>::lowest();
+        // Smallest float that rounds to MAX_INT or more
+        const float MAX_INT_FLOAT = 2147483648.0f;
+
+        /*
+         * Scalar reference versions, which the others have to match and
+         * which they use for the items left over after the last vector
+         */
+        void
+        i32_to_i16_generic(int16_t *out, const int32_t *in, size_t count)
+        {
+          for(size_t i = 0; i < count; i++) {
+            out[i] = static_cast<int16_t>(in[i]);
+          }
+        }
+
+        void
+        i32_to_i8_generic(int8_t *out, const int32_t *in, size_t count)
+        {
+          for(size_t i = 0; i < count; i++) {
+            out[i] = static_cast<int8_t>(in[i]);
+          }
+        }
+
+        void
+        i16_to_i32_generic(int32_t *out, const int16_t *in, size_t count)
+        {
+          for(size_t i = 0; i < count; i++) {
+            out[i] = in[i];
+          }
+        }
+
+        void
+        i8_to_i32_generic(int32_t *out, const int8_t *in, size_t count)
+        {
+          for(size_t i = 0; i < count; i++) {
+            out[i] = in[i];
+          }
+        }
+
+        void
+        f32_to_i32_generic(int32_t *out, const float *in, size_t count)
+        {
+          for(size_t i = 0; i < count; i++) {
+            double r = std::nearbyint(static_cast<double>(in[i]));
+            if(std::isnan(r)) {
+              // What cvtps gives for NaN
+              out[i] = MIN_INT;
+            } else if(r >= MAX_INT) {
+              out[i] = MAX_INT;
+            } else if(r <= MIN_INT) {
+              out[i] = MIN_INT;
+            } else {
+              out[i] = static_cast<int32_t>(r);
+            }
+          }
+        }
+
+        const kernels GENERIC_KERNELS = {i32_to_i16_generic,
+                                         i32_to_i8_generic,
+                                         i16_to_i32_generic,
+                                         i8_to_i32_generic,
+                                         f32_to_i32_generic};
+
+#ifdef SIGMF_HAVE_X86_KERNELS
+        /*
+         * SSE4.1. Narrowing masks off the high bits so the unsigned
+         * saturating packs keep the low bits unchanged.
+         */
+        __attribute__((target("sse4.1"))) void
+        i32_to_i16_sse41(int16_t *out, const int32_t *in, size_t count)
+        {
+          const __m128i mask = _mm_set1_epi32(0xffff);
+          size_t i = 0;
+          for(; i + 8 <= count; i += 8) {
+            __m128i a = _mm_and_si128(
+              _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)), mask);
+            __m128i b = _mm_and_si128(
+              _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 4)), mask);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi32(a, b));
+          }
+          i32_to_i16_generic(out + i, in + i, count - i);
+        }
+
+        __attribute__((target("sse4.1"))) void
+        i32_to_i8_sse41(int8_t *out, const int32_t *in, size_t count)
+        {
+          const __m128i mask = _mm_set1_epi32(0xff);
+          const __m128i *src = reinterpret_cast<const __m128i *>(in);
+          size_t i = 0;
+          for(; i + 16 <= count; i += 16, src += 4) {
+            __m128i a = _mm_and_si128(_mm_loadu_si128(src), mask);
+            __m128i b = _mm_and_si128(_mm_loadu_si128(src + 1), mask);
+            __m128i c = _mm_and_si128(_mm_loadu_si128(src + 2), mask);
+            __m128i d = _mm_and_si128(_mm_loadu_si128(src + 3), mask);
+            __m128i ab = _mm_packus_epi32(a, b);
+            __m128i cd = _mm_packus_epi32(c, d);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(ab, cd));
+          }
+          i32_to_i8_generic(out + i, in + i, count - i);
+        }
+
+        __attribute__((target("sse4.1"))) void
+        i16_to_i32_sse41(int32_t *out, const int16_t *in, size_t count)
+        {
+          size_t i = 0;
+          for(; i + 8 <= count; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_cvtepi16_epi32(v));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 4),
+                             _mm_cvtepi16_epi32(_mm_srli_si128(v, 8)));
+          }
+          i16_to_i32_generic(out + i, in + i, count - i);
+        }
+
+        __attribute__((target("sse4.1"))) void
+        i8_to_i32_sse41(int32_t *out, const int8_t *in, size_t count)
+        {
+          size_t i = 0;
+          for(; i + 16 <= count; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            for(size_t j = 0; j < 4; j++) {
+              _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 4 * j),
+                               _mm_cvtepi8_epi32(v));
+              v = _mm_srli_si128(v, 4);
+            }
+          }
+          i8_to_i32_generic(out + i, in + i, count - i);
+        }
+
+        // cvtps rounds to nearest even like nearbyint, and gives INT_MIN
+        // when out of range, so only values that are too big need
+        // saturating before storing
+        __attribute__((target("sse4.1"))) void
+        f32_to_i32_sse41(int32_t *out, const float *in, size_t count)
+        {
+          const __m128 hi = _mm_set1_ps(MAX_INT_FLOAT);
+          const __m128i max_val = _mm_set1_epi32(MAX_INT);
+          size_t i = 0;
+          for(; i + 4 <= count; i += 4) {
+            __m128 v = _mm_loadu_ps(in + i);
+            __m128i r = _mm_cvtps_epi32(v);
+            r = _mm_blendv_epi8(r, max_val, _mm_castps_si128(_mm_cmpge_ps(v, hi)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), r);
+          }
+          f32_to_i32_generic(out + i, in + i, count - i);
+        }
+
+        const kernels SSE41_KERNELS = {i32_to_i16_sse41,
+                                       i32_to_i8_sse41,
+                                       i16_to_i32_sse41,
+                                       i8_to_i32_sse41,
+                                       f32_to_i32_sse41};
+
+        /*
+         * AVX2. The packs work within 128 bit lanes, so the results are
+         * permuted back into order.
+         */
+        __attribute__((target("avx2"))) void
+        i32_to_i16_avx2(int16_t *out, const int32_t *in, size_t count)
+        {
+          const __m256i mask = _mm256_set1_epi32(0xffff);
+          size_t i = 0;
+          for(; i + 16 <= count; i += 16) {
+            __m256i a = _mm256_and_si256(
+              _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i)), mask);
+            __m256i b = _mm256_and_si256(
+              _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i + 8)), mask);
+            __m256i r = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b),
+                                                 _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), r);
+          }
+          i32_to_i16_generic(out + i, in + i, count - i);
+        }
+
+        __attribute__((target("avx2"))) void
+        i32_to_i8_avx2(int8_t *out, const int32_t *in, size_t count)
+        {
+          const __m256i mask = _mm256_set1_epi32(0xff);
+          const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+          const __m256i *src = reinterpret_cast<const __m256i *>(in);
+          size_t i = 0;
+          for(; i + 32 <= count; i += 32, src += 4) {
+            __m256i a = _mm256_and_si256(_mm256_loadu_si256(src), mask);
+            __m256i b = _mm256_and_si256(_mm256_loadu_si256(src + 1), mask);
+            __m256i c = _mm256_and_si256(_mm256_loadu_si256(src + 2), mask);
+            __m256i d = _mm256_and_si256(_mm256_loadu_si256(src + 3), mask);
+            __m256i abcd =
+              _mm256_packus_epi16(_mm256_packus_epi32(a, b), _mm256_packus_epi32(c, d));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+                                _mm256_permutevar8x32_epi32(abcd, order));
+          }
+          i32_to_i8_generic(out + i, in + i, count - i);
+        }
+
+        __attribute__((target("avx2"))) void
+        i16_to_i32_avx2(int32_t *out, const int16_t *in, size_t count)
+        {
+          size_t i = 0;
+          for(; i + 16 <= count; i += 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 8));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_cvtepi16_epi32(a));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i + 8),
+                                _mm256_cvtepi16_epi32(b));
+          }
+          i16_to_i32_generic(out + i, in + i, count - i);
+        }
+
+        __attribute__((target("avx2"))) void
+        i8_to_i32_avx2(int32_t *out, const int8_t *in, size_t count)
+        {
+          size_t i = 0;
+          for(; i + 16 <= count; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_cvtepi8_epi32(v));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i + 8),
+                                _mm256_cvtepi8_epi32(_mm_srli_si128(v, 8)));
+          }
+          i8_to_i32_generic(out + i, in + i, count - i);
+        }
+
+        __attribute__((target("avx2"))) void
+        f32_to_i32_avx2(int32_t *out, const float *in, size_t count)
+        {
+          const __m256 hi = _mm256_set1_ps(MAX_INT_FLOAT);
+          const __m256i max_val = _mm256_set1_epi32(MAX_INT);
+          size_t i = 0;
+          for(; i + 8 <= count; i += 8) {
+            __m256 v = _mm256_loadu_ps(in + i);
+            __m256i r = _mm256_cvtps_epi32(v);
+            r = _mm256_blendv_epi8(
+              r, max_val, _mm256_castps_si256(_mm256_cmp_ps(v, hi, _CMP_GE_OQ)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), r);
+          }
+          f32_to_i32_generic(out + i, in + i, count - i);
+        }
+
+        const kernels AVX2_KERNELS = {
+          i32_to_i16_avx2, i32_to_i8_avx2, i16_to_i32_avx2, i8_to_i32_avx2, f32_to_i32_avx2};
+
+        /*
+         * AVX-512F has truncating narrowing moves, so no masking is needed
+         */
+        __attribute__((target("avx512f"))) void
+        i32_to_i16_avx512(int16_t *out, const int32_t *in, size_t count)
+        {
+          size_t i = 0;
+          for(; i + 16 <= count; i += 16) {
+            __m512i v = _mm512_loadu_si512(in + i);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm512_cvtepi32_epi16(v));
+          }
+          i32_to_i16_generic(out + i, in + i, count - i);
+        }
+
+        __attribute__((target("avx512f"))) void
+        i32_to_i8_avx512(int8_t *out, const int32_t *in, size_t count)
+        {
+          size_t i = 0;
+          for(; i + 16 <= count; i += 16) {
+            __m512i v = _mm512_loadu_si512(in + i);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm512_cvtepi32_epi8(v));
+          }
+          i32_to_i8_generic(out + i, in + i, count - i);
+        }
+
+        __attribute__((target("avx512f"))) void
+        i16_to_i32_avx512(int32_t *out, const int16_t *in, size_t count)
+        {
+          size_t i = 0;
+          for(; i + 16 <= count; i += 16) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+            _mm512_storeu_si512(out + i, _mm512_cvtepi16_epi32(v));
+          }
+          i16_to_i32_generic(out + i, in + i, count - i);
+        }
+
+        __attribute__((target("avx512f"))) void
+        i8_to_i32_avx512(int32_t *out, const int8_t *in, size_t count)
+        {
+          size_t i = 0;
+          for(; i + 16 <= count; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            _mm512_storeu_si512(out + i, _mm512_cvtepi8_epi32(v));
+          }
+          i8_to_i32_generic(out + i, in + i, count - i);
+        }
+
+        __attribute__((target("avx512f"))) void
+        f32_to_i32_avx512(int32_t *out, const float *in, size_t count)
+        {
+          const __m512 hi = _mm512_set1_ps(MAX_INT_FLOAT);
+          const __m512i max_val = _mm512_set1_epi32(MAX_INT);
+          size_t i = 0;
+          for(; i + 16 <= count; i += 16) {
+            __m512 v = _mm512_loadu_ps(in + i);
+            __m512i r = _mm512_cvtps_epi32(v);
+            r = _mm512_mask_mov_epi32(r, _mm512_cmp_ps_mask(v, hi, _CMP_GE_OQ), max_val);
+            _mm512_storeu_si512(out + i, r);
+          }
+          f32_to_i32_generic(out + i, in + i, count - i);
+        }
+
+        const kernels AVX512_KERNELS = {i32_to_i16_avx512,
+                                        i32_to_i8_avx512,
+                                        i16_to_i32_avx512,
+                                        i8_to_i32_avx512,
+                                        f32_to_i32_avx512};
+#endif
+      } // namespace
+
+      const char *
+      isa_name(isa_t isa)
+      {
+        switch(isa) {
+          case ISA_GENERIC:
+            return "generic";
+          case ISA_SSE41:
+            return "sse4.1";
+          case ISA_AVX2:
+            return "avx2";
+          case ISA_AVX512:
+            return "avx512";
+          default:
+            return "unknown";
+        }
+      }
+
+      bool
+      isa_supported(isa_t isa)
+      {
+        switch(isa) {
+          case ISA_GENERIC:
+            return true;
+#ifdef SIGMF_HAVE_X86_KERNELS
+          case ISA_SSE41:
+            return __builtin_cpu_supports("sse4.1");
+          case ISA_AVX2:
+            return __builtin_cpu_supports("avx2");
+          case ISA_AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+          default:
+            return false;
+        }
+      }
+
+      const kernels &
+      get_kernels(isa_t isa)
+      {
+        if(!isa_supported(isa)) {
+          throw std::runtime_error(std::string("Conversion kernels for ") + isa_name(isa) +
+                                   " are not supported on this machine");
+        }
+        switch(isa) {
+#ifdef SIGMF_HAVE_X86_KERNELS
+          case ISA_SSE41:
+            return SSE41_KERNELS;
+          case ISA_AVX2:
+            return AVX2_KERNELS;
+          case ISA_AVX512:
+            return AVX512_KERNELS;
+#endif
+          default:
+            return GENERIC_KERNELS;
+        }
+      }
+
+      isa_t
+      best_isa()
+      {
+        static const isa_t best = []() {
+          if(std::getenv("VOLK_GENERIC") != NULL) {
+            return ISA_GENERIC;
+          }
+          int isa = NUM_ISAS - 1;
+          while(!isa_supported(static_cast<isa_t>(isa))) {
+            isa--;
+          }
+          return static_cast<isa_t>(isa);
+        }();
+        return best;
+      }
+
+      const kernels &
+      dispatched()
+      {
+        static const kernels &best = get_kernels(best_isa());
+        return best;
+      }
+
+    } // namespace simd
+  } // namespace sigmf
+} // namespace gr
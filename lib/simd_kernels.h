@@ -0,0 +1,69 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SIGMF_SIMD_KERNELS_H
+#define INCLUDED_SIGMF_SIMD_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gr {
+  namespace sigmf {
+    namespace simd {
+
+      /*
+       * Conversions VOLK has no kernel for, vectorized by hand for each
+       * x86 instruction set and picked at runtime from what the CPU
+       * supports. Every variant gives the same bits as the generic one.
+       */
+      enum isa_t { ISA_GENERIC = 0, ISA_SSE41, ISA_AVX2, ISA_AVX512, NUM_ISAS };
+
+      struct kernels {
+        // Integer narrowing keeps the low bits, like static_cast
+        void (*i32_to_i16)(int16_t *out, const int32_t *in, size_t count);
+        void (*i32_to_i8)(int8_t *out, const int32_t *in, size_t count);
+        void (*i16_to_i32)(int32_t *out, const int16_t *in, size_t count);
+        void (*i8_to_i32)(int32_t *out, const int8_t *in, size_t count);
+        // Rounds to nearest and saturates to [INT32_MIN, INT32_MAX]. NaN gives INT32_MIN.
+        void (*f32_to_i32)(int32_t *out, const float *in, size_t count);
+      };
+
+      const char *isa_name(isa_t isa);
+
+      //! true if this build has the variant and the CPU can run it
+      bool isa_supported(isa_t isa);
+
+      //! the kernels for an ISA, which must be supported
+      const kernels &get_kernels(isa_t isa);
+
+      /*!
+       * The best supported ISA, picked once. Setting VOLK_GENERIC makes
+       * this generic too, so benchmarks can compare against it.
+       */
+      isa_t best_isa();
+
+      //! get_kernels(best_isa())
+      const kernels &dispatched();
+
+    } // namespace simd
+  } // namespace sigmf
+} // namespace gr
+
+#endif /* INCLUDED_SIGMF_SIMD_KERNELS_H */
@@ -45,6 +45,7 @@
 #include "writer_utils.h"
 #include "pmt_utils.h"
 #include "sink_impl.h"
+#include <sigmf/type_converter.h>
 
 // win32 (mingw/msvc) specific
 #ifdef HAVE_IO_H
@@ -204,6 +205,8 @@ namespace gr {
       pmt::pmt_t author = d_global.get("core:author", pmt::get_PMT_NIL());
       pmt::pmt_t license = d_global.get("core:license",pmt::get_PMT_NIL());
       pmt::pmt_t hw = d_global.get("core:hw", pmt::get_PMT_NIL());
+      pmt::pmt_t scale = d_global.get(SCALE_META_KEY, pmt::get_PMT_NIL());
+      pmt::pmt_t offset = d_global.get(OFFSET_META_KEY, pmt::get_PMT_NIL());
 
       d_global = meta_namespace::build_global_object(d_type);
       if (!pmt::eqv(pmt::get_PMT_NIL(), samp_rate)) {
@@ -221,6 +224,10 @@ namespace gr {
       if (!pmt::eqv(pmt::get_PMT_NIL(), hw)) {
         d_global.set("core:hw", hw);
       }
+      if (!pmt::eqv(pmt::get_PMT_NIL(), scale)) {
+        d_global.set(SCALE_META_KEY, scale);
+        d_global.set(OFFSET_META_KEY, offset);
+      }
       d_annotations.clear();
       // We don't clear the captures here, as there is some extra
       // work that must be done to avoid data loss since captures
@@ -388,6 +395,19 @@ namespace gr {
       d_global.set(key, pmt::from_bool(val));
     }
 
+    void
+    sink_impl::set_scale(double scale, double offset)
+    {
+      d_global.set(SCALE_META_KEY, pmt::from_double(scale));
+      d_global.set(OFFSET_META_KEY, pmt::from_double(offset));
+    }
+
+    void
+    sink_impl::set_compact_meta(bool compact)
+    {
+      d_compact_meta = compact;
+    }
+
     void
     sink_impl::set_capture_meta(uint64_t index, std::string key, pmt::pmt_t val)
     {
@@ -409,10 +429,9 @@ namespace gr {
     sink_impl::set_annotation_meta(uint64_t sample_start, uint64_t sample_count, std::string key, pmt::pmt_t val)
     {
       auto existing_annotation = std::find_if(d_annotations.begin(), d_annotations.end(), [sample_start, sample_count](const meta_namespace &ns) -> bool {
-        return ns.has("core:sample_start") &&
-          pmt::to_uint64(ns.get("core:sample_start")) == sample_start &&
-          ns.has("core:sample_count") &&
-          pmt::to_uint64(ns.get("core:sample_count")) == sample_count;
+        uint64_t start, count;
+        return ns.try_get(meta_key::SAMPLE_START, start) && start == sample_start &&
+          ns.try_get(meta_key::SAMPLE_COUNT, count) && count == sample_count;
       });
       if (existing_annotation == d_annotations.end()) {
         // then make a new one
@@ -652,7 +671,7 @@ namespace gr {
       if (fp == nullptr) {
         std::perror("Error opening d_meta_path");
       }
-      writer_utils::write_meta_to_fp(fp, d_global, d_captures, d_annotations);
+      writer_utils::write_meta_to_fp(fp, d_global, d_captures, d_annotations, !d_compact_meta);
       std::fclose(fp);
       d_meta_written = true;
     }
@@ -761,11 +780,11 @@ namespace gr {
 
         // Handle any capture tags
         if(std::distance(tag_begin, annotations_begin) > 0) {
-          pmt::pmt_t most_recent_segment_start =
-            d_captures.back().get("core:sample_start");
+          uint64_t most_recent_segment_start =
+            d_captures.back().get_as<uint64_t>(meta_key::SAMPLE_START);
 
           // If there's already a segment for this sample index, then use that
-          if(offset != pmt::to_uint64(most_recent_segment_start)) {
+          if(offset != most_recent_segment_start) {
             // otherwise add a new empty segment
             meta_namespace new_capture;
             d_captures.push_back(new_capture);
@@ -794,11 +813,11 @@ namespace gr {
               found_packet_len = true;
               anno_ns.set("core:sample_count", (*tag_it)->value);
             } else {
-              std::string key_str = pmt::symbol_to_string((*tag_it)->key);
-              if (meta_namespace::validate_key(key_str)) {
-                anno_ns.set((*tag_it)->key, (*tag_it)->value);
+              const meta_key &key = meta_key::intern(pmt::symbol_to_string((*tag_it)->key));
+              if (key.valid()) {
+                anno_ns.set(key, (*tag_it)->value);
               } else {
-                std::string unknown_ns_key = "unknown:" + key_str;
+                std::string unknown_ns_key = "unknown:" + key.str();
                 anno_ns.set(unknown_ns_key, (*tag_it)->value);
               }
             }
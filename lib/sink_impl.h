@@ -82,6 +82,16 @@ namespace gr {
         return 4;
       } else if(type_minus_endianness == "ru16") {
         return 2;
+      } else if(type_minus_endianness == "cu8") {
+        return 2;
+      } else if(type_minus_endianness == "ru8") {
+        return 1;
+      } else if(type_minus_endianness == "ci12") {
+        // Packed, 12 bits each for I and Q
+        return 3;
+      } else if(type_minus_endianness == "ci4") {
+        // Packed, 4 bits each for I and Q
+        return 1;
       } else {
         std::stringstream s;
         s << "unknown sigmf type " << type << std::endl;
@@ -108,6 +118,9 @@ namespace gr {
       // True if the metadata for the current file has been written
       bool d_meta_written = false;
 
+      // True to write the metadata without pretty printing
+      bool d_compact_meta = false;
+
       // The offset of the start of the current recording from
       // what the block believes
       uint64_t d_recording_start_offset;
@@ -211,6 +224,10 @@ namespace gr {
 
       void set_capture_meta(uint64_t index, std::string key, pmt::pmt_t val);
 
+      void set_scale(double scale, double offset);
+
+      void set_compact_meta(bool compact);
+
       // Where all the action really happens
       int work(int noutput_items, gr_vector_const_void_star &input_items, gr_vector_void_star &output_items);
 
@@ -22,49 +22,142 @@
 #include "config.h"
 #endif
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <set>
 #include <sstream>
 #include <boost/date_time.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/date_time/posix_time/conversion.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/replace.hpp>
 #include <boost/regex.hpp>
-#include <boost/algorithm/string/regex.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/endian/conversion.hpp>
 #include <gnuradio/io_signature.h>
+#include <volk/volk.h>
 #include "sigmf/sigmf_utils.h"
 #include "source_impl.h"
-#include "type_converter.h"
 #include "reader_utils.h"
 #include "tag_keys.h"
 
 namespace posix = boost::posix_time;
 namespace algo = boost::algorithm;
+namespace fs = boost::filesystem;
+namespace endian = boost::endian;
 
 namespace gr {
   namespace sigmf {
 
+    namespace {
+      FILE *
+      open_or_throw(const fs::path &path, const std::string &kind)
+      {
+        FILE *fp = fopen(path.c_str(), "r");
+        if(fp == NULL) {
+          std::stringstream s;
+          s << "failed to open " << kind << " file, errno = " << errno << std::endl;
+          throw std::runtime_error(s.str());
+        }
+        return fp;
+      }
+
+      /*
+       * Turn a list of recordings, some of which may be glob patterns,
+       * into a list of data file paths. Matches of a pattern are sorted by
+       * name, and a recording matched by both its data and meta file is
+       * only played once.
+       */
+      std::vector<fs::path>
+      expand_recordings(const std::vector<std::string> &filenames)
+      {
+        std::vector<fs::path> paths;
+        for(const std::string &filename : filenames) {
+          if(filename.find_first_of("*?") == std::string::npos) {
+            paths.push_back(to_data_path(filename));
+            continue;
+          }
+
+          fs::path pattern(filename);
+          fs::path dir = pattern.parent_path();
+          if(dir.empty()) {
+            dir = ".";
+          }
+          std::string name_regex = pattern.filename().string();
+          name_regex = boost::regex_replace(name_regex, boost::regex("[.^$|()\\[\\]{}+\\\\]"), "\\\\$&");
+          algo::replace_all(name_regex, "*", ".*");
+          algo::replace_all(name_regex, "?", ".");
+          boost::regex name_match(name_regex);
+
+          std::set<fs::path> matches;
+          if(fs::is_directory(dir)) {
+            for(fs::directory_iterator it(dir); it != fs::directory_iterator(); it++) {
+              fs::path match = it->path();
+              if((match.extension() == ".sigmf-data" || match.extension() == ".sigmf-meta") &&
+                 boost::regex_match(match.filename().string(), name_match)) {
+                matches.insert(to_data_path(match.string()));
+              }
+            }
+          }
+          if(matches.empty()) {
+            throw std::runtime_error("No recordings match " + filename);
+          }
+          paths.insert(paths.end(), matches.begin(), matches.end());
+        }
+        if(paths.empty()) {
+          throw std::runtime_error("No recordings to play");
+        }
+        return paths;
+      }
+    } // namespace
+
+    source::sptr
+    source::make(std::string filename, std::string type, bool repeat, bool stream_annotations)
+    {
+      return gnuradio::get_initial_sptr(
+        new source_impl(std::vector<fs::path>(1, to_data_path(filename)), type, repeat, stream_annotations));
+    }
+
     source::sptr
-    source::make(std::string filename, std::string type, bool repeat)
+    source::make_no_datatype(std::string filename, bool repeat, bool stream_annotations)
     {
-      return gnuradio::get_initial_sptr(new source_impl(filename, type, repeat));
+      return gnuradio::get_initial_sptr(
+        new source_impl(std::vector<fs::path>(1, to_data_path(filename)), "", repeat, stream_annotations));
     }
 
     source::sptr
-    source::make_no_datatype(std::string filename, bool repeat)
+    source::make_sequence(std::vector<std::string> filenames,
+                          std::string type,
+                          bool repeat,
+                          bool stream_annotations)
     {
-      return gnuradio::get_initial_sptr(new source_impl(filename, "", repeat));
+      return gnuradio::get_initial_sptr(
+        new source_impl(expand_recordings(filenames), type, repeat, stream_annotations));
     }
 
     /*
      * The private constructor
      */
-    source_impl::source_impl(std::string filename, std::string type, bool repeat)
+    source_impl::source_impl(std::vector<boost::filesystem::path> data_paths,
+                             std::string type,
+                             bool repeat,
+                             bool stream_annotations)
     : gr::sync_block("source",
                      gr::io_signature::make(0, 0, 0),
                      gr::io_signature::make(1, 1, sizeof(float))), // This get's overwritten below
       d_data_fp(0), d_meta_fp(0), d_repeat(repeat), d_file_begin(true),
-      d_add_begin_tag(pmt::PMT_NIL), d_repeat_count(0),
-      d_data_path(to_data_path(filename)), d_meta_path(meta_path_from_data(d_data_path))
+      d_stream_annotations(stream_annotations), d_add_begin_tag(pmt::PMT_NIL),
+      d_file_pos(0), d_tag_shift(0), d_have_pending_annotation(false), d_repeat_count(0),
+      d_paced(false), d_max_burst(4096), d_pace_rate(0), d_pace_anchored(false), d_samples_paced(0),
+      d_pace_bursts(0), d_pace_late_bursts(0), d_pace_resyncs(0), d_pace_error_sum(0),
+      d_pace_error_max(0), d_repeat_time_offset(0), d_loop_samples(0), d_loop_seconds(0),
+      d_data_paths(data_paths), d_file_index(0), d_prefetching(false),
+      d_next_tag(0), d_cache_items(0), d_cache_pos(0), d_preview_stride(1), d_preview_block(0),
+      d_preview_remaining(0), d_user_scale(false), d_scale(1), d_offset(0),
+      d_data_path(data_paths[0]), d_meta_path(meta_path_from_data(d_data_path)),
+      d_staging_size(0)
     {
 
       // command message port
@@ -78,35 +171,29 @@ namespace gr {
       load_metadata();
       std::string input_datatype = d_global.get_str("core:datatype");
       if (type == "") {
-        type = input_datatype;
+        // The file's type, but in native byte order
+        type = input_datatype.substr(0, input_datatype.find('_')) +
+               (endian::order::native == endian::order::little ? "_le" : "_be");
       }
+      d_output_type = type;
 
-      // Get the input datatype
-      format_detail_t input_detail = parse_format_str(input_datatype);
-
-      // and output datatype
+      // Get the output datatype
       format_detail_t output_detail = parse_format_str(type);
 
       // Need to divide by 8 to convert to bytes
       d_sample_size = (output_detail.width * (output_detail.is_complex ? 2 : 1)) / 8;
 
       d_num_samps_to_base = output_detail.is_complex ? 2 : 1;
-      d_base_size = output_detail.width / 8;
-      d_input_size = input_detail.width / 8;
 
-      std::fseek(d_data_fp, 0, SEEK_END);
-      d_num_samples_in_file = std::ftell(d_data_fp) / d_sample_size;
-
-      // GR_LOG_DEBUG(d_logger, "Samps in file: " << d_num_samples_in_file);
+      set_input_datatype(input_datatype);
 
-      std::fseek(d_data_fp, 0, SEEK_SET);
       set_output_signature(gr::io_signature::make(1, 1, d_sample_size));
 
-      d_convert_func = get_convert_function(input_datatype, type);
-
       std::stringstream ss;
       ss << name() << unique_id();
       d_id = pmt::string_to_symbol(ss.str());
+
+      start_prefetch();
     }
 
     /*
@@ -114,6 +201,125 @@ namespace gr {
      */
     source_impl::~source_impl()
     {
+      if(d_prefetching) {
+        d_prefetch_thread.join();
+      }
+      FILE *files[] = {d_data_fp, d_meta_fp, d_next.data_fp, d_next.meta_fp};
+      for(FILE *fp : files) {
+        if(fp != NULL) {
+          std::fclose(fp);
+        }
+      }
+    }
+
+    void
+    source_impl::set_input_datatype(const std::string &input_datatype)
+    {
+      format_detail_t input_detail = parse_format_str(input_datatype);
+      d_input_sample_size = input_detail.width * (input_detail.is_complex ? 2 : 1) / 8;
+
+      std::fseek(d_data_fp, 0, SEEK_END);
+      d_num_samples_in_file = std::ftell(d_data_fp) / d_input_sample_size;
+
+      // GR_LOG_DEBUG(d_logger, "Samps in file: " << d_num_samples_in_file);
+
+      std::fseek(d_data_fp, 0, SEEK_SET);
+
+      update_converter();
+    }
+
+    void
+    source_impl::start_prefetch()
+    {
+      size_t next_index = d_file_index + 1;
+      if(next_index == d_data_paths.size()) {
+        if(!d_repeat || d_data_paths.size() == 1) {
+          // Nothing to open, a single file repeats by seeking back to the start
+          return;
+        }
+        next_index = 0;
+      }
+      d_next.index = next_index;
+      d_next.error.clear();
+      d_prefetching = true;
+      d_prefetch_thread = gr::thread::thread([this, next_index]() { this->prefetch(next_index); });
+    }
+
+    void
+    source_impl::prefetch(size_t index)
+    {
+      // Runs on d_prefetch_thread, so only touches d_next
+      try {
+        fs::path data_path = d_data_paths[index];
+        d_next.data_fp = open_or_throw(data_path, "data");
+        d_next.meta_fp = open_or_throw(meta_path_from_data(data_path), "meta");
+        if(d_stream_annotations) {
+          d_next.stream.reset(
+            new annotation_stream(d_next.meta_fp, meta_path_from_data(data_path).string()));
+          d_next.ns.global = d_next.stream->global();
+          d_next.ns.captures = d_next.stream->captures();
+        } else {
+          load_metafile(d_next.meta_fp, d_next.ns.global, d_next.ns.captures, d_next.annotations);
+        }
+      } catch(const std::exception &e) {
+        std::stringstream s;
+        s << d_data_paths[index].string() << ": " << e.what();
+        d_next.error = s.str();
+      }
+    }
+
+    void
+    source_impl::switch_recording()
+    {
+      d_prefetch_thread.join();
+      d_prefetching = false;
+      if(!d_next.error.empty()) {
+        throw std::runtime_error(d_next.error);
+      }
+
+      std::fclose(d_data_fp);
+      std::fclose(d_meta_fp);
+      d_data_fp = d_next.data_fp;
+      d_meta_fp = d_next.meta_fp;
+      d_next.data_fp = NULL;
+      d_next.meta_fp = NULL;
+
+      d_file_index = d_next.index;
+      d_data_path = d_data_paths[d_file_index];
+      d_meta_path = meta_path_from_data(d_data_path);
+
+      d_global = d_next.ns.global;
+      d_captures = d_next.ns.captures;
+      d_annotations = std::move(d_next.annotations);
+      d_annotation_stream = std::move(d_next.stream);
+      d_have_pending_annotation = false;
+      d_next.ns = metafile_namespaces();
+      d_next.annotations.clear();
+
+      d_tags_to_output.clear();
+      build_tag_list();
+      set_input_datatype(d_global.get_str("core:datatype"));
+
+      // The next recording may have been made at another rate
+      bool paced;
+      {
+        gr::thread::scoped_lock guard(d_pacing_mutex);
+        paced = d_paced;
+      }
+      if(paced) {
+        double rate = sample_rate() / d_preview_stride;
+        gr::thread::scoped_lock guard(d_pacing_mutex);
+        if(d_pace_anchored && rate != d_pace_rate) {
+          // Samples already paced keep the time they took at the old rate
+          typedef std::chrono::steady_clock clock;
+          std::chrono::duration<double> shift(d_samples_paced / d_pace_rate -
+                                              d_samples_paced / rate);
+          d_pace_start += std::chrono::duration_cast<clock::duration>(shift);
+        }
+        d_pace_rate = rate;
+      }
+
+      start_prefetch();
     }
 
     void
@@ -143,49 +349,72 @@ namespace gr {
     }
 
 
+    uint64_t
+    source_impl::segment_to_tags(const meta_namespace &ns,
+                                 uint64_t shift_amount,
+                                 std::vector<tag_t> &tags)
+    {
+      uint64_t offset;
+      std::set<std::string> capture_keys = ns.keys();
+
+      if(ns.try_get(meta_key::SAMPLE_START, offset)) {
+        offset -= shift_amount;
+        // remove this key, we don't need it as a tag later
+        capture_keys.erase("core:sample_start");
+
+      } else {
+        throw std::runtime_error(
+          "Invalid metadata, no core:sample_start found for segment");
+      }
+      for(std::set<std::string>::iterator it = capture_keys.begin();
+          it != capture_keys.end(); it++) {
+        std::string key = *it;
+        tag_t tag;
+        tag.offset = offset;
+        if (key == "core:frequency") {
+          tag.key = FREQ_KEY;
+        } else if (key == "core:datetime") {
+          tag.key = TIME_KEY;
+        } else if (algo::starts_with(key, "unknown:")) {
+          tag.key = pmt::mp(key.substr(std::strlen("unknown:")));
+        } else {
+          tag.key = pmt::mp(key);
+        }
+        if (key == "core:datetime") {
+          std::string iso_string = pmt::symbol_to_string(ns.get(key));
+          posix::ptime parsed_time = reader_utils::iso_string_to_ptime(iso_string);
+          tag.value = reader_utils::ptime_to_uhd_time(parsed_time);
+        } else {
+          tag.value = ns.get(key);
+        }
+        tags.push_back(tag);
+      }
+      return offset;
+    }
+
     void
     source_impl::add_tags_from_meta_list(const std::vector<meta_namespace> &meta_list, uint64_t shift_amount)
     {
+      std::vector<tag_t> tags;
       for(std::vector<meta_namespace>::const_iterator it = meta_list.begin();
           it != meta_list.end(); it++) {
-        meta_namespace ns = *it;
-        uint64_t offset;
-        std::set<std::string> capture_keys = ns.keys();
-
-        if(capture_keys.count("core:sample_start")) {
-          offset = pmt::to_uint64(ns.get("core:sample_start"));
-          offset -= shift_amount;
-          // remove this key, we don't need it as a tag later
-          capture_keys.erase("core:sample_start");
-
-        } else {
-          throw std::runtime_error(
-            "Invalid metadata, no core:sample_start found for segment");
+        tags.clear();
+        segment_to_tags(*it, shift_amount, tags);
+        for(const tag_t &tag : tags) {
+          d_tags_to_output.insert({tag.offset, tag});
         }
-        for(std::set<std::string>::iterator it = capture_keys.begin();
-            it != capture_keys.end(); it++) {
-          std::string key = *it;
-          tag_t tag;
-          tag.offset = offset;
-          if (key == "core:frequency") {
-            tag.key = FREQ_KEY;
-          } else if (key == "core:datetime") {
-            tag.key = TIME_KEY;
-          } else if (algo::starts_with(key, "unknown:")) {
-            boost::regex unknown_regex("^unknown:");
-            std::string unknown_key = algo::erase_regex_copy(key, unknown_regex);
-            tag.key = pmt::mp(unknown_key);
-          } else {
-            tag.key = pmt::mp(key);
-          }
-          if (key == "core:datetime") {
-            std::string iso_string = pmt::symbol_to_string(ns.get(key));
-            posix::ptime parsed_time = reader_utils::iso_string_to_ptime(iso_string);
-            tag.value = reader_utils::ptime_to_uhd_time(parsed_time);
-          } else {
-            tag.value = ns.get(key);
-          }
-          d_tags_to_output.insert({offset, tag});
+      }
+    }
+
+    void
+    source_impl::add_tags_from_meta_list(const arena_segments &meta_list, uint64_t shift_amount)
+    {
+      std::vector<tag_t> tags;
+      for(const arena_segment &segment : meta_list) {
+        tags.clear();
+        segment_to_tags(segment.to_namespace(), shift_amount, tags);
+        for(const tag_t &tag : tags) {
+          d_tags_to_output.insert({tag.offset, tag});
         }
       }
     }
@@ -206,14 +435,15 @@ namespace gr {
       // Add known tags from the global object
       add_global_tags(d_global);
 
-      uint64_t offset = 0;
+      d_tag_shift = 0;
       if (d_captures.size() > 0) {
-        offset = pmt::to_uint64(d_captures[0].get("core:sample_start"));
+        d_tag_shift = d_captures[0].get_as<uint64_t>(meta_key::SAMPLE_START);
       }
 
-      // Add tags to the send queue from both captures and annotations
-      add_tags_from_meta_list(d_captures, offset);
-      add_tags_from_meta_list(d_annotations, offset);
+      // Add tags to the send queue from both captures and annotations.
+      // Streamed annotations are turned into tags as they are played instead.
+      add_tags_from_meta_list(d_captures, d_tag_shift);
+      add_tags_from_meta_list(d_annotations, d_tag_shift);
 
       GR_LOG_DEBUG(d_logger, "tags to output: ");
       for(auto it = d_tags_to_output.begin(); it != d_tags_to_output.end(); it++) {
@@ -224,15 +454,31 @@ namespace gr {
         // GR_LOG_DEBUG(d_logger, "offset = " << tag_to_output.offset << ", ");
       }
       GR_LOG_DEBUG(d_logger, "End of tags to output");
+
+      // Flatten to a vector in offset order, which is all playback needs
+      d_loop_tags.clear();
+      d_loop_tags.reserve(d_tags_to_output.size());
+      for(auto it = d_tags_to_output.begin(); it != d_tags_to_output.end(); it++) {
+        d_loop_tags.push_back(it->second);
+      }
+      d_tags_to_output.clear();
+      d_next_tag = 0;
     }
 
     void
     source_impl::load_metadata()
     {
-      metafile_namespaces ns = load_metafile(d_meta_fp);
-      d_global = ns.global;
-      d_captures = ns.captures;
-      d_annotations = ns.annotations;
+      if(d_stream_annotations) {
+        // Only global and captures are read now, annotations are
+        // read as playback reaches them
+        d_annotation_stream.reset(new annotation_stream(d_meta_fp, d_meta_path.string()));
+        d_global = d_annotation_stream->global();
+        d_captures = d_annotation_stream->captures();
+      } else {
+        d_captures.clear();
+        d_annotations.clear();
+        load_metafile(d_meta_fp, d_global, d_captures, d_annotations);
+      }
 
       build_tag_list();
     }
@@ -243,18 +489,8 @@ namespace gr {
       // hold mutex for duration of this function
       gr::thread::scoped_lock guard(d_open_mutex);
 
-      d_data_fp = fopen(d_data_path.c_str(), "r");
-      if(d_data_fp == NULL) {
-        std::stringstream s;
-        s << "failed to open data file, errno = " << errno << std::endl;
-        throw std::runtime_error(s.str());
-      }
-      d_meta_fp = fopen(d_meta_path.c_str(), "r");
-      if(d_meta_fp == NULL) {
-        std::stringstream s;
-        s << "failed to open meta file, errno = " << errno << std::endl;
-        throw std::runtime_error(s.str());
-      }
+      d_data_fp = open_or_throw(d_data_path, "data");
+      d_meta_fp = open_or_throw(d_meta_path, "meta");
 
       return true;
     }
@@ -265,6 +501,271 @@ namespace gr {
       d_add_begin_tag = tag;
     }
 
+    void
+    source_impl::set_preview(size_t stride, size_t block_size)
+    {
+      if(stride > 1 && block_size == 0) {
+        throw std::runtime_error("Preview block_size must be at least 1");
+      }
+      gr::thread::scoped_lock playback_guard(d_playback_mutex);
+      d_preview_stride = std::max<size_t>(stride, 1);
+      d_preview_block = block_size;
+      d_preview_remaining = block_size;
+
+      // Paced playback runs at the rate of the preview
+      gr::thread::scoped_lock guard(d_pacing_mutex);
+      if(d_paced) {
+        d_pace_rate = sample_rate() / d_preview_stride;
+        d_pace_anchored = false;
+      }
+    }
+
+    void
+    source_impl::preview_skip(uint64_t output_offset)
+    {
+      uint64_t skip = (d_preview_stride - 1) * d_preview_block;
+      uint64_t played = d_num_samples_in_file - std::min<uint64_t>(d_tag_shift, d_num_samples_in_file);
+      uint64_t remaining = played - std::min<uint64_t>(d_file_pos, played);
+      if(skip >= remaining) {
+        // Nothing left after the skipped blocks, so their tags would never play
+        skip = remaining;
+      } else {
+        // Tags in the skipped blocks go on the first sample after them
+        emit_tags(d_file_pos, skip, output_offset, true);
+      }
+
+      if(d_cache) {
+        d_cache_pos = std::min<size_t>(d_cache_pos + skip * d_num_samps_to_base, d_cache_items);
+      } else {
+        std::fseek(d_data_fp, skip * d_input_sample_size, SEEK_CUR);
+      }
+      d_file_pos += skip;
+      d_preview_remaining = d_preview_block;
+    }
+
+    bool
+    source_impl::set_repeat_cache(size_t max_bytes)
+    {
+      gr::thread::scoped_lock guard(d_playback_mutex);
+      return cache_recording(max_bytes);
+    }
+
+    bool
+    source_impl::cache_recording(size_t max_bytes)
+    {
+      uint64_t first_sample = 0;
+      if(d_captures.size() > 0) {
+        first_sample = d_captures[0].get_as<uint64_t>(meta_key::SAMPLE_START);
+      }
+      if(d_cache && !d_file_begin) {
+        // The file wasn't read while the cache played, so catch it up
+        std::fseek(d_data_fp, (first_sample + d_file_pos) * d_input_sample_size, SEEK_SET);
+      }
+      d_cache.reset();
+      d_cache_items = 0;
+      d_cache_pos = 0;
+      if(max_bytes == 0) {
+        return false;
+      }
+      if(d_data_paths.size() > 1) {
+        GR_LOG_WARN(d_logger, "Caching is not supported when playing a sequence of recordings");
+        return false;
+      }
+
+      if(first_sample >= d_num_samples_in_file) {
+        return false;
+      }
+      size_t num_items = (d_num_samples_in_file - first_sample) * d_num_samps_to_base;
+      size_t num_bytes = d_converter.output_bytes(num_items);
+      if(num_bytes > max_bytes) {
+        GR_LOG_INFO(d_logger,
+                    boost::format("Recording needs %d bytes converted, more than the cache limit "
+                                  "of %d, reading from file instead") % num_bytes % max_bytes);
+        return false;
+      }
+
+      char *buf = static_cast<char *>(volk_malloc(num_bytes, volk_get_alignment()));
+      if(buf == NULL) {
+        throw std::runtime_error("failed to allocate cache for recording");
+      }
+      d_cache.reset(buf);
+
+      // Convert the whole recording once, and leave the file where it was
+      long file_pos = std::ftell(d_data_fp);
+      std::fseek(d_data_fp, first_sample * d_input_sample_size, SEEK_SET);
+      while(d_cache_items < num_items) {
+        // In chunks, so the staging buffer stays small
+        size_t count = std::min<size_t>(num_items - d_cache_items, 65536);
+        size_t items_read = read_items(buf + d_converter.output_bytes(d_cache_items), count);
+        if(items_read == 0) {
+          break;
+        }
+        d_cache_items += items_read;
+      }
+      std::fseek(d_data_fp, file_pos, SEEK_SET);
+      // Carry on from wherever playback is
+      d_cache_pos = std::min<size_t>(d_file_pos * d_num_samps_to_base, d_cache_items);
+      return true;
+    }
+
+    void
+    source_impl::update_converter()
+    {
+      if(d_user_scale) {
+        d_converter = type_converter(
+          d_global.get_str("core:datatype"), d_output_type, d_scale, d_offset);
+      } else {
+        d_converter = make_recording_converter(d_global, d_output_type);
+      }
+    }
+
+    size_t
+    source_impl::read_items(char *buf, size_t count)
+    {
+      size_t num_bytes = d_converter.input_bytes(count);
+      if(d_converter.is_identity()) {
+        // Straight into the output, at most a byte swap is needed
+        size_t items_read =
+          d_converter.input_items(std::fread(buf, 1, num_bytes, d_data_fp));
+        d_converter.convert(buf, buf, items_read);
+        return items_read;
+      }
+
+      if(num_bytes > d_staging_size) {
+        d_staging.reset(static_cast<char *>(volk_malloc(num_bytes, volk_get_alignment())));
+        if(!d_staging) {
+          d_staging_size = 0;
+          throw std::runtime_error("failed to allocate staging buffer");
+        }
+        d_staging_size = num_bytes;
+      }
+      size_t items_read =
+        d_converter.input_items(std::fread(d_staging.get(), 1, num_bytes, d_data_fp));
+      d_converter.convert_in_place(buf, d_staging.get(), items_read);
+      return items_read;
+    }
+
+    void
+    source_impl::set_scale(double scale, double offset)
+    {
+      gr::thread::scoped_lock playback_guard(d_playback_mutex);
+      d_user_scale = true;
+      d_scale = scale;
+      d_offset = offset;
+      update_converter();
+      if(d_cache) {
+        // Convert again with the new scale
+        cache_recording(d_converter.output_bytes(d_cache_items));
+      }
+    }
+
+    double
+    source_impl::sample_rate()
+    {
+      pmt::pmt_t rate = d_global.get("core:sample_rate");
+      if(!pmt::is_number(rate) || pmt::to_double(rate) <= 0) {
+        throw std::runtime_error("Pacing requires a positive core:sample_rate in the metadata");
+      }
+      return pmt::to_double(rate);
+    }
+
+    void
+    source_impl::set_pacing(bool paced, int max_burst)
+    {
+      double rate = 0;
+      if(paced) {
+        rate = sample_rate() / d_preview_stride;
+        if(max_burst < 1) {
+          throw std::runtime_error("Pacing max_burst must be at least 1");
+        }
+      }
+      gr::thread::scoped_lock guard(d_pacing_mutex);
+      d_paced = paced;
+      d_pace_rate = rate;
+      d_max_burst = max_burst;
+      // start the clock again the next time work is called
+      d_pace_anchored = false;
+    }
+
+    pmt::pmt_t
+    source_impl::pacing_stats()
+    {
+      gr::thread::scoped_lock guard(d_pacing_mutex);
+      double mean_error = d_pace_bursts > 0 ? d_pace_error_sum / d_pace_bursts : 0;
+      pmt::pmt_t stats = pmt::make_dict();
+      stats = pmt::dict_add(stats, pmt::mp("samples"), pmt::from_uint64(d_samples_paced));
+      stats = pmt::dict_add(stats, pmt::mp("bursts"), pmt::from_uint64(d_pace_bursts));
+      stats = pmt::dict_add(stats, pmt::mp("late_bursts"), pmt::from_uint64(d_pace_late_bursts));
+      stats = pmt::dict_add(stats, pmt::mp("resyncs"), pmt::from_uint64(d_pace_resyncs));
+      stats = pmt::dict_add(stats, pmt::mp("mean_error"), pmt::from_double(mean_error));
+      stats = pmt::dict_add(stats, pmt::mp("max_error"), pmt::from_double(d_pace_error_max));
+      return stats;
+    }
+
+    bool
+    source_impl::stop()
+    {
+      gr::thread::scoped_lock guard(d_pacing_mutex);
+      if(d_pace_bursts > 0) {
+        GR_LOG_INFO(d_logger,
+                    boost::format("Paced %d samples in %d bursts, %d late, %d resyncs, "
+                                  "mean error %.1f us, max error %.1f us") %
+                      d_samples_paced % d_pace_bursts % d_pace_late_bursts % d_pace_resyncs %
+                      (1e6 * d_pace_error_sum / d_pace_bursts) % (1e6 * d_pace_error_max));
+      }
+      return true;
+    }
+
+    void
+    source_impl::pace(int nitems)
+    {
+      typedef std::chrono::steady_clock clock;
+      clock::time_point target;
+      clock::time_point now = clock::now();
+      {
+        gr::thread::scoped_lock guard(d_pacing_mutex);
+        if(!d_pace_anchored) {
+          d_pace_start = now;
+          d_samples_paced = 0;
+          d_pace_bursts = 0;
+          d_pace_late_bursts = 0;
+          d_pace_resyncs = 0;
+          d_pace_error_sum = 0;
+          d_pace_error_max = 0;
+          d_pace_anchored = true;
+        }
+        // Samples are released once the last one would have arrived
+        // at a real receiver
+        d_samples_paced += nitems;
+        std::chrono::duration<double> since_start(d_samples_paced / d_pace_rate);
+        target = d_pace_start + std::chrono::duration_cast<clock::duration>(since_start);
+
+        if(now - target > std::chrono::seconds(1)) {
+          // Too far behind to catch up, start the clock again from here
+          d_pace_start = now - std::chrono::duration_cast<clock::duration>(since_start);
+          d_pace_resyncs++;
+          target = now;
+        }
+      }
+
+      bool late = target <= now;
+      if(!late) {
+        // interruptible, so the flowgraph can still be stopped
+        auto wait = std::chrono::duration_cast<std::chrono::microseconds>(target - now);
+        boost::this_thread::sleep(boost::posix_time::microseconds(wait.count()));
+        now = clock::now();
+      }
+
+      gr::thread::scoped_lock guard(d_pacing_mutex);
+      double error = std::abs(std::chrono::duration<double>(now - target).count());
+      if(late) {
+        d_pace_late_bursts++;
+      }
+      d_pace_error_sum += error;
+      d_pace_error_max = std::max(d_pace_error_max, error);
+      d_pace_bursts++;
+    }
+
     gr::sigmf::meta_namespace &
     source_impl::global_meta()
     {
@@ -278,32 +779,93 @@ namespace gr {
     }
 
     void
-    source_impl::emit_tags(uint64_t start_offset_abs, int length) {
-      // how much window we have left to send out tags for
-      int window_remaining = length;
-      // where we are starting to get tags from
-      uint64_t start = start_offset_abs;
-      while(window_remaining > 0) {
-        // The lower bound for tags
-        uint64_t tag_start = start % d_num_samples_in_file;
-        // amount to adjust tag offsets by
-        uint64_t offset_adjust = start - tag_start;
-        // distance to the end of the file from where the current tags started
-        uint64_t distance_to_file_end = (d_num_samples_in_file - tag_start);
-        // the size of the chunk of the window that we are getting tags for
-        uint64_t window_chunk = std::min(distance_to_file_end, static_cast<uint64_t>(window_remaining));
-        // Upper bound for tags
-        uint64_t tag_end = tag_start + window_chunk;
-        auto start_it = d_tags_to_output.lower_bound(tag_start);
-        auto end_it = d_tags_to_output.upper_bound(tag_end);
-        for(auto it = start_it; it != end_it; it++) {
-          auto tag_to_output = it->second;
-          tag_to_output.offset = tag_to_output.offset + offset_adjust;
-          add_item_tag(0, tag_to_output);
-        }
-        window_remaining -= window_chunk;
-        start += window_chunk;
+    source_impl::emit_tags(uint64_t file_pos, uint64_t length, uint64_t output_offset, bool collapse)
+    {
+      // Tags for samples [file_pos, file_pos + length) of the file, which
+      // were written starting at output_offset, or were skipped and all
+      // land on output_offset if collapse is set. Playback only moves
+      // forward through a loop, so carry on from where the last call stopped.
+      uint64_t window_end = file_pos + length;
+      while(d_next_tag < d_loop_tags.size() && d_loop_tags[d_next_tag].offset < window_end) {
+        tag_t tag_to_output = d_loop_tags[d_next_tag++];
+        if(tag_to_output.offset < file_pos) {
+          continue;
+        }
+        tag_to_output.offset = collapse ? output_offset : output_offset + (tag_to_output.offset - file_pos);
+        output_tag(tag_to_output);
+      }
+
+      if(d_annotation_stream) {
+        emit_streamed_tags(file_pos, length, output_offset, collapse);
+      }
+    }
+
+    void
+    source_impl::emit_streamed_tags(uint64_t file_pos,
+                                    uint64_t length,
+                                    uint64_t output_offset,
+                                    bool collapse)
+    {
+      std::vector<tag_t> tags;
+      uint64_t window_end = file_pos + length;
+      while(true) {
+        if(!d_have_pending_annotation) {
+          if(!d_annotation_stream->next(d_pending_annotation)) {
+            // No more annotations until the next repeat
+            break;
+          }
+          d_have_pending_annotation = true;
+        }
+
+        uint64_t start;
+        if(d_pending_annotation.try_get(meta_key::SAMPLE_START, start) &&
+           start < d_tag_shift) {
+          // Before the first capture, so it will never be played
+          d_have_pending_annotation = false;
+          continue;
+        }
+
+        tags.clear();
+        uint64_t anno_offset = segment_to_tags(d_pending_annotation, d_tag_shift, tags);
+        if(anno_offset >= window_end) {
+          // Hold on to it until playback gets there
+          break;
+        }
+        d_have_pending_annotation = false;
+
+        if(anno_offset < file_pos) {
+          GR_LOG_WARN(d_logger,
+                      boost::format("Dropping annotation at sample %d, annotations must be sorted "
+                                    "by core:sample_start when streaming") % anno_offset);
+          continue;
+        }
+        for(tag_t &tag : tags) {
+          tag.offset = collapse ? output_offset : output_offset + (tag.offset - file_pos);
+          output_tag(tag);
+        }
+      }
+    }
+
+    void
+    source_impl::output_tag(tag_t tag)
+    {
+      if(d_preview_stride > 1 && pmt::eqv(tag.key, RATE_KEY) && pmt::is_number(tag.value)) {
+        tag.value = pmt::from_double(pmt::to_double(tag.value) / d_preview_stride);
       }
+      if(d_repeat_time_offset > 0 && pmt::eqv(tag.key, TIME_KEY) && pmt::is_tuple(tag.value)) {
+        // Move time forward by however long the previous repeats took to play
+        double whole_seconds = std::floor(d_repeat_time_offset);
+        uint64_t seconds = pmt::to_uint64(pmt::tuple_ref(tag.value, 0));
+        double frac = pmt::to_double(pmt::tuple_ref(tag.value, 1));
+        seconds += static_cast<uint64_t>(whole_seconds);
+        frac += d_repeat_time_offset - whole_seconds;
+        if(frac >= 1.0) {
+          seconds += 1;
+          frac -= 1.0;
+        }
+        tag.value = pmt::make_tuple(pmt::from_uint64(seconds), pmt::from_double(frac));
+      }
+      add_item_tag(0, tag);
     }
 
     int
@@ -318,37 +880,94 @@ namespace gr {
       // This is in base units
       int base_size = size * d_num_samps_to_base;
 
-      uint64_t start_offset_abs = nitems_written(0);
+      // Snapshot the pacing settings, they can be changed from another thread
+      int max_burst = 0;
+      double pace_rate = 0;
+      {
+        gr::thread::scoped_lock guard(d_pacing_mutex);
+        if(d_paced) {
+          max_burst = d_max_burst;
+          pace_rate = d_pace_rate;
+        }
+      }
+      if(max_burst > 0) {
+        noutput_items = std::min(noutput_items, max_burst);
+        size = noutput_items;
+        base_size = size * d_num_samps_to_base;
+        pace(noutput_items);
+      }
+
+      // The settings below can be changed from another thread too
+      gr::thread::scoped_lock playback_guard(d_playback_mutex);
 
-      emit_tags(start_offset_abs, size);
+      uint64_t start_offset_abs = nitems_written(0);
 
       while(base_size > 0) {
+        // Where the next chunk lands in the output stream
+        uint64_t chunk_offset_abs =
+          start_offset_abs + noutput_items - (base_size / d_num_samps_to_base);
 
         // Add stream tag whenever the file starts again
         if(d_file_begin) {
           if(d_add_begin_tag != pmt::PMT_NIL) {
-            add_item_tag(0, start_offset_abs + noutput_items - (base_size / d_num_samps_to_base),
+            add_item_tag(0, chunk_offset_abs,
                          d_add_begin_tag, pmt::from_long(d_repeat_count), d_id);
           }
           pmt::pmt_t msg = d_global.get();
           message_port_pub(META, msg);
           // Check if the first capture segment starts at 0 or not
           // NOTE: this may change if the sigmf spec changes
-          pmt::pmt_t first_capture_start_position = d_captures[0].get("core:sample_start");
-          uint64_t offset_samples = pmt::to_uint64(first_capture_start_position);
-          uint64_t offset_bytes = offset_samples * d_sample_size;
+          uint64_t offset_samples = 0;
+          if(d_captures.size() > 0) {
+            offset_samples = d_captures[0].get_as<uint64_t>(meta_key::SAMPLE_START);
+          }
+          uint64_t offset_bytes = offset_samples * d_input_sample_size;
           // If we ever do this when d_data_fp isn't at 0, something is wrong
           assert(std::ftell(d_data_fp) == 0);
           std::fseek(d_data_fp, offset_bytes, SEEK_SET);
+          d_file_pos = 0;
+          d_next_tag = 0;
+          d_cache_pos = 0;
+          d_preview_remaining = d_preview_block;
+          if(d_annotation_stream) {
+            d_annotation_stream->rewind();
+            d_have_pending_annotation = false;
+          }
           d_file_begin = false;
         }
 
+        // In preview mode only one block out of every d_preview_stride is read
+        size_t to_read = base_size;
+        if(d_preview_stride > 1) {
+          if(d_preview_remaining == 0) {
+            preview_skip(chunk_offset_abs);
+          }
+          to_read = std::min<size_t>(to_read, d_preview_remaining * d_num_samps_to_base);
+        }
+
         // Read as many items as possible
-        items_read = d_convert_func(output_buf, d_input_size, base_size, d_data_fp);
+        if(d_cache) {
+          items_read = std::min<size_t>(to_read, d_cache_items - d_cache_pos);
+          std::memcpy(output_buf,
+                      d_cache.get() + d_converter.output_bytes(d_cache_pos),
+                      d_converter.output_bytes(items_read));
+          d_cache_pos += items_read;
+        } else {
+          items_read = read_items(output_buf, to_read);
+        }
         base_size -= items_read;
 
         // advance output pointer
-        output_buf += items_read * d_base_size;
+        output_buf += d_converter.output_bytes(items_read);
+
+        // Tag the samples we just read
+        uint64_t samples_read = items_read / d_num_samps_to_base;
+        emit_tags(d_file_pos, samples_read, chunk_offset_abs);
+        d_file_pos += samples_read;
+        d_loop_samples += samples_read;
+        if(d_preview_stride > 1) {
+          d_preview_remaining -= std::min<uint64_t>(samples_read, d_preview_remaining);
+        }
 
         if(base_size == 0) {
           break;
@@ -359,14 +978,37 @@ namespace gr {
           continue;
         }
 
-        if(!d_repeat) {
+        // Carry on with the next recording if there is one
+        bool wrapped;
+        if(d_prefetching) {
+          wrapped = d_next.index == 0;
+          // Time the recording took at its own rate, the next may differ
+          if(pace_rate > 0) {
+            d_loop_seconds += d_loop_samples / pace_rate;
+          }
+          d_loop_samples = 0;
+          switch_recording();
+          gr::thread::scoped_lock guard(d_pacing_mutex);
+          if(d_paced) {
+            pace_rate = d_pace_rate;
+          }
+        } else if(d_repeat) {
+          wrapped = true;
+          if(std::fseek((FILE *)d_data_fp, 0, SEEK_SET) == -1) {
+            std::fprintf(stderr, "[%s] fseek failed\n", __FILE__);
+          }
+        } else {
           break;
         }
 
-        if(std::fseek((FILE *)d_data_fp, 0, SEEK_SET) == -1) {
-          std::fprintf(stderr, "[%s] fseek failed\n", __FILE__);
+        if(wrapped) {
+          d_repeat_count++;
+          if(pace_rate > 0) {
+            d_repeat_time_offset += d_loop_seconds + d_loop_samples / pace_rate;
+          }
+          d_loop_seconds = 0;
+          d_loop_samples = 0;
         }
-        d_repeat_count++;
         d_file_begin = true;
       }
 
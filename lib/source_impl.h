@@ -21,10 +21,16 @@
 #ifndef INCLUDED_SIGMF_SOURCE_IMPL_H
 #define INCLUDED_SIGMF_SOURCE_IMPL_H
 
+#include <chrono>
 #include <cstdio>
+#include <memory>
+#include <gnuradio/thread/thread.h>
+#include <volk/volk.h>
+#include <sigmf/meta_arena.h>
 #include <sigmf/meta_namespace.h>
 #include <sigmf/source.h>
-#include "type_converter.h"
+#include "annotation_stream.h"
+#include <sigmf/type_converter.h>
 
 namespace gr {
   namespace sigmf {
@@ -35,59 +41,179 @@ namespace gr {
 
     class source_impl : public source {
       private:
+      /*
+       * The next recording in a sequence, opened and with its metadata
+       * parsed by the prefetch thread while the current one plays
+       */
+      struct prefetched_recording {
+        prefetched_recording() : index(0), data_fp(NULL), meta_fp(NULL) {}
+        size_t index;
+        FILE *data_fp;
+        FILE *meta_fp;
+        metafile_namespaces ns;
+        // ns.annotations isn't used, they go here instead
+        arena_segments annotations;
+        std::unique_ptr<annotation_stream> stream;
+        // set if the recording couldn't be opened
+        std::string error;
+      };
+
       FILE *d_data_fp;
       FILE *d_meta_fp;
 
       // size of a sample
       size_t d_sample_size;
 
-      // base size of a data, might be item_size / 2
-      size_t d_base_size;
-      size_t d_input_size;
+      // size of a sample in the data file
+      size_t d_input_sample_size;
+
       int d_num_samps_to_base;
 
       bool d_repeat;
       bool d_file_begin;
+      bool d_stream_annotations;
 
       pmt::pmt_t d_add_begin_tag;
       pmt::pmt_t d_id;
 
-      // A multimap of tags to output that maps from tag index to tag
+      // A multimap of tags to output that maps from tag index to tag,
+      // only used while building d_loop_tags
       std::multimap<uint64_t, tag_t> d_tags_to_output;
       size_t d_num_samples_in_file;
 
+      // Position in the file, in samples from the start of the first capture
+      uint64_t d_file_pos;
+
+      // sample_start of the first capture, tag offsets are relative to this
+      uint64_t d_tag_shift;
+
+      // Only used when annotations are streamed, holds the next annotation
+      // that has been read from the file but not yet played
+      std::unique_ptr<annotation_stream> d_annotation_stream;
+      meta_namespace d_pending_annotation;
+      bool d_have_pending_annotation;
+
       uint64_t d_repeat_count;
 
+      // Paced playback, see set_pacing
+      bool d_paced;
+      int d_max_burst;
+      double d_pace_rate;
+      bool d_pace_anchored;
+      std::chrono::steady_clock::time_point d_pace_start;
+      uint64_t d_samples_paced;
+      uint64_t d_pace_bursts;
+      uint64_t d_pace_late_bursts;
+      uint64_t d_pace_resyncs;
+      // release errors in seconds
+      double d_pace_error_sum;
+      double d_pace_error_max;
+      gr::thread::mutex d_pacing_mutex;
+
+      // seconds to add to rx_time tags, so time moves forward on repeats
+      double d_repeat_time_offset;
+      // samples played since the current recording started, and seconds
+      // played of earlier recordings since the first one last started
+      uint64_t d_loop_samples;
+      double d_loop_seconds;
+
+      // Recordings to play in order, and which one is playing
+      std::vector<boost::filesystem::path> d_data_paths;
+      size_t d_file_index;
+      std::string d_output_type;
+
+      prefetched_recording d_next;
+      gr::thread::thread d_prefetch_thread;
+      bool d_prefetching;
+
+      // Tags for one loop through the file sorted by offset, and the
+      // next one to play
+      std::vector<tag_t> d_loop_tags;
+      size_t d_next_tag;
+
+      // The recording converted to the output type, see set_repeat_cache
+      std::unique_ptr<char, volk_deleter> d_cache;
+      // in base units
+      size_t d_cache_items;
+      size_t d_cache_pos;
+
+      // Preview mode, see set_preview. In samples.
+      size_t d_preview_stride;
+      size_t d_preview_block;
+      size_t d_preview_remaining;
+
+      // Set by set_scale, otherwise the recording's scale may be used
+      bool d_user_scale;
+      double d_scale;
+      double d_offset;
+
       boost::mutex d_open_mutex;
+      // Held by work() while it reads, and by the setters that change
+      // how it reads, so they can be called while the flowgraph runs
+      gr::thread::mutex d_playback_mutex;
 
       boost::filesystem::path d_data_path;
       boost::filesystem::path d_meta_path;
 
-      convert_function_t d_convert_func;
+      type_converter d_converter;
+      // Raw items are read into this before they are converted. Only
+      // grows, so it is allocated once for a steady work() size.
+      std::unique_ptr<char, volk_deleter> d_staging;
+      size_t d_staging_size;
 
       meta_namespace d_global;
       std::vector<meta_namespace> d_captures;
-      std::vector<meta_namespace> d_annotations;
+      // Kept in one arena, so a recording with many annotations is
+      // freed quickly
+      arena_segments d_annotations;
 
       boost::posix_time::ptime iso_string_to_ptime(const std::string &str);
 
       void on_command_message(pmt::pmt_t msg);
 
       bool open();
+      void set_input_datatype(const std::string &input_datatype);
+      void update_converter();
+      bool cache_recording(size_t max_bytes);
+      size_t read_items(char *buf, size_t count);
+      void start_prefetch();
+      void prefetch(size_t index);
+      void switch_recording();
       void load_metadata();
       void build_tag_list();
       void add_global_tags(const meta_namespace &global_segment);
+      uint64_t segment_to_tags(const meta_namespace &ns, uint64_t shift_amount, std::vector<tag_t> &tags);
       void add_tags_from_meta_list(const std::vector<meta_namespace> &meta_list, uint64_t shift_amount);
-      void emit_tags(uint64_t window_start, int window_length);
+      void add_tags_from_meta_list(const arena_segments &meta_list, uint64_t shift_amount);
+      void emit_tags(uint64_t file_pos, uint64_t length, uint64_t output_offset, bool collapse = false);
+      void emit_streamed_tags(uint64_t file_pos,
+                              uint64_t length,
+                              uint64_t output_offset,
+                              bool collapse);
+      void preview_skip(uint64_t output_offset);
+      void output_tag(tag_t tag);
+      void pace(int nitems);
+      double sample_rate();
 
       public:
-      source_impl(std::string filename, std::string type, bool repeat);
+      source_impl(std::vector<boost::filesystem::path> data_paths,
+                  std::string type,
+                  bool repeat,
+                  bool stream_annotations);
       ~source_impl();
 
       // Where all the action really happens
       int work(int noutput_items, gr_vector_const_void_star &input_items, gr_vector_void_star &output_items);
 
       void set_begin_tag(pmt::pmt_t tag);
+      bool set_repeat_cache(size_t max_bytes);
+      void set_preview(size_t stride, size_t block_size);
+      void set_scale(double scale, double offset);
+
+      void set_pacing(bool paced, int max_burst);
+      pmt::pmt_t pacing_stats();
+
+      bool stop();
 
       gr::sigmf::meta_namespace &global_meta();
       std::vector<gr::sigmf::meta_namespace> &capture_segments();
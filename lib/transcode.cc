@@ -0,0 +1,299 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <boost/endian/conversion.hpp>
+#include <boost/filesystem.hpp>
+#include <gnuradio/thread/thread.h>
+#include <sigmf/meta_namespace.h>
+#include <sigmf/sigmf_utils.h>
+#include <sigmf/transcode.h>
+#include <sigmf/type_converter.h>
+#include "writer_utils.h"
+
+namespace fs = boost::filesystem;
+namespace endian = boost::endian;
+
+namespace gr {
+  namespace sigmf {
+
+    namespace {
+      FILE *
+      open_or_throw(const fs::path &path, const char *mode)
+      {
+        FILE *fp = std::fopen(path.c_str(), mode);
+        if(fp == NULL) {
+          throw std::runtime_error("Unable to open " + path.string());
+        }
+        return fp;
+      }
+
+      struct file_closer {
+        void
+        operator()(FILE *fp) const
+        {
+          std::fclose(fp);
+        }
+      };
+      typedef std::unique_ptr<FILE, file_closer> file_ptr;
+
+      struct converted_chunk {
+        std::unique_ptr<char, volk_deleter> data;
+        size_t bytes;
+      };
+
+      /*
+       * Workers take chunks in order, convert them and hand them to the
+       * writer, which writes them in order. Workers don't get more than
+       * max_pending chunks ahead of the writer, which bounds memory.
+       */
+      class transcode_job {
+        public:
+        transcode_job(const fs::path &input_path,
+                      const meta_namespace &global,
+                      const std::string &output_type,
+                      uint64_t num_samples,
+                      size_t chunk_samples,
+                      size_t max_pending)
+        : d_input_path(input_path), d_global(global), d_output_type(output_type),
+          d_num_samples(num_samples), d_chunk_samples(chunk_samples),
+          d_num_chunks((num_samples + chunk_samples - 1) / chunk_samples),
+          d_max_pending(max_pending), d_next_chunk(0), d_next_write(0), d_abort(false)
+        {
+          format_detail_t detail = parse_format_str(global.get_str("core:datatype"));
+          d_items_per_sample = detail.is_complex ? 2 : 1;
+          d_input_sample_size = detail.width * d_items_per_sample / 8;
+        }
+
+        void
+        work()
+        {
+          try {
+            convert_chunks();
+          } catch(...) {
+            gr::thread::scoped_lock lock(d_mutex);
+            if(!d_error) {
+              d_error = std::current_exception();
+            }
+            d_abort = true;
+            d_cond.notify_all();
+          }
+        }
+
+        void
+        write(FILE *out_fp)
+        {
+          for(size_t index = 0; index < d_num_chunks; index++) {
+            converted_chunk chunk;
+            {
+              gr::thread::scoped_lock lock(d_mutex);
+              while(!d_abort && d_done.count(index) == 0) {
+                d_cond.wait(lock);
+              }
+              if(d_abort) {
+                return;
+              }
+              chunk = std::move(d_done[index]);
+              d_done.erase(index);
+            }
+            if(std::fwrite(chunk.data.get(), 1, chunk.bytes, out_fp) != chunk.bytes) {
+              abort(std::make_exception_ptr(
+                std::runtime_error("Error writing converted data")));
+              return;
+            }
+            gr::thread::scoped_lock lock(d_mutex);
+            d_next_write++;
+            d_cond.notify_all();
+          }
+        }
+
+        void
+        abort(std::exception_ptr error)
+        {
+          gr::thread::scoped_lock lock(d_mutex);
+          if(!d_error) {
+            d_error = error;
+          }
+          d_abort = true;
+          d_cond.notify_all();
+        }
+
+        //! rethrows the first error from any thread
+        void
+        check()
+        {
+          if(d_error) {
+            std::rethrow_exception(d_error);
+          }
+        }
+
+        private:
+        fs::path d_input_path;
+        meta_namespace d_global;
+        std::string d_output_type;
+        uint64_t d_num_samples;
+        size_t d_chunk_samples;
+        size_t d_num_chunks;
+        size_t d_max_pending;
+        size_t d_items_per_sample;
+        size_t d_input_sample_size;
+
+        gr::thread::mutex d_mutex;
+        gr::thread::condition_variable d_cond;
+        size_t d_next_chunk;
+        size_t d_next_write;
+        std::map<size_t, converted_chunk> d_done;
+        bool d_abort;
+        std::exception_ptr d_error;
+
+        void
+        convert_chunks()
+        {
+          // Each thread has its own file position, converter and staging buffer
+          file_ptr in_fp(open_or_throw(d_input_path, "rb"));
+          type_converter converter = make_recording_converter(d_global, d_output_type);
+          size_t max_items = d_chunk_samples * d_items_per_sample;
+          std::unique_ptr<char, volk_deleter> staging(static_cast<char *>(
+            volk_malloc(converter.input_bytes(max_items), volk_get_alignment())));
+          if(!staging) {
+            throw std::runtime_error("failed to allocate staging buffer");
+          }
+
+          while(true) {
+            size_t index;
+            {
+              gr::thread::scoped_lock lock(d_mutex);
+              while(!d_abort && d_next_chunk < d_num_chunks &&
+                    d_next_chunk >= d_next_write + d_max_pending) {
+                d_cond.wait(lock);
+              }
+              if(d_abort || d_next_chunk == d_num_chunks) {
+                return;
+              }
+              index = d_next_chunk++;
+            }
+
+            uint64_t first_sample = static_cast<uint64_t>(index) * d_chunk_samples;
+            size_t samples = std::min<uint64_t>(d_chunk_samples, d_num_samples - first_sample);
+            size_t items = samples * d_items_per_sample;
+            size_t in_bytes = samples * d_input_sample_size;
+            if(std::fseek(in_fp.get(), first_sample * d_input_sample_size, SEEK_SET) != 0 ||
+               std::fread(staging.get(), 1, in_bytes, in_fp.get()) != in_bytes) {
+              throw std::runtime_error("Error reading " + d_input_path.string());
+            }
+
+            converted_chunk chunk;
+            chunk.bytes = converter.output_bytes(items);
+            chunk.data.reset(
+              static_cast<char *>(volk_malloc(chunk.bytes, volk_get_alignment())));
+            if(!chunk.data) {
+              throw std::runtime_error("failed to allocate conversion buffer");
+            }
+            converter.convert_in_place(chunk.data.get(), staging.get(), items);
+
+            gr::thread::scoped_lock lock(d_mutex);
+            d_done[index] = std::move(chunk);
+            d_cond.notify_all();
+          }
+        }
+      };
+    } // namespace
+
+    uint64_t
+    transcode(const std::string &input_filename,
+              const std::string &output_filename,
+              const std::string &output_type,
+              size_t num_threads,
+              size_t chunk_samples)
+    {
+      if(chunk_samples == 0) {
+        throw std::runtime_error("chunk_samples must be greater than 0");
+      }
+      if(num_threads == 0) {
+        num_threads = std::max(1u, gr::thread::thread::hardware_concurrency());
+      }
+
+      fs::path input_data_path = to_data_path(input_filename);
+      fs::path output_data_path = to_data_path(output_filename);
+      if(fs::exists(output_data_path) && fs::equivalent(input_data_path, output_data_path)) {
+        throw std::runtime_error("Can't transcode a recording onto itself");
+      }
+
+      metafile_namespaces ns;
+      {
+        file_ptr meta_fp(open_or_throw(meta_path_from_data(input_data_path), "r"));
+        ns = load_metafile(meta_fp.get());
+      }
+
+      // Record the byte order explicitly, like the sink does
+      format_detail_t output_detail = parse_format_str(output_type);
+      std::string output_datatype = output_type;
+      if(output_type.find('_') == std::string::npos && output_detail.width > 8) {
+        output_datatype += endian::order::native == endian::order::little ? "_le" : "_be";
+      }
+
+      format_detail_t input_detail = parse_format_str(ns.global.get_str("core:datatype"));
+      size_t input_sample_size =
+        input_detail.width * (input_detail.is_complex ? 2 : 1) / 8;
+      uint64_t num_samples = fs::file_size(input_data_path) / input_sample_size;
+
+      transcode_job job(input_data_path,
+                        ns.global,
+                        output_datatype,
+                        num_samples,
+                        chunk_samples,
+                        num_threads * 2);
+
+      file_ptr out_fp(open_or_throw(output_data_path, "wb"));
+      std::vector<gr::thread::thread> threads;
+      for(size_t i = 0; i < num_threads; i++) {
+        threads.emplace_back([&job]() { job.work(); });
+      }
+      job.write(out_fp.get());
+      for(gr::thread::thread &t : threads) {
+        t.join();
+      }
+      job.check();
+      if(std::fflush(out_fp.get()) != 0) {
+        throw std::runtime_error("Error writing " + output_data_path.string());
+      }
+
+      meta_namespace global = ns.global;
+      if(applies_recording_scale(global, output_datatype)) {
+        // The samples are in physical units now
+        global.del(SCALE_META_KEY);
+        global.del(OFFSET_META_KEY);
+      }
+      global.set("core:datatype", output_datatype);
+      global.del("core:sha512");
+      file_ptr out_meta_fp(open_or_throw(meta_path_from_data(output_data_path), "w"));
+      writer_utils::write_meta_to_fp(out_meta_fp.get(), global, ns.captures, ns.annotations);
+
+      return num_samples;
+    }
+
+  } // namespace sigmf
+} // namespace gr
@@ -0,0 +1,859 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Scott Torborg, Paul Wicks, Caitlin Miller
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <sigmf/type_converter.h>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <boost/endian/conversion.hpp>
+#include "pmt_utils.h"
+#include "simd_kernels.h"
+
+namespace endian = boost::endian;
+
+namespace gr {
+  namespace sigmf {
+
+    namespace {
+      const float MAX_INT = 2147483647;  //  (2^31)-1
+      const float MAX_SHORT = 32767;     //  (2^15)-1
+      const float MAX_CHAR = 127;        //  (2^7)-1
+
+      /*
+       * C type and properties of each sample type
+       */
+      template <sample_type_t T>
+      struct sample_traits;
+
+#define SIGMF_SAMPLE_TRAITS(TYPE_ID, C_TYPE, SIGNED_ID)                                  \
+  template <>                                                                           \
+  struct sample_traits<TYPE_ID> {                                                       \
+    typedef C_TYPE type;                                                                \
+    static constexpr sample_type_t signed_type = SIGNED_ID;                             \
+    static constexpr size_t flip_size = std::is_unsigned<C_TYPE>::value ? sizeof(C_TYPE) : 0; \
+  };
+
+      SIGMF_SAMPLE_TRAITS(TYPE_F32, float, TYPE_F32)
+      SIGMF_SAMPLE_TRAITS(TYPE_F64, double, TYPE_F64)
+      SIGMF_SAMPLE_TRAITS(TYPE_I8, int8_t, TYPE_I8)
+      SIGMF_SAMPLE_TRAITS(TYPE_I16, int16_t, TYPE_I16)
+      SIGMF_SAMPLE_TRAITS(TYPE_I32, int32_t, TYPE_I32)
+      SIGMF_SAMPLE_TRAITS(TYPE_I64, int64_t, TYPE_I64)
+      SIGMF_SAMPLE_TRAITS(TYPE_U8, uint8_t, TYPE_I8)
+      SIGMF_SAMPLE_TRAITS(TYPE_U16, uint16_t, TYPE_I16)
+      SIGMF_SAMPLE_TRAITS(TYPE_U32, uint32_t, TYPE_I32)
+      SIGMF_SAMPLE_TRAITS(TYPE_U64, uint64_t, TYPE_I64)
+
+#undef SIGMF_SAMPLE_TRAITS
+
+      /*
+       * Generic conversions between C types. Integers are cast between
+       * each other, scaled by their max value when going to float, and
+       * floats are rounded and saturated when going to integer.
+       */
+      template <typename in_t,
+                typename out_t,
+                bool in_float = std::is_floating_point<in_t>::value,
+                bool out_float = std::is_floating_point<out_t>::value>
+      struct convert_items {
+        // float to float
+        static void
+        run(out_t *out, const in_t *in, size_t count)
+        {
+          for(size_t i = 0; i < count; i++) {
+            out[i] = static_cast<out_t>(in[i]);
+          }
+        }
+      };
+
+      template <typename in_t, typename out_t>
+      struct convert_items<in_t, out_t, false, false> {
+        static void
+        run(out_t *out, const in_t *in, size_t count)
+        {
+          for(size_t i = 0; i < count; i++) {
+            out[i] = static_cast<out_t>(in[i]);
+          }
+        }
+      };
+
+      template <typename in_t, typename out_t>
+      struct convert_items<in_t, out_t, false, true> {
+        static void
+        run(out_t *out, const in_t *in, size_t count)
+        {
+          const double scale = 1.0 / static_cast<double>(std::numeric_limits<in_t>::max());
+          for(size_t i = 0; i < count; i++) {
+            out[i] = static_cast<out_t>(in[i] * scale);
+          }
+        }
+      };
+
+      template <typename in_t, typename out_t>
+      struct convert_items<in_t, out_t, true, false> {
+        // Saturates like the SIMD kernels, and NaN gives the lowest value
+        static void
+        run(out_t *out, const in_t *in, size_t count)
+        {
+          const out_t lo = std::numeric_limits<out_t>::lowest();
+          const out_t hi = std::numeric_limits<out_t>::max();
+          for(size_t i = 0; i < count; i++) {
+            double r = std::nearbyint(static_cast<double>(in[i]));
+            if(std::isnan(r) || r <= lo) {
+              out[i] = lo;
+            } else if(r >= hi) {
+              out[i] = hi;
+            } else {
+              out[i] = static_cast<out_t>(r);
+            }
+          }
+        }
+      };
+
+      /*
+       * The kernel for a pair of signed types. Pairs that VOLK has a kernel
+       * for are specialized below, and so are the common pairs it doesn't
+       * cover, which use our own runtime dispatched SIMD kernels.
+       */
+      template <sample_type_t from, sample_type_t to>
+      struct kernel {
+        typedef typename sample_traits<from>::type in_t;
+        typedef typename sample_traits<to>::type out_t;
+
+        static void
+        run(char *out, const char *in, size_t count)
+        {
+          if(from == to) {
+            std::memcpy(out, in, count * sizeof(in_t));
+          } else {
+            convert_items<in_t, out_t>::run(
+              reinterpret_cast<out_t *>(out), reinterpret_cast<const in_t *>(in), count);
+          }
+        }
+      };
+
+      template <>
+      void
+      kernel<TYPE_F32, TYPE_I16>::run(char *out, const char *in, size_t count)
+      {
+        volk_32f_s32f_convert_16i(
+          reinterpret_cast<int16_t *>(out), reinterpret_cast<const float *>(in), 1, count);
+      }
+
+      template <>
+      void
+      kernel<TYPE_F32, TYPE_I8>::run(char *out, const char *in, size_t count)
+      {
+        volk_32f_s32f_convert_8i(
+          reinterpret_cast<int8_t *>(out), reinterpret_cast<const float *>(in), 1, count);
+      }
+
+      template <>
+      void
+      kernel<TYPE_I32, TYPE_F32>::run(char *out, const char *in, size_t count)
+      {
+        volk_32i_s32f_convert_32f(
+          reinterpret_cast<float *>(out), reinterpret_cast<const int32_t *>(in), MAX_INT, count);
+      }
+
+      template <>
+      void
+      kernel<TYPE_I16, TYPE_F32>::run(char *out, const char *in, size_t count)
+      {
+        volk_16i_s32f_convert_32f(
+          reinterpret_cast<float *>(out), reinterpret_cast<const int16_t *>(in), MAX_SHORT, count);
+      }
+
+      template <>
+      void
+      kernel<TYPE_I8, TYPE_F32>::run(char *out, const char *in, size_t count)
+      {
+        volk_8i_s32f_convert_32f(
+          reinterpret_cast<float *>(out), reinterpret_cast<const int8_t *>(in), MAX_CHAR, count);
+      }
+
+      template <>
+      void
+      kernel<TYPE_I16, TYPE_I8>::run(char *out, const char *in, size_t count)
+      {
+        volk_16i_convert_8i(
+          reinterpret_cast<int8_t *>(out), reinterpret_cast<const int16_t *>(in), count);
+      }
+
+      template <>
+      void
+      kernel<TYPE_I8, TYPE_I16>::run(char *out, const char *in, size_t count)
+      {
+        volk_8i_convert_16i(
+          reinterpret_cast<int16_t *>(out), reinterpret_cast<const int8_t *>(in), count);
+      }
+
+      template <>
+      void
+      kernel<TYPE_F64, TYPE_F32>::run(char *out, const char *in, size_t count)
+      {
+        volk_64f_convert_32f(
+          reinterpret_cast<float *>(out), reinterpret_cast<const double *>(in), count);
+      }
+
+      template <>
+      void
+      kernel<TYPE_F32, TYPE_F64>::run(char *out, const char *in, size_t count)
+      {
+        volk_32f_convert_64f(
+          reinterpret_cast<double *>(out), reinterpret_cast<const float *>(in), count);
+      }
+
+      template <>
+      void
+      kernel<TYPE_I32, TYPE_I16>::run(char *out, const char *in, size_t count)
+      {
+        simd::dispatched().i32_to_i16(
+          reinterpret_cast<int16_t *>(out), reinterpret_cast<const int32_t *>(in), count);
+      }
+
+      template <>
+      void
+      kernel<TYPE_I32, TYPE_I8>::run(char *out, const char *in, size_t count)
+      {
+        simd::dispatched().i32_to_i8(
+          reinterpret_cast<int8_t *>(out), reinterpret_cast<const int32_t *>(in), count);
+      }
+
+      template <>
+      void
+      kernel<TYPE_I16, TYPE_I32>::run(char *out, const char *in, size_t count)
+      {
+        simd::dispatched().i16_to_i32(
+          reinterpret_cast<int32_t *>(out), reinterpret_cast<const int16_t *>(in), count);
+      }
+
+      template <>
+      void
+      kernel<TYPE_I8, TYPE_I32>::run(char *out, const char *in, size_t count)
+      {
+        simd::dispatched().i8_to_i32(
+          reinterpret_cast<int32_t *>(out), reinterpret_cast<const int8_t *>(in), count);
+      }
+
+      template <>
+      void
+      kernel<TYPE_F32, TYPE_I32>::run(char *out, const char *in, size_t count)
+      {
+        simd::dispatched().f32_to_i32(
+          reinterpret_cast<int32_t *>(out), reinterpret_cast<const float *>(in), count);
+      }
+
+      /*
+       * Scaled conversions, in * scale + offset. Integer outputs are
+       * rounded and saturated. Math is done in float when it's exact
+       * enough, so the loops vectorize well. A 32 bit integer doesn't fit
+       * in float's mantissa, so double is used when one is rounded to or
+       * from.
+       */
+      template <typename in_t,
+                typename out_t,
+                bool out_float = std::is_floating_point<out_t>::value>
+      struct scale_items {
+        typedef typename std::
+          conditional<(sizeof(in_t) <= 4 && sizeof(out_t) <= 4), float, double>::type
+            compute_t;
+
+        static void
+        run(out_t *out, const in_t *in, size_t count, double scale, double offset)
+        {
+          const compute_t s = scale;
+          const compute_t o = offset;
+          for(size_t i = 0; i < count; i++) {
+            out[i] = static_cast<out_t>(static_cast<compute_t>(in[i]) * s + o);
+          }
+        }
+      };
+
+      template <typename in_t, typename out_t>
+      struct scale_items<in_t, out_t, false> {
+        typedef typename std::conditional<(sizeof(out_t) < 4 &&
+                                           (std::is_floating_point<in_t>::value
+                                              ? sizeof(in_t) <= 4
+                                              : sizeof(in_t) < 4)),
+                                          float,
+                                          double>::type compute_t;
+
+        static void
+        run(out_t *out, const in_t *in, size_t count, double scale, double offset)
+        {
+          const compute_t s = scale;
+          const compute_t o = offset;
+          const compute_t lo = static_cast<compute_t>(std::numeric_limits<out_t>::lowest());
+          const compute_t hi = static_cast<compute_t>(std::numeric_limits<out_t>::max());
+          for(size_t i = 0; i < count; i++) {
+            compute_t r = std::nearbyint(static_cast<compute_t>(in[i]) * s + o);
+            if(std::isnan(r) || r <= lo) {
+              out[i] = std::numeric_limits<out_t>::lowest();
+            } else if(r >= hi) {
+              out[i] = std::numeric_limits<out_t>::max();
+            } else {
+              out[i] = static_cast<out_t>(r);
+            }
+          }
+        }
+      };
+
+      /*
+       * The scaled kernel for a pair of signed types. VOLK kernels that
+       * take a scale are used for the common pairs when there's no offset.
+       */
+      template <sample_type_t from, sample_type_t to>
+      struct scaled_kernel {
+        typedef typename sample_traits<from>::type in_t;
+        typedef typename sample_traits<to>::type out_t;
+
+        static void
+        run(char *out, const char *in, size_t count, double scale, double offset)
+        {
+          scale_items<in_t, out_t>::run(reinterpret_cast<out_t *>(out),
+                                        reinterpret_cast<const in_t *>(in),
+                                        count,
+                                        scale,
+                                        offset);
+        }
+      };
+
+      template <>
+      void
+      scaled_kernel<TYPE_F32, TYPE_F32>::run(
+        char *out, const char *in, size_t count, double scale, double offset)
+      {
+        float *o = reinterpret_cast<float *>(out);
+        const float *i = reinterpret_cast<const float *>(in);
+        if(offset != 0) {
+          scale_items<float, float>::run(o, i, count, scale, offset);
+        } else {
+          volk_32f_s32f_multiply_32f(o, i, scale, count);
+        }
+      }
+
+      template <>
+      void
+      scaled_kernel<TYPE_F32, TYPE_I32>::run(
+        char *out, const char *in, size_t count, double scale, double offset)
+      {
+        int32_t *o = reinterpret_cast<int32_t *>(out);
+        const float *i = reinterpret_cast<const float *>(in);
+        if(offset != 0) {
+          scale_items<float, int32_t>::run(o, i, count, scale, offset);
+        } else {
+          volk_32f_s32f_convert_32i(o, i, scale, count);
+        }
+      }
+
+      template <>
+      void
+      scaled_kernel<TYPE_F32, TYPE_I16>::run(
+        char *out, const char *in, size_t count, double scale, double offset)
+      {
+        int16_t *o = reinterpret_cast<int16_t *>(out);
+        const float *i = reinterpret_cast<const float *>(in);
+        if(offset != 0) {
+          scale_items<float, int16_t>::run(o, i, count, scale, offset);
+        } else {
+          volk_32f_s32f_convert_16i(o, i, scale, count);
+        }
+      }
+
+      template <>
+      void
+      scaled_kernel<TYPE_F32, TYPE_I8>::run(
+        char *out, const char *in, size_t count, double scale, double offset)
+      {
+        int8_t *o = reinterpret_cast<int8_t *>(out);
+        const float *i = reinterpret_cast<const float *>(in);
+        if(offset != 0) {
+          scale_items<float, int8_t>::run(o, i, count, scale, offset);
+        } else {
+          volk_32f_s32f_convert_8i(o, i, scale, count);
+        }
+      }
+
+      // VOLK divides by its scalar when converting to float
+      template <>
+      void
+      scaled_kernel<TYPE_I32, TYPE_F32>::run(
+        char *out, const char *in, size_t count, double scale, double offset)
+      {
+        float *o = reinterpret_cast<float *>(out);
+        const int32_t *i = reinterpret_cast<const int32_t *>(in);
+        if(offset != 0 || scale == 0) {
+          scale_items<int32_t, float>::run(o, i, count, scale, offset);
+        } else {
+          volk_32i_s32f_convert_32f(o, i, 1 / scale, count);
+        }
+      }
+
+      template <>
+      void
+      scaled_kernel<TYPE_I16, TYPE_F32>::run(
+        char *out, const char *in, size_t count, double scale, double offset)
+      {
+        float *o = reinterpret_cast<float *>(out);
+        const int16_t *i = reinterpret_cast<const int16_t *>(in);
+        if(offset != 0 || scale == 0) {
+          scale_items<int16_t, float>::run(o, i, count, scale, offset);
+        } else {
+          volk_16i_s32f_convert_32f(o, i, 1 / scale, count);
+        }
+      }
+
+      template <>
+      void
+      scaled_kernel<TYPE_I8, TYPE_F32>::run(
+        char *out, const char *in, size_t count, double scale, double offset)
+      {
+        float *o = reinterpret_cast<float *>(out);
+        const int8_t *i = reinterpret_cast<const int8_t *>(in);
+        if(offset != 0 || scale == 0) {
+          scale_items<int8_t, float>::run(o, i, count, scale, offset);
+        } else {
+          volk_8i_s32f_convert_32f(o, i, 1 / scale, count);
+        }
+      }
+
+      /*
+       * One entry of the conversion table. Unsigned types use the kernel
+       * of their signed counterparts, with sign bits flipped around it.
+       */
+      struct kernel_entry {
+        convert_kernel_t kernel;
+        scaled_kernel_t scaled;
+        size_t in_flip;
+        size_t out_flip;
+      };
+
+      template <sample_type_t from, sample_type_t to>
+      constexpr kernel_entry
+      make_entry()
+      {
+        return kernel_entry{
+          &kernel<sample_traits<from>::signed_type, sample_traits<to>::signed_type>::run,
+          &scaled_kernel<sample_traits<from>::signed_type, sample_traits<to>::signed_type>::run,
+          sample_traits<from>::flip_size, sample_traits<to>::flip_size};
+      }
+
+      template <size_t... I>
+      constexpr std::array<kernel_entry, sizeof...(I)>
+      make_table(std::index_sequence<I...>)
+      {
+        return {{make_entry<static_cast<sample_type_t>(I / NUM_SAMPLE_TYPES),
+                            static_cast<sample_type_t>(I % NUM_SAMPLE_TYPES)>()...}};
+      }
+
+      // Indexed by from * NUM_SAMPLE_TYPES + to
+      constexpr std::array<kernel_entry, NUM_SAMPLE_TYPES * NUM_SAMPLE_TYPES> KERNEL_TABLE =
+        make_table(std::make_index_sequence<NUM_SAMPLE_TYPES * NUM_SAMPLE_TYPES>());
+
+      const size_t SAMPLE_TYPE_SIZES[NUM_SAMPLE_TYPES] = {4, 8, 1, 2, 4, 8, 1, 2, 4, 8};
+
+      /*
+       * Unsigned types are stored offset binary, so the middle of the
+       * unsigned range is zero. Flipping the top bit of every item turns
+       * an unsigned buffer into a signed one of the same width and back.
+       */
+      void
+      flip_sign_bits(char *buf, size_t item_size, size_t count)
+      {
+        // Byte of each item that holds the sign bit
+        size_t sign_byte = (endian::order::native == endian::order::little) ? item_size - 1 : 0;
+
+        // Go a word at a time, which the compiler turns into SIMD
+        unsigned char mask_bytes[sizeof(uint64_t)];
+        for(size_t i = 0; i < sizeof(uint64_t); i++) {
+          mask_bytes[i] = (i % item_size) == sign_byte ? 0x80 : 0;
+        }
+        uint64_t mask;
+        std::memcpy(&mask, mask_bytes, sizeof(mask));
+
+        size_t num_bytes = item_size * count;
+        size_t i = 0;
+        for(; i + sizeof(uint64_t) <= num_bytes; i += sizeof(uint64_t)) {
+          uint64_t word;
+          std::memcpy(&word, buf + i, sizeof(word));
+          word ^= mask;
+          std::memcpy(buf + i, &word, sizeof(word));
+        }
+        for(; i < num_bytes; i += item_size) {
+          buf[i + sign_byte] ^= 0x80;
+        }
+      }
+
+      /*
+       * Swap count items of item_size bytes between big and little endian,
+       * in place
+       */
+      void
+      swap_bytes(char *buf, size_t item_size, size_t count)
+      {
+        switch(item_size) {
+          case 2:
+            volk_16u_byteswap(reinterpret_cast<uint16_t *>(buf), count);
+            break;
+          case 4:
+            volk_32u_byteswap(reinterpret_cast<uint32_t *>(buf), count);
+            break;
+          case 8:
+            volk_64u_byteswap(reinterpret_cast<uint64_t *>(buf), count);
+            break;
+          default:
+            break;
+        }
+      }
+
+      /*
+       * Packed complex formats. Values are widened to (or narrowed from)
+       * i8 for ci4 and i16 for ci12 without scaling, so the rest of a
+       * conversion runs on those types. Packing saturates. The loops have
+       * no branches or carried state, so they vectorize.
+       */
+      void
+      unpack_i4(char *out, const char *in, size_t count)
+      {
+        int8_t *o = reinterpret_cast<int8_t *>(out);
+        const uint8_t *i = reinterpret_cast<const uint8_t *>(in);
+        for(size_t n = 0; n < count / 2; n++) {
+          // Shift up to the sign bit and back down to sign extend
+          o[2 * n] = static_cast<int8_t>(i[n]) >> 4;
+          o[2 * n + 1] = static_cast<int8_t>(i[n] << 4) >> 4;
+        }
+      }
+
+      void
+      pack_i4(char *out, const char *in, size_t count)
+      {
+        uint8_t *o = reinterpret_cast<uint8_t *>(out);
+        const int8_t *i = reinterpret_cast<const int8_t *>(in);
+        for(size_t n = 0; n < count / 2; n++) {
+          int8_t hi = std::min<int8_t>(std::max<int8_t>(i[2 * n], -8), 7);
+          int8_t lo = std::min<int8_t>(std::max<int8_t>(i[2 * n + 1], -8), 7);
+          o[n] = static_cast<uint8_t>((hi << 4) | (lo & 0x0f));
+        }
+      }
+
+      void
+      unpack_i12(char *out, const char *in, size_t count, bool big_endian)
+      {
+        int16_t *o = reinterpret_cast<int16_t *>(out);
+        const uint8_t *i = reinterpret_cast<const uint8_t *>(in);
+        for(size_t n = 0; n < count / 2; n++) {
+          uint16_t b0 = i[3 * n];
+          uint16_t b1 = i[3 * n + 1];
+          uint16_t b2 = i[3 * n + 2];
+          uint16_t first = big_endian ? (b0 << 4) | (b1 >> 4) : b0 | (b1 << 8);
+          uint16_t second = big_endian ? (b1 << 8) | b2 : (b1 >> 4) | (b2 << 4);
+          o[2 * n] = static_cast<int16_t>(first << 4) >> 4;
+          o[2 * n + 1] = static_cast<int16_t>(second << 4) >> 4;
+        }
+      }
+
+      void
+      pack_i12(char *out, const char *in, size_t count, bool big_endian)
+      {
+        uint8_t *o = reinterpret_cast<uint8_t *>(out);
+        const int16_t *i = reinterpret_cast<const int16_t *>(in);
+        for(size_t n = 0; n < count / 2; n++) {
+          uint16_t first = std::min<int16_t>(std::max<int16_t>(i[2 * n], -2048), 2047) & 0x0fff;
+          uint16_t second =
+            std::min<int16_t>(std::max<int16_t>(i[2 * n + 1], -2048), 2047) & 0x0fff;
+          if(big_endian) {
+            o[3 * n] = first >> 4;
+            o[3 * n + 1] = ((first & 0x0f) << 4) | (second >> 8);
+            o[3 * n + 2] = second & 0xff;
+          } else {
+            o[3 * n] = first & 0xff;
+            o[3 * n + 1] = (first >> 8) | ((second & 0x0f) << 4);
+            o[3 * n + 2] = second >> 4;
+          }
+        }
+      }
+
+      // The type packed values are converted through
+      std::string
+      unpacked_type(const format_detail_t &detail)
+      {
+        if(detail.width == 4) {
+          return "i8";
+        } else if(detail.width == 12) {
+          return "i16";
+        }
+        return detail.type_str;
+      }
+
+      bool
+      is_packed(const format_detail_t &detail)
+      {
+        return detail.width == 4 || detail.width == 12;
+      }
+
+      void
+      reserve_buffer(std::unique_ptr<char, volk_deleter> &buf, size_t &allocated, size_t size)
+      {
+        if(size > allocated) {
+          buf.reset(static_cast<char *>(volk_malloc(size, volk_get_alignment())));
+          if(!buf) {
+            allocated = 0;
+            throw std::runtime_error("failed to allocate conversion buffer");
+          }
+          allocated = size;
+        }
+      }
+
+      void
+      copy_bytes(char *out, const char *in, size_t count)
+      {
+        std::memcpy(out, in, count);
+      }
+    } // namespace
+
+    sample_type_t
+    sample_type_from_str(const std::string &type_str)
+    {
+      static const char *names[NUM_SAMPLE_TYPES] = {
+        "f32", "f64", "i8", "i16", "i32", "i64", "u8", "u16", "u32", "u64"};
+      for(size_t i = 0; i < NUM_SAMPLE_TYPES; i++) {
+        if(type_str == names[i]) {
+          return static_cast<sample_type_t>(i);
+        }
+      }
+      throw std::runtime_error("Unsupported sample type " + type_str);
+    }
+
+    size_t
+    sample_type_size(sample_type_t type)
+    {
+      return SAMPLE_TYPE_SIZES[type];
+    }
+
+    std::string
+    converter_isa()
+    {
+      return simd::isa_name(simd::best_isa());
+    }
+
+    type_converter::type_converter()
+    : d_kernel(copy_bytes), d_scaled_kernel(NULL), d_scaled(false), d_scale(1), d_offset(0),
+      d_input_size(1), d_output_size(1), d_input_bits(8), d_output_bits(8), d_in_packed(0),
+      d_out_packed(0), d_in_packed_be(false), d_out_packed_be(false), d_in_flip(0),
+      d_out_flip(0), d_in_swap(0), d_out_swap(0), d_identity(true), d_allocated_size(0),
+      d_pack_allocated_size(0)
+    {
+    }
+
+    type_converter::type_converter(const std::string &from_type, const std::string &to_type)
+    : d_scaled(false), d_scale(1), d_offset(0), d_allocated_size(0), d_pack_allocated_size(0)
+    {
+      init(from_type, to_type);
+    }
+
+    type_converter::type_converter(const std::string &from_type,
+                                   const std::string &to_type,
+                                   double scale,
+                                   double offset)
+    : d_scaled(true), d_scale(scale), d_offset(offset), d_allocated_size(0),
+      d_pack_allocated_size(0)
+    {
+      init(from_type, to_type);
+    }
+
+    void
+    type_converter::init(const std::string &from_type, const std::string &to_type)
+    {
+      format_detail_t from_detail = parse_format_str(from_type);
+      format_detail_t to_detail = parse_format_str(to_type);
+
+      // Check if one is real and the other is complex
+      if(from_detail.is_complex != to_detail.is_complex) {
+        throw std::runtime_error("Can't make types work together");
+      }
+
+      endian_t native = endian::order::native == endian::order::little ? LITTLE : BIG;
+      d_in_packed = is_packed(from_detail) ? from_detail.width : 0;
+      d_out_packed = is_packed(to_detail) ? to_detail.width : 0;
+      // Byte order of a packed type is the order its bits are packed in
+      d_in_packed_be = d_in_packed && from_detail.endianness == BIG;
+      d_out_packed_be = d_out_packed && to_detail.endianness == BIG;
+
+      sample_type_t from = sample_type_from_str(unpacked_type(from_detail));
+      sample_type_t to = sample_type_from_str(unpacked_type(to_detail));
+      d_input_size = sample_type_size(from);
+      d_output_size = sample_type_size(to);
+      d_input_bits = d_in_packed ? d_in_packed : d_input_size * 8;
+      d_output_bits = d_out_packed ? d_out_packed : d_output_size * 8;
+
+      if(!d_scaled && d_in_packed && to_detail.type_str[0] == 'f') {
+        // Scale by the max of the packed type, not the type it's unpacked to
+        d_scaled = true;
+        d_scale = 1.0 / ((1 << (d_in_packed - 1)) - 1);
+        d_offset = 0;
+      }
+
+      const kernel_entry &entry = KERNEL_TABLE[from * NUM_SAMPLE_TYPES + to];
+      d_kernel = entry.kernel;
+      d_scaled_kernel = entry.scaled;
+      d_in_flip = entry.in_flip;
+      d_out_flip = entry.out_flip;
+      d_identity = from == to && !d_scaled && d_in_packed == d_out_packed &&
+                   d_in_packed_be == d_out_packed_be;
+
+      // Item sizes to byte swap, for either side not in native order
+      bool swap_in = !d_in_packed && from_detail.endianness != native && d_input_size > 1;
+      bool swap_out = !d_out_packed && to_detail.endianness != native && d_output_size > 1;
+      d_in_swap = swap_in ? d_input_size : 0;
+      d_out_swap = swap_out ? d_output_size : 0;
+      if(d_identity && d_in_swap == d_out_swap) {
+        // It would be swapped twice
+        d_in_swap = 0;
+        d_out_swap = 0;
+      }
+    }
+
+    size_t
+    type_converter::input_bytes(size_t count) const
+    {
+      return count * d_input_bits / 8;
+    }
+
+    size_t
+    type_converter::output_bytes(size_t count) const
+    {
+      return count * d_output_bits / 8;
+    }
+
+    size_t
+    type_converter::input_items(size_t bytes) const
+    {
+      size_t count = bytes * 8 / d_input_bits;
+      // Packed values only come in whole pairs
+      return d_in_packed ? count & ~static_cast<size_t>(1) : count;
+    }
+
+    bool
+    type_converter::is_identity() const
+    {
+      return d_identity;
+    }
+
+    void
+    type_converter::convert_in_place(char *out, char *in, size_t count)
+    {
+      if(d_identity) {
+        convert(out, in, count);
+        return;
+      }
+
+      if(d_in_packed) {
+        reserve_buffer(d_temp_buf, d_allocated_size, count * d_input_size);
+        if(d_in_packed == 4) {
+          unpack_i4(d_temp_buf.get(), in, count);
+        } else {
+          unpack_i12(d_temp_buf.get(), in, count, d_in_packed_be);
+        }
+        in = d_temp_buf.get();
+      }
+      if(d_in_swap) {
+        swap_bytes(in, d_in_swap, count);
+      }
+      if(d_in_flip) {
+        flip_sign_bits(in, d_in_flip, count);
+      }
+
+      char *dest = out;
+      if(d_out_packed) {
+        reserve_buffer(d_pack_buf, d_pack_allocated_size, count * d_output_size);
+        dest = d_pack_buf.get();
+      }
+      if(d_scaled) {
+        d_scaled_kernel(dest, in, count, d_scale, d_offset);
+      } else {
+        d_kernel(dest, in, count);
+      }
+      if(d_out_flip) {
+        flip_sign_bits(dest, d_out_flip, count);
+      }
+      if(d_out_swap) {
+        swap_bytes(dest, d_out_swap, count);
+      }
+      if(d_out_packed == 4) {
+        pack_i4(out, dest, count);
+      } else if(d_out_packed == 12) {
+        pack_i12(out, dest, count, d_out_packed_be);
+      }
+    }
+
+    void
+    type_converter::convert(char *out, const char *in, size_t count)
+    {
+      if(d_identity) {
+        if(out != in) {
+          std::memmove(out, in, input_bytes(count));
+        }
+        // Only one side is swapped, the other is native
+        if(d_in_swap || d_out_swap) {
+          swap_bytes(out, d_input_size, count);
+        }
+        return;
+      }
+
+      if(d_in_swap || d_in_flip) {
+        // Don't modify the caller's input
+        reserve_buffer(d_temp_buf, d_allocated_size, d_input_size * count);
+        std::memcpy(d_temp_buf.get(), in, d_input_size * count);
+        convert_in_place(out, d_temp_buf.get(), count);
+        return;
+      }
+
+      // Nothing is done to the input, so the kernel can read it directly.
+      // Packed input is only read while it's unpacked.
+      convert_in_place(out, const_cast<char *>(in), count);
+    }
+
+    bool
+    applies_recording_scale(const meta_namespace &global, const std::string &to_type)
+    {
+      return global.has(SCALE_META_KEY) && parse_format_str(to_type).type_str[0] == 'f';
+    }
+
+    type_converter
+    make_recording_converter(const meta_namespace &global, const std::string &to_type)
+    {
+      std::string from_type = global.get_str("core:datatype");
+      if(applies_recording_scale(global, to_type)) {
+        double scale = pmt_utils::number_to_double(global.get(SCALE_META_KEY));
+        double offset =
+          pmt_utils::number_to_double(global.get(OFFSET_META_KEY, pmt::from_double(0)));
+        return type_converter(from_type, to_type, scale, offset);
+      }
+      return type_converter(from_type, to_type);
+    }
+
+  } // namespace sigmf
+} // namespace gr
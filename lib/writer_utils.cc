@@ -2,57 +2,159 @@
 
 #define RAPIDJSON_HAS_STDSTRING 1
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <utility>
 #include <rapidjson/document.h>
 #include <rapidjson/filewritestream.h>
 #include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
 
 namespace gr {
   namespace sigmf {
     namespace writer_utils {
+      namespace {
+        void
+        sort_annotations(std::vector<meta_namespace> &annotations)
+        {
+          // Read each sample_start once up front instead of twice per
+          // comparison
+          // TODO: This may need to become a more complex sort if the spec
+          // changes based on https://github.com/gnuradio/SigMF/issues/90
+          std::vector<std::pair<uint64_t, size_t>> order;
+          order.reserve(annotations.size());
+          bool sorted = true;
+          for(size_t i = 0; i < annotations.size(); i++) {
+            order.emplace_back(
+              annotations[i].get_as<uint64_t>(meta_key::SAMPLE_START), i);
+            sorted = sorted && (i == 0 || order[i - 1].first <= order[i].first);
+          }
+          // Annotations are usually added in order already
+          if(sorted) {
+            return;
+          }
+          std::stable_sort(order.begin(), order.end(),
+                           [](const std::pair<uint64_t, size_t> &a,
+                              const std::pair<uint64_t, size_t> &b) {
+                             return a.first < b.first;
+                           });
+          std::vector<meta_namespace> sorted_annotations;
+          sorted_annotations.reserve(annotations.size());
+          for(const std::pair<uint64_t, size_t> &o : order) {
+            sorted_annotations.push_back(std::move(annotations[o.second]));
+          }
+          annotations.swap(sorted_annotations);
+        }
+
+        template <typename Writer>
+        void
+        write_meta(Writer &writer,
+                   const meta_namespace &global,
+                   const std::vector<meta_namespace> &captures,
+                   const std::vector<meta_namespace> &annotations)
+        {
+          writer.StartObject();
+
+          writer.String("global");
+          global.serialize(writer);
+
+          writer.String("captures");
+          writer.StartArray();
+          for(const meta_namespace &capture : captures) {
+            capture.serialize(writer);
+          }
+          writer.EndArray();
+
+          writer.String("annotations");
+          writer.StartArray();
+          for(const meta_namespace &annotation : annotations) {
+            annotation.serialize(writer);
+          }
+          writer.EndArray();
+
+          writer.EndObject();
+        }
+
+        // Annotations at the same depth write_meta puts them
+        template <typename Writer>
+        void
+        write_annotations(Writer &writer, const std::vector<meta_namespace> &annotations)
+        {
+          writer.StartObject();
+          writer.String("annotations");
+          writer.StartArray();
+          for(const meta_namespace &annotation : annotations) {
+            annotation.serialize(writer);
+          }
+          writer.EndArray();
+          writer.EndObject();
+        }
+      } // namespace
+
       void
       write_meta_to_fp(FILE *fp,
                        const meta_namespace &global,
                        std::vector<meta_namespace> &captures, // TODO: These should
                                                               // probably be const
-                       std::vector<meta_namespace> &annotations)
+                       std::vector<meta_namespace> &annotations,
+                       bool pretty)
       {
         char write_buf[65536];
         rapidjson::FileWriteStream file_stream(fp, write_buf, sizeof(write_buf));
 
-        rapidjson::PrettyWriter<rapidjson::FileWriteStream> writer(file_stream);
-        writer.StartObject();
+        sort_annotations(annotations);
 
-        writer.String("global");
-        global.serialize(writer);
+        if(pretty) {
+          rapidjson::PrettyWriter<rapidjson::FileWriteStream> writer(file_stream);
+          write_meta(writer, global, captures, annotations);
+        } else {
+          rapidjson::Writer<rapidjson::FileWriteStream> writer(file_stream);
+          write_meta(writer, global, captures, annotations);
+        }
+        file_stream.Flush();
+      }
 
-        writer.String("captures");
-        writer.StartArray();
-        for(std::vector<meta_namespace>::iterator it = captures.begin(); it != captures.end(); it++) {
-          (*it).serialize(writer);
+      void
+      write_annotations_tail(FILE *fp,
+                             std::vector<meta_namespace> &annotations,
+                             bool after_elements,
+                             bool pretty)
+      {
+        sort_annotations(annotations);
+
+        rapidjson::StringBuffer buffer;
+        if(pretty) {
+          rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+          write_annotations(writer, annotations);
+        } else {
+          rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+          write_annotations(writer, annotations);
         }
-        writer.EndArray();
-
-        
-        // sort annotations
-        std::sort(annotations.begin(), annotations.end(),
-                  [](const meta_namespace &a, const meta_namespace &b) {
-                    // TODO: This may need to become a more complex sort if the spec
-                    // changes based on https://github.com/gnuradio/SigMF/issues/90
-                    return pmt::to_uint64(a.get("core:sample_start")) <
-                      pmt::to_uint64(b.get("core:sample_start"));
-                  });
-
-        writer.String("annotations");
-        writer.StartArray();
-        for(std::vector<meta_namespace>::iterator it = annotations.begin();
-            it != annotations.end(); it++) {
-          (*it).serialize(writer);
+
+        // Cut the elements and closing bracket out of the object they
+        // were written in, indented as they would be in a whole file
+        std::string text(buffer.GetString(), buffer.GetSize());
+        size_t open = text.find('[');
+        size_t close = text.rfind(']');
+        if(after_elements) {
+          std::fputc(',', fp);
         }
-        writer.EndArray();
+        std::fwrite(text.data() + open + 1, 1, close - open, fp);
+      }
 
-        writer.EndObject();
+      std::string
+      unique_temp_path(const std::string &path)
+      {
+        static std::atomic<unsigned> counter(0);
+        return path + ".tmp-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
       }
     } // namespace writer_utils
   } // namespace sigmf
-} // namespace gr
\ No newline at end of file
+} // namespace gr
@@ -2,6 +2,7 @@
 #define INCLUDED_SIGMF_WRITER_UTILS_H
 
 #include <cstdio>
+#include <string>
 #include <vector>
 #include "sigmf/meta_namespace.h"
 
@@ -16,12 +17,37 @@ namespace gr {
       /**
        * Write given metadata data set to file.
        * Assumes file is already open and does not
-       * close the file when finished
+       * close the file when finished.
+       *
+       * Annotations are sorted by sample_start first. With pretty set
+       * to false the JSON is written without any whitespace, which is
+       * roughly half the size for large annotation arrays.
        */
       void write_meta_to_fp(FILE *fp,
                             const meta_namespace &global,
                             std::vector<meta_namespace> &captures,
-                            std::vector<meta_namespace> &annotations);
+                            std::vector<meta_namespace> &annotations,
+                            bool pretty = true);
+
+      /**
+       * Write annotations the way write_meta_to_fp writes the elements
+       * of the annotations array, followed by the array's closing
+       * bracket and nothing else, so they can be added to the end of the
+       * array in a file it wrote. Annotations are sorted by sample_start
+       * first. With after_elements set, the text starts with the comma
+       * that separates them from the elements already in the array.
+       */
+      void write_annotations_tail(FILE *fp,
+                                  std::vector<meta_namespace> &annotations,
+                                  bool after_elements,
+                                  bool pretty = true);
+
+      /**
+       * Name for a temporary file next to path, to be written and then
+       * renamed over it. The name is different on every call from any
+       * thread or process, so writers of the same file never share one.
+       */
+      std::string unique_temp_path(const std::string &path);
     }
   } // namespace sigmf
 } // namespace gr
@@ -58,6 +58,12 @@
  static const char *__doc_gr_sigmf_sink_set_capture_meta = R"doc()doc";
 
 
+ static const char *__doc_gr_sigmf_sink_set_scale = R"doc()doc";
+
+
+ static const char *__doc_gr_sigmf_sink_set_compact_meta = R"doc()doc";
+
+
  static const char *__doc_gr_sigmf_sink_open = R"doc()doc";
 
 
@@ -31,9 +31,27 @@
  static const char *__doc_gr_sigmf_source_make_no_datatype = R"doc()doc";
 
 
+ static const char *__doc_gr_sigmf_source_make_sequence = R"doc()doc";
+
+
  static const char *__doc_gr_sigmf_source_set_begin_tag = R"doc()doc";
 
 
+ static const char *__doc_gr_sigmf_source_set_repeat_cache = R"doc()doc";
+
+
+ static const char *__doc_gr_sigmf_source_set_preview = R"doc()doc";
+
+
+ static const char *__doc_gr_sigmf_source_set_scale = R"doc()doc";
+
+
+ static const char *__doc_gr_sigmf_source_set_pacing = R"doc()doc";
+
+
+ static const char *__doc_gr_sigmf_source_pacing_stats = R"doc()doc";
+
+
  static const char *__doc_gr_sigmf_source_global_meta = R"doc()doc";
 
 
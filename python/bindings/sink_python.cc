@@ -14,7 +14,7 @@
 /* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
 /* BINDTOOL_USE_PYGCCXML(0)                                                        */
 /* BINDTOOL_HEADER_FILE(sink.h)                                        */
-/* BINDTOOL_HEADER_FILE_HASH(8961b7a36fba749488f5ced350c2a6af)                     */
+/* BINDTOOL_HEADER_FILE_HASH(cefe47f3b06658c2f1ac881ce25151d9)                     */
 /***********************************************************************************/
 
 #include <pybind11/complex.h>
@@ -128,6 +128,21 @@ void bind_sink(py::module& m)
 
 
         
+        .def("set_scale",&sink::set_scale,       
+            py::arg("scale"),
+            py::arg("offset") = 0,
+            D(sink,set_scale)
+        )
+
+
+        
+        .def("set_compact_meta",&sink::set_compact_meta,       
+            py::arg("compact"),
+            D(sink,set_compact_meta)
+        )
+
+
+        
         .def("open",&sink::open,       
             py::arg("filename"),
             D(sink,open)
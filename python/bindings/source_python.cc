@@ -14,7 +14,7 @@
 /* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
 /* BINDTOOL_USE_PYGCCXML(0)                                                        */
 /* BINDTOOL_HEADER_FILE(source.h)                                        */
-/* BINDTOOL_HEADER_FILE_HASH(692a3a1e91b9075e6720c5fc39f47711)                     */
+/* BINDTOOL_HEADER_FILE_HASH(ecfff1864a1f6eb546ee407cbb6d6749)                     */
 /***********************************************************************************/
 
 #include <pybind11/complex.h>
@@ -40,6 +40,7 @@ void bind_source(py::module& m)
            py::arg("filename"),
            py::arg("output_datatype"),
            py::arg("repeat") = false,
+           py::arg("stream_annotations") = false,
            D(source,make)
         )
         
@@ -51,11 +52,22 @@ void bind_source(py::module& m)
         .def_static("make_no_datatype",&source::make_no_datatype,       
             py::arg("filename"),
             py::arg("repeat") = false,
+            py::arg("stream_annotations") = false,
             D(source,make_no_datatype)
         )
 
 
         
+        .def_static("make_sequence",&source::make_sequence,       
+            py::arg("filenames"),
+            py::arg("output_datatype") = "",
+            py::arg("repeat") = false,
+            py::arg("stream_annotations") = false,
+            D(source,make_sequence)
+        )
+
+
+        
         .def("set_begin_tag",&source::set_begin_tag,       
             py::arg("val"),
             D(source,set_begin_tag)
@@ -63,6 +75,43 @@ void bind_source(py::module& m)
 
 
         
+        .def("set_repeat_cache",&source::set_repeat_cache,       
+            py::arg("max_bytes"),
+            D(source,set_repeat_cache)
+        )
+
+
+        
+        .def("set_preview",&source::set_preview,       
+            py::arg("stride"),
+            py::arg("block_size") = 1024,
+            D(source,set_preview)
+        )
+
+
+        
+        .def("set_scale",&source::set_scale,       
+            py::arg("scale"),
+            py::arg("offset") = 0,
+            D(source,set_scale)
+        )
+
+
+        
+        .def("set_pacing",&source::set_pacing,       
+            py::arg("paced"),
+            py::arg("max_burst") = 4096,
+            D(source,set_pacing)
+        )
+
+
+        
+        .def("pacing_stats",&source::pacing_stats,       
+            D(source,pacing_stats)
+        )
+
+
+        
         .def("global_meta",&source::global_meta,       
             D(source,global_meta)
         )
@@ -198,6 +198,20 @@ class qa_annotation_sink (gr_unittest.TestCase):
             self.assertEqual(meta["annotations"][2]["core:sample_start"],
                              1, "New tag add failure")
 
+    def test_absolute_time_without_captures(self):
+        '''Absolute time needs the datetime of the first capture, so a
+        file with no captures is refused'''
+        data, json_dict, data_path, json_path = self.make_file(
+            "no_captures", global_data={"core:sample_rate": 100})
+        del json_dict["captures"]
+        with open(json_path, "w") as f:
+            json.dump(json_dict, f)
+        with self.assertRaises(RuntimeError):
+            sigmf.annotation_sink(
+                data_path,
+                sigmf.annotation_mode_clear("test:foo*"),
+                sigmf.sigmf_time_mode_absolute)
+
     def test_annotation_sink_time_offsets(self):
         '''Test of using the annotation sink with absolute time offsets'''
         data, json_dict, data_path, json_path = self.make_file(
@@ -329,6 +343,130 @@ class qa_annotation_sink (gr_unittest.TestCase):
                 meta["annotations"][2]["test:foo2"],
                 "foo", "Wrong value in annotation")
 
+    def run_sink(self, data_path, messages):
+        anno_sink = sigmf.annotation_sink(
+            data_path, sigmf.annotation_mode_keep())
+        sender = msg_sender()
+        tb = gr.top_block()
+        tb.msg_connect(sender, "out", anno_sink, "annotations")
+        tb.start()
+        for msg in messages:
+            sender.send_msg(msg)
+        sleep(.1)
+        tb.stop()
+        tb.wait()
+
+    def test_annotation_sink_append(self):
+        '''New annotations after the existing ones are written into the
+        end of the file without rewriting the rest'''
+        data, json_dict, data_path, json_path = self.make_file(
+            "append",
+            annotations=[{
+                "core:sample_start": 0,
+                "core:sample_count": 1,
+                "test:foo": 1
+            }]
+        )
+        with open(json_path, "rb") as f:
+            original = f.read()
+        # Everything up to the end of the last annotation
+        head = original[:original.rindex(b"}", 0, original.rindex(b"]")) + 1]
+
+        self.run_sink(data_path, [
+            {"core:sample_start": 20, "core:sample_count": 5, "test:bar": "b"},
+            {"core:sample_start": 10, "core:sample_count": 5, "test:bar": "a"}
+        ])
+
+        with open(json_path, "rb") as f:
+            updated = f.read()
+        self.assertTrue(updated.startswith(head),
+                        "Existing metadata was rewritten")
+        meta = json.loads(updated)
+        self.assertEqual(meta["global"], json_dict["global"])
+        self.assertEqual(meta["captures"], json_dict["captures"])
+        self.assertEqual(
+            [a["core:sample_start"] for a in meta["annotations"]], [0, 10, 20])
+        self.assertEqual(meta["annotations"][0]["test:foo"], 1)
+        self.assertEqual(meta["annotations"][1]["test:bar"], "a")
+        self.assertEqual(meta["annotations"][2]["test:bar"], "b")
+
+    def test_annotation_sink_append_before_other_keys(self):
+        '''Appending keeps whatever follows the annotations array, and works
+        on an empty one'''
+        data, json_dict, data_path, json_path = self.make_file("append_first")
+        ordered = {"annotations": [], "captures": json_dict["captures"],
+                   "global": json_dict["global"]}
+        with open(json_path, "w") as f:
+            json.dump(ordered, f, indent=4)
+
+        self.run_sink(data_path, [
+            {"core:sample_start": 10, "core:sample_count": 5, "test:bar": "a"}
+        ])
+
+        with open(json_path, "r") as f:
+            meta = json.load(f)
+        self.assertEqual(list(meta.keys()), ["annotations", "captures", "global"])
+        self.assertEqual(meta["global"], json_dict["global"])
+        self.assertEqual(meta["captures"], json_dict["captures"])
+        self.assertEqual(
+            [a["core:sample_start"] for a in meta["annotations"]], [10])
+
+    def test_annotation_sink_rewrite(self):
+        '''Annotations that go before existing ones mean the whole file is
+        rewritten, in order'''
+        data, json_dict, data_path, json_path = self.make_file(
+            "rewrite",
+            annotations=[{
+                "core:sample_start": 100,
+                "core:sample_count": 1,
+                "test:foo": 1
+            }]
+        )
+
+        self.run_sink(data_path, [
+            {"core:sample_start": 50, "core:sample_count": 5, "test:bar": "a"}
+        ])
+
+        with open(json_path, "r") as f:
+            meta = json.load(f)
+        self.assertEqual(meta["global"], json_dict["global"])
+        self.assertEqual(
+            [a["core:sample_start"] for a in meta["annotations"]], [50, 100])
+        self.assertEqual(meta["annotations"][1]["test:foo"], 1)
+        # The temporary file was renamed over the old one
+        self.assertEqual(
+            [name for name in os.listdir(self.test_dir) if ".tmp" in name], [])
+
+
+    def test_annotation_sink_rewrite_symlink(self):
+        '''A meta file that is a symlink stays one, and the file it
+        points to is the one rewritten'''
+        data, json_dict, data_path, json_path = self.make_file(
+            "rewrite_link",
+            annotations=[{
+                "core:sample_start": 100,
+                "core:sample_count": 1,
+                "test:foo": 1
+            }]
+        )
+        real_dir = os.path.join(self.test_dir, "real")
+        os.mkdir(real_dir)
+        real_path = os.path.join(real_dir, os.path.basename(json_path))
+        shutil.move(json_path, real_path)
+        os.symlink(real_path, json_path)
+
+        self.run_sink(data_path, [
+            {"core:sample_start": 50, "core:sample_count": 5, "test:bar": "a"}
+        ])
+
+        self.assertTrue(os.path.islink(json_path))
+        with open(real_path, "r") as f:
+            meta = json.load(f)
+        self.assertEqual(
+            [a["core:sample_start"] for a in meta["annotations"]], [50, 100])
+        for d in (self.test_dir, real_dir):
+            self.assertEqual(
+                [name for name in os.listdir(d) if ".tmp" in name], [])
 
 if __name__ == '__main__':
     gr_unittest.run(qa_annotation_sink)
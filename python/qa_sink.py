@@ -911,6 +911,37 @@ class qa_sink(gr_unittest.TestCase):
             exception_msg = str(e)
         assert "endianness" in exception_msg
 
+    def test_compact_meta(self):
+        '''Check that compact metadata has no whitespace and holds the
+        same metadata as the pretty printed file'''
+
+        def write(compact):
+            data_file, json_file = self.temp_file_names()
+            file_sink = sigmf.sink("cf32_le", data_file)
+            file_sink.set_compact_meta(compact)
+            # Out of order, so they have to be sorted
+            for start in [30, 10, 20]:
+                file_sink.set_annotation_meta(start, 5, "test:start", pmt.from_uint64(start))
+            src = blocks.vector_source_c([1 + 1j] * 100)
+            tb = gr.top_block()
+            tb.connect(src, file_sink)
+            tb.run()
+            tb.wait()
+            with open(json_file, "r") as f:
+                return f.read()
+
+        pretty = write(False)
+        compact = write(True)
+        self.assertNotIn("\n", compact)
+        self.assertLess(len(compact), len(pretty))
+        meta = json.loads(compact)
+        pretty_meta = json.loads(pretty)
+        # Captures have the time each file was written
+        self.assertEqual(meta["global"], pretty_meta["global"])
+        self.assertEqual(meta["annotations"], pretty_meta["annotations"])
+        self.assertEqual([a["core:sample_start"] for a in meta["annotations"]],
+                         [10, 20, 30])
+
     def test_inconsistent_data_on_kill(self):
         '''Check that if the sink is killed before it writes out the
         final metadata file, then the data file should have a name like
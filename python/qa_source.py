@@ -4,7 +4,9 @@ import shutil
 import json
 import os
 import math
-from time import sleep
+import numpy
+import sys
+from time import sleep, monotonic
 
 import pmt
 from gnuradio import gr, gr_unittest, blocks
@@ -99,6 +101,23 @@ class qa_source (gr_unittest.TestCase):
             meta_json = json.load(f)
         return data, meta_json, data_path, meta_path
 
+    def make_raw_file(self, filename, datatype, samples):
+        """write samples, a numpy array already in the on-disk format,
+        as a recording with minimal metadata"""
+        data_path = os.path.join(self.test_dir, filename + ".sigmf-data")
+        meta_path = os.path.join(self.test_dir, filename + ".sigmf-meta")
+        samples.tofile(data_path)
+        with open(meta_path, "w") as f:
+            json.dump({
+                "global": {
+                    "core:datatype": datatype,
+                    "core:version": "0.0.1",
+                },
+                "captures": [{"core:sample_start": 0}],
+                "annotations": [],
+            }, f)
+        return data_path
+
     def test_normal_run(self):
         """Test a bog-standard run through a normal file and
         ensure that the data is correct"""
@@ -324,6 +343,707 @@ class qa_source (gr_unittest.TestCase):
         collector.assertTagExists(5, "test:more_data", True)
         collector.assertTagExists(10, "test:rating", 12)
 
+    def test_streamed_annotations_to_tags(self):
+        data, meta_json, filename, meta_file = self.make_file(
+            "streamed_annotation_tags")
+
+        # Add some annotations and a capture segment
+        with open(meta_file, "r+") as f:
+            data = json.load(f)
+            data['captures'].append({
+                "core:sample_start": 7,
+                "core:frequency": 2.4e9,
+            })
+            data['annotations'].append({
+                "core:sample_start": 5,
+                "test:string": "This is some string data",
+                "test:more_data": True,
+            })
+            data['annotations'].append({
+                "core:sample_start": 10,
+                "test:rating": 12,
+            })
+            data['annotations'].append({
+                "core:sample_start": 10,
+                "test:other": [1, 2, 3],
+            })
+
+            f.seek(0)
+            json.dump(data, f, indent=4)
+            f.truncate()
+
+        # run through the flowgraph
+        file_source = sigmf.source(filename, "cf32_le",
+                                   stream_annotations=True)
+        sink = blocks.vector_sink_c()
+        collector = tag_collector()
+        tb = gr.top_block()
+        tb.connect(file_source, collector)
+        tb.connect(collector, sink)
+        tb.run()
+
+        collector.assertTagExists(5, "test:string", "This is some string data")
+        collector.assertTagExists(5, "test:more_data", True)
+        collector.assertTagExists(7, "rx_freq", 2.4e9)
+        collector.assertTagExists(10, "test:rating", 12)
+        collector.assertTagExists(10, "test:other", (1, 2, 3))
+
+        # Tags should not be duplicated
+        offset_10_tags = [t for t in collector.tags if t["offset"] == 10]
+        self.assertEqual(len(offset_10_tags), 2)
+
+    def test_streamed_annotations_repeat(self):
+        N = 1000
+        annos = [{
+            "core:sample_start": 1,
+            "core:sample_count": 1,
+            "test:foo": "a",
+        }, {
+            "core:sample_start": 900,
+            "core:sample_count": 1,
+            "test:bar": "b",
+        }]
+        data, meta_json, filename, meta_file = self.make_file(
+            "streamed_repeat", N=N, annotations=annos)
+        file_source = sigmf.source(filename, "cf32_le", repeat=True,
+                                   stream_annotations=True)
+        sink = blocks.vector_sink_c()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.start()
+        sleep(.005)
+        tb.stop()
+        tb.wait()
+        num_reps = len(sink.data()) // N
+        self.assertGreater(num_reps, 1, "No repeats occurred to test!")
+
+        for i in range(num_reps):
+            foo_tags = [t for t in sink.tags()
+                        if t.offset == (i * N) + 1 and
+                        pmt.to_python(t.key) == "test:foo"]
+            self.assertEqual(len(foo_tags), 1, "test:foo missing in repeat")
+            bar_tags = [t for t in sink.tags()
+                        if t.offset == (i * N) + 900 and
+                        pmt.to_python(t.key) == "test:bar"]
+            self.assertEqual(len(bar_tags), 1, "test:bar missing in repeat")
+
+    def test_streamed_annotations_first_in_file(self):
+        '''If annotations come before captures in the metadata,
+        streaming falls back to loading everything'''
+        data, meta_json, filename, meta_file = self.make_file(
+            "streamed_annotations_first")
+        reordered = {
+            "annotations": [{
+                "core:sample_start": 3,
+                "test:value": 1,
+            }],
+            "global": meta_json["global"],
+            "captures": meta_json["captures"],
+        }
+        with open(meta_file, "w") as f:
+            json.dump(reordered, f)
+
+        file_source = sigmf.source(filename, "cf32_le",
+                                   stream_annotations=True)
+        sink = blocks.vector_sink_c()
+        collector = tag_collector()
+        tb = gr.top_block()
+        tb.connect(file_source, collector)
+        tb.connect(collector, sink)
+        tb.run()
+
+        collector.assertTagExists(3, "test:value", 1)
+        self.assertComplexTuplesAlmostEqual(data, sink.data())
+
+    def test_no_captures(self):
+        '''Metadata without captures, or with an empty captures array,
+        plays from the start of the data file'''
+        data, meta_json, filename, meta_file = self.make_file("no_captures")
+        for captures in (None, []):
+            meta = {
+                "global": meta_json["global"],
+                "annotations": [{
+                    "core:sample_start": 3,
+                    "test:value": 1,
+                }],
+            }
+            if captures is not None:
+                meta["captures"] = captures
+            with open(meta_file, "w") as f:
+                json.dump(meta, f)
+
+            for stream_annotations in (False, True):
+                file_source = sigmf.source(
+                    filename, "cf32_le", stream_annotations=stream_annotations)
+                self.assertEqual(len(file_source.capture_segments()), 0)
+                sink = blocks.vector_sink_c()
+                collector = tag_collector()
+                tb = gr.top_block()
+                tb.connect(file_source, collector)
+                tb.connect(collector, sink)
+                tb.run()
+
+                collector.assertTagExists(3, "test:value", 1)
+                self.assertComplexTuplesAlmostEqual(data, sink.data())
+
+    def test_streamed_annotations_index(self):
+        '''Large metadata files get a binary index, which hands out
+        annotations sorted by sample_start and is rebuilt when the
+        metadata changes'''
+        N = 1000
+        data, meta_json, filename, meta_file = self.make_file(
+            "streamed_index", N=N)
+        index_file = meta_file + ".idx"
+
+        def write_meta(value):
+            # Big enough to be indexed, out of order, and with the
+            # annotations first
+            annotations = [{
+                "core:sample_start": (i * 7) % N,
+                "core:sample_count": 1,
+                "test:value": value,
+                "test:padding": "x" * 200,
+            } for i in range(5000)]
+            with open(meta_file, "w") as f:
+                json.dump({
+                    "annotations": annotations,
+                    "global": meta_json["global"],
+                    "captures": meta_json["captures"],
+                }, f)
+
+        def play():
+            file_source = sigmf.source(filename, "cf32_le",
+                                       stream_annotations=True)
+            sink = blocks.vector_sink_c()
+            tb = gr.top_block()
+            tb.connect(file_source, sink)
+            tb.run()
+            return [t for t in sink.tags()
+                    if pmt.to_python(t.key) == "test:value"]
+
+        write_meta(1)
+        tags = play()
+        self.assertTrue(os.path.exists(index_file))
+        # Out of order annotations would have been dropped without it
+        self.assertEqual(len(tags), 5000)
+        self.assertEqual(set(pmt.to_python(t.value) for t in tags), {1})
+
+        # The old index no longer matches the metadata
+        write_meta(22)
+        tags = play()
+        self.assertEqual(len(tags), 5000)
+        self.assertEqual(set(pmt.to_python(t.value) for t in tags), {22})
+
+    def test_paced_playback(self):
+        # 20000 samples at 200 kHz should take about 100 ms
+        N = 20000
+        data, meta_json, filename, meta_file = self.make_file(
+            "paced", N=N, global_data={"core:sample_rate": 200000.})
+        file_source = sigmf.source(filename, "cf32_le")
+        file_source.set_pacing(True, 1000)
+        sink = blocks.vector_sink_c()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        start = monotonic()
+        tb.run()
+        elapsed = monotonic() - start
+
+        self.assertComplexTuplesAlmostEqual(data, sink.data())
+        self.assertGreaterEqual(elapsed, 0.09)
+        stats = pmt.to_python(file_source.pacing_stats())
+        self.assertEqual(stats["samples"], N)
+        self.assertGreaterEqual(stats["bursts"], N // 1000)
+        self.assertEqual(stats["resyncs"], 0)
+
+    def test_paced_repeat_time_advances(self):
+        N = 1000
+        capture = [{
+            "core:sample_start": 0,
+            "core:datetime": "2018-01-01T00:00:00.000Z",
+        }]
+        data, meta_json, filename, meta_file = self.make_file(
+            "paced_repeat", N=N, captures=capture,
+            global_data={"core:sample_rate": 200000.})
+        file_source = sigmf.source(filename, "cf32_le", repeat=True)
+        file_source.set_pacing(True, 500)
+        sink = blocks.vector_sink_c()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.start()
+        # long enough for a few repeats at 200 kHz
+        sleep(.05)
+        tb.stop()
+        tb.wait()
+
+        times = [pmt.to_python(t.value) for t in sink.tags()
+                 if pmt.to_python(t.key) == "rx_time"]
+        self.assertGreater(len(times), 1, "No repeats occurred to test!")
+        # Each repeat should be one file's worth of time later
+        for i, (secs, frac) in enumerate(times):
+            self.assertAlmostEqual(secs + frac - times[0][0] - times[0][1],
+                                   i * N / 200000.)
+
+    def test_paced_sequence_rates(self):
+        # 2000 samples at 200 kHz then 2000 at 20 kHz, about 110 ms in all
+        N = 2000
+        files = []
+        all_data = []
+        for i, rate in enumerate([200000., 20000.]):
+            data, meta_json, filename, meta_file = self.make_file(
+                "paced_sequence_%d" % i, N=N,
+                global_data={"core:sample_rate": rate})
+            files.append(filename)
+            all_data.extend(data)
+        file_source = sigmf.source.make_sequence(files, "cf32_le")
+        file_source.set_pacing(True, 200)
+        sink = blocks.vector_sink_c()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        start = monotonic()
+        tb.run()
+        elapsed = monotonic() - start
+
+        self.assertComplexTuplesAlmostEqual(all_data, sink.data())
+        # At the first rate throughout it would take 20 ms
+        self.assertGreaterEqual(elapsed, 0.1)
+        stats = pmt.to_python(file_source.pacing_stats())
+        self.assertEqual(stats["samples"], 2 * N)
+        self.assertEqual(stats["resyncs"], 0)
+
+    def test_sequence_playback(self):
+        N = 1000
+        files = []
+        all_data = []
+        for i in range(3):
+            annos = [{
+                "core:sample_start": 5,
+                "test:file": i,
+            }]
+            data, meta_json, filename, meta_file = self.make_file(
+                "sequence_%d" % i, N=N, annotations=annos)
+            files.append(filename)
+            all_data.extend(data)
+
+        # glob should pick up all three, in order
+        file_source = sigmf.source.make_sequence(
+            [os.path.join(self.test_dir, "sequence_*")], "cf32_le")
+        sink = blocks.vector_sink_c()
+        collector = tag_collector()
+        tb = gr.top_block()
+        tb.connect(file_source, collector)
+        tb.connect(collector, sink)
+        tb.run()
+
+        self.assertComplexTuplesAlmostEqual(all_data, sink.data())
+        for i in range(3):
+            collector.assertTagExists(i * N + 5, "test:file", i)
+
+    def test_sequence_repeat(self):
+        N = 1000
+        files = []
+        for i in range(2):
+            data, meta_json, filename, meta_file = self.make_file(
+                "sequence_repeat_%d" % i, N=N)
+            files.append(filename)
+        file_source = sigmf.source.make_sequence(files, "cf32_le", True)
+        sink = blocks.vector_sink_c()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.start()
+        sleep(.005)
+        tb.stop()
+        tb.wait()
+        self.assertGreater(len(sink.data()), 2 * N,
+                           "No repeats occurred to test!")
+
+    def test_sequence_no_match(self):
+        with self.assertRaises(RuntimeError):
+            sigmf.source.make_sequence(
+                [os.path.join(self.test_dir, "not_here_*")], "cf32_le")
+
+    def test_repeat_cache(self):
+        N = 1000
+        annos = [{
+            "core:sample_start": 10,
+            "core:sample_count": 1,
+            "test:foo": "a",
+        }]
+        data, meta_json, filename, meta_file = self.make_file(
+            "repeat_cache", N=N, annotations=annos)
+        file_source = sigmf.source(filename, "cf32_le", repeat=True)
+        # too small to hold the converted recording
+        self.assertFalse(file_source.set_repeat_cache(N))
+        self.assertTrue(file_source.set_repeat_cache(1 << 20))
+        sink = blocks.vector_sink_c()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.start()
+        sleep(.005)
+        tb.stop()
+        tb.wait()
+        num_reps = len(sink.data()) // N
+        self.assertGreater(num_reps, 1, "No repeats occurred to test!")
+
+        for i in range(num_reps):
+            self.assertComplexTuplesAlmostEqual(
+                data, sink.data()[i * N:(i + 1) * N])
+            foo_tags = [t for t in sink.tags()
+                        if t.offset == (i * N) + 10 and
+                        pmt.to_python(t.key) == "test:foo"]
+            self.assertEqual(len(foo_tags), 1, "test:foo missing in repeat")
+
+    def test_repeat_cache_while_running(self):
+        N = 1000
+        data, meta_json, filename, meta_file = self.make_file(
+            "repeat_cache_running", N=N)
+        file_source = sigmf.source(filename, "cf32_le", repeat=True)
+        sink = blocks.vector_sink_c()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.start()
+        sleep(.005)
+        self.assertTrue(file_source.set_repeat_cache(1 << 20))
+        sleep(.005)
+        self.assertFalse(file_source.set_repeat_cache(0))
+        sleep(.005)
+        tb.stop()
+        tb.wait()
+
+        # Playback carries on where it was each time the cache changes
+        num_reps = len(sink.data()) // N
+        self.assertGreater(num_reps, 2, "No repeats occurred to test!")
+        for i in range(num_reps):
+            self.assertComplexTuplesAlmostEqual(
+                data, sink.data()[i * N:(i + 1) * N])
+
+    def test_preview(self):
+        N = 10000
+        stride = 4
+        block = 100
+        annos = [{
+            "core:sample_start": 150,
+            "test:skipped": True,
+        }, {
+            "core:sample_start": 405,
+            "test:played": True,
+        }]
+        data, meta_json, filename, meta_file = self.make_file(
+            "preview", N=N, annotations=annos,
+            global_data={"core:sample_rate": 200000.})
+        file_source = sigmf.source(filename, "cf32_le")
+        file_source.set_preview(stride, block)
+        sink = blocks.vector_sink_c()
+        collector = tag_collector()
+        tb = gr.top_block()
+        tb.connect(file_source, collector)
+        tb.connect(collector, sink)
+        tb.run()
+
+        expected = []
+        for start in range(0, N, stride * block):
+            expected.extend(data[start:start + block])
+        self.assertComplexTuplesAlmostEqual(expected, sink.data())
+
+        # skipped tags land on the first sample of the next block played
+        collector.assertTagExists(block, "test:skipped", True)
+        collector.assertTagExists(block + 5, "test:played", True)
+        collector.assertTagExists(0, "rx_rate", 200000. / stride)
+
+    def test_preview_while_running(self):
+        N = 1000
+        stride = 4
+        block = 50
+        # Every sample different, so a preview block can be found
+        samples = numpy.arange(2 * N, dtype=numpy.float32)
+        filename = self.make_raw_file("preview_running", "cf32_le", samples)
+        data = [complex(samples[2 * i], samples[2 * i + 1]) for i in range(N)]
+        file_source = sigmf.source(filename, "cf32_le", repeat=True)
+        sink = blocks.vector_sink_c()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.start()
+        sleep(.005)
+        file_source.set_preview(stride, block)
+        sleep(.005)
+        tb.stop()
+        tb.wait()
+
+        # Once the recording starts again, it plays as a preview
+        expected = []
+        for start in range(0, N, stride * block):
+            expected.extend(data[start:start + block])
+        out = sink.data()
+        starts = [i for i in range(len(out) - len(expected))
+                  if out[i] == data[0]]
+        self.assertGreater(len(starts), 1, "No previews occurred to test!")
+        last = starts[-1]
+        self.assertComplexTuplesAlmostEqual(
+            expected, out[last:last + len(expected)])
+
+    def test_unsigned_conversions(self):
+        # cu8, as written by RTL-SDRs, is offset binary around 128
+        raw = numpy.arange(0, 256, dtype=numpy.uint8)
+        filename = self.make_raw_file("cu8", "cu8", raw)
+        file_source = sigmf.source(filename, "cf32_le")
+        sink = blocks.vector_sink_c()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        scaled = (raw.astype(numpy.float32) - 128) / 127
+        expected = scaled[0::2] + 1j * scaled[1::2]
+        self.assertComplexTuplesAlmostEqual(expected, sink.data(), 5)
+
+        raw = numpy.arange(0, 65536, 257, dtype=numpy.uint16)
+        filename = self.make_raw_file("ru16", "ru16_le", raw.astype("<u2"))
+        file_source = sigmf.source(filename, "ri16_le")
+        sink = blocks.vector_sink_s()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        expected = raw.astype(numpy.int32) - 32768
+        self.assertEqual(list(expected), list(sink.data()))
+
+        raw = numpy.array([0, 1, 2**31, 2**32 - 1], dtype=numpy.uint32)
+        filename = self.make_raw_file("ru32", "ru32_le", raw.astype("<u4"))
+        file_source = sigmf.source(filename, "rf32_le")
+        sink = blocks.vector_sink_f()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        expected = (raw.astype(numpy.float64) - 2**31) / (2**31 - 1)
+        self.assertFloatTuplesAlmostEqual(expected, sink.data(), 5)
+
+    def test_scale(self):
+        # Normalized floats would otherwise round to -1, 0 or 1
+        raw = numpy.linspace(-1, 1, 64, dtype=numpy.float32)
+        filename = self.make_raw_file("scale", "rf32_le", raw.astype("<f4"))
+        file_source = sigmf.source(filename, "ri16_le")
+        file_source.set_scale(32767)
+        sink = blocks.vector_sink_s()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        expected = numpy.rint(raw.astype(numpy.float64) * 32767)
+        self.assertEqual(list(expected.astype(int)), list(sink.data()))
+
+        # Offset, and saturation
+        file_source = sigmf.source(filename, "ri16_le")
+        file_source.set_scale(32767, 16384)
+        sink = blocks.vector_sink_s()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        expected = numpy.clip(numpy.rint(raw.astype(numpy.float64) * 32767 + 16384),
+                              -32768, 32767)
+        self.assertEqual(list(expected.astype(int)), list(sink.data()))
+
+    def test_scale_while_running(self):
+        N = 1000
+        samples = numpy.arange(2 * N, dtype=numpy.float32)
+        filename = self.make_raw_file("scale_running", "cf32_le", samples)
+        data = [complex(samples[2 * i], samples[2 * i + 1]) for i in range(N)]
+        file_source = sigmf.source(filename, "cf32_le", repeat=True)
+        # The cache is converted again with the new scale
+        self.assertTrue(file_source.set_repeat_cache(1 << 20))
+        sink = blocks.vector_sink_c()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.start()
+        sleep(.005)
+        file_source.set_scale(2)
+        sleep(.005)
+        tb.stop()
+        tb.wait()
+
+        out = sink.data()
+        num_reps = len(out) // N
+        self.assertGreater(num_reps, 2, "No repeats occurred to test!")
+        for i, d in enumerate(out):
+            self.assertIn(d, (data[i % N], 2 * data[i % N]))
+        last = (num_reps - 1) * N
+        self.assertComplexTuplesAlmostEqual(
+            [2 * d for d in data], out[last:last + N])
+
+    def test_scale_from_metadata(self):
+        raw = list(range(-500, 500, 3))
+        filename = os.path.join(self.test_dir, "scale_meta")
+        file_sink = sigmf.sink("ri16_le", filename)
+        file_sink.set_scale(0.5, 1)
+        tb = gr.top_block()
+        tb.connect(blocks.vector_source_s(raw), file_sink)
+        tb.run()
+        data_path = file_sink.get_data_path()
+        with open(file_sink.get_meta_path(), "r") as f:
+            meta = json.load(f)
+        self.assertEqual(meta["global"]["gr_sigmf:scale"], 0.5)
+        self.assertEqual(meta["global"]["gr_sigmf:offset"], 1)
+
+        # Played as floats, samples come out in physical units
+        file_source = sigmf.source(data_path, "rf32_le")
+        sink = blocks.vector_sink_f()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        expected = [x * 0.5 + 1 for x in raw]
+        self.assertFloatTuplesAlmostEqual(expected, sink.data(), 5)
+
+        # but not as integers
+        file_source = sigmf.source(data_path, "ri16_le")
+        sink = blocks.vector_sink_s()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        self.assertEqual(raw, list(sink.data()))
+
+    def test_unsigned_big_endian(self):
+        # Byte swapped and offset binary at once
+        native = "_le" if sys.byteorder == "little" else "_be"
+        raw = numpy.arange(0, 65536, 255, dtype=numpy.uint16)
+        filename = self.make_raw_file("ru16_be", "ru16_be", raw.astype(">u2"))
+        file_source = sigmf.source(filename, "rf32" + native)
+        sink = blocks.vector_sink_f()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        expected = (raw.astype(numpy.float64) - 32768) / 32767
+        self.assertFloatTuplesAlmostEqual(expected, sink.data(), 5)
+
+    def test_big_endian(self):
+        native = "_le" if sys.byteorder == "little" else "_be"
+        raw = numpy.arange(-1000, 1000, 7, dtype=numpy.int16)
+        filename = self.make_raw_file("ci16_be", "ci16_be", raw.astype(">i2"))
+
+        file_source = sigmf.source(filename, "ci16" + native)
+        sink = blocks.vector_sink_s(2)
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        self.assertEqual(list(raw), list(sink.data()))
+
+        file_source = sigmf.source(filename, "cf32" + native)
+        sink = blocks.vector_sink_c()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        scaled = raw.astype(numpy.float32) / 32767
+        expected = scaled[0::2] + 1j * scaled[1::2]
+        self.assertComplexTuplesAlmostEqual(expected, sink.data(), 5)
+
+        # Without a datatype, samples come out in native order
+        file_source = sigmf.source.make_no_datatype(filename)
+        sink = blocks.vector_sink_s(2)
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        self.assertEqual(list(raw), list(sink.data()))
+
+        raw = numpy.linspace(-1, 1, 64, dtype=numpy.float32)
+        filename = self.make_raw_file("rf32_be", "rf32_be", raw.astype(">f4"))
+        file_source = sigmf.source(filename, "rf32" + native)
+        sink = blocks.vector_sink_f()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        self.assertFloatTuplesAlmostEqual(raw, sink.data())
+
+    def test_64_bit_types(self):
+        native = "_le" if sys.byteorder == "little" else "_be"
+        raw = numpy.linspace(-1, 1, 200, dtype=numpy.float64)
+        filename = self.make_raw_file("cf64", "cf64" + native, raw)
+        file_source = sigmf.source(filename, "cf32" + native)
+        sink = blocks.vector_sink_c()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        expected = raw[0::2] + 1j * raw[1::2]
+        self.assertComplexTuplesAlmostEqual(expected, sink.data(), 5)
+
+        raw = numpy.array([-2**63 + 1, -2**40, 0, 2**40, 2**63 - 1],
+                          dtype=numpy.int64)
+        filename = self.make_raw_file("ri64", "ri64" + native, raw)
+        file_source = sigmf.source(filename, "rf32" + native)
+        sink = blocks.vector_sink_f()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        expected = raw.astype(numpy.float64) / (2**63 - 1)
+        self.assertFloatTuplesAlmostEqual(expected, sink.data(), 5)
+
+    def test_64_bit_round_trip(self):
+        native = "_le" if sys.byteorder == "little" else "_be"
+        raw = numpy.linspace(-10, 10, 1000, dtype=numpy.float64)
+        filename = self.make_raw_file("rf64_in", "rf64" + native, raw)
+        out_filename = os.path.join(self.test_dir, "rf64_out.sigmf-data")
+
+        # play it out as rf64 and record it again
+        file_source = sigmf.source(filename, "rf64" + native)
+        file_sink = sigmf.sink("rf64" + native, out_filename)
+        tb = gr.top_block()
+        tb.connect(file_source, file_sink)
+        tb.run()
+
+        out = numpy.fromfile(out_filename, dtype=numpy.float64)
+        self.assertEqual(list(raw), list(out))
+        with open(os.path.join(self.test_dir, "rf64_out.sigmf-meta")) as f:
+            meta = json.load(f)
+        self.assertEqual(meta["global"]["core:datatype"], "rf64" + native)
+
+        # and it should play back the same way
+        file_source = sigmf.source(out_filename, "rf32" + native)
+        sink = blocks.vector_sink_f()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        self.assertFloatTuplesAlmostEqual(raw, sink.data(), 4)
+
+    def test_packed_formats(self):
+        native = "_le" if sys.byteorder == "little" else "_be"
+        # ci4, I in the high nibble
+        values = numpy.array([7, -8, 0, -1, 3, -3, 5, 1], dtype=numpy.int8)
+        packed = ((values[0::2] << 4) | (values[1::2] & 0x0f)).astype(numpy.uint8)
+        filename = os.path.join(self.test_dir, "ci4_out.sigmf-data")
+
+        # The sink stores packed bytes as they come in
+        file_sink = sigmf.sink("ci4", filename)
+        tb = gr.top_block()
+        tb.connect(blocks.vector_source_b(list(packed)), file_sink)
+        tb.run()
+        self.assertEqual(list(packed), list(numpy.fromfile(filename, dtype=numpy.uint8)))
+
+        file_source = sigmf.source(filename, "ci8")
+        sink = blocks.vector_sink_b(2)
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        out = numpy.array(sink.data(), dtype=numpy.uint8).astype(numpy.int8)
+        self.assertEqual(list(values), list(out))
+
+        file_source = sigmf.source(filename, "cf32" + native)
+        sink = blocks.vector_sink_c()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        scaled = values.astype(numpy.float32) / 7
+        expected = scaled[0::2] + 1j * scaled[1::2]
+        self.assertComplexTuplesAlmostEqual(expected, sink.data(), 5)
+
+        # ci12_le, the low 8 bits of I, then the high 4 bits of I with the
+        # low 4 bits of Q, then the high 8 bits of Q
+        values = numpy.array([2047, -2048, 0, -1, 1000, -1000], dtype=numpy.int16)
+        i = values[0::2].astype(numpy.uint16) & 0xfff
+        q = values[1::2].astype(numpy.uint16) & 0xfff
+        packed = numpy.zeros(len(i) * 3, dtype=numpy.uint8)
+        packed[0::3] = i & 0xff
+        packed[1::3] = (i >> 8) | ((q & 0x0f) << 4)
+        packed[2::3] = q >> 4
+        filename = self.make_raw_file("ci12", "ci12_le", packed)
+        file_source = sigmf.source(filename, "ci16" + native)
+        sink = blocks.vector_sink_s(2)
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        self.assertEqual(list(values), list(sink.data()))
+
     def test_command_message(self):
         data, meta_json, filename, meta_file = self.make_file("begin")
 
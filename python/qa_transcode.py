@@ -0,0 +1,185 @@
+import tempfile
+import json
+import os
+import shutil
+import sys
+
+from subprocess import PIPE, Popen
+
+import numpy as np
+from gnuradio import gr_unittest, blocks, gr
+
+try:
+    import gr_sigmf as sigmf
+except ImportError:
+    import sys
+    dirname, filename = os.path.split(os.path.abspath(__file__))
+    sys.path.append(os.path.join(dirname, "bindings"))
+    import gr_sigmf as sigmf
+
+
+NATIVE_SUFFIX = "_le" if sys.byteorder == "little" else "_be"
+
+
+class qa_transcode(gr_unittest.TestCase):
+
+    def setUp(self):
+
+        # Create a temporary directory
+        self.test_dir = tempfile.mkdtemp()
+
+    def tearDown(self):
+
+        # Remove the directory after the test
+        shutil.rmtree(self.test_dir)
+
+    def make_ci16_file(self, filename, N, global_data=None):
+        """write N ci16_le samples counting up through the whole range,
+        with a capture, an annotation and a stale hash"""
+        data_path = os.path.join(self.test_dir, filename + ".sigmf-data")
+        meta_path = os.path.join(self.test_dir, filename + ".sigmf-meta")
+        values = np.arange(2 * N, dtype=np.int64) * 7 % 65536 - 32768
+        values.astype("<i2").tofile(data_path)
+        meta = {
+            "global": {
+                "core:datatype": "ci16_le",
+                "core:version": "0.0.1",
+                "core:sample_rate": 1e6,
+                "core:sha512": "0" * 128,
+            },
+            "captures": [{"core:sample_start": 0}],
+            "annotations": [{
+                "core:sample_start": 10,
+                "core:sample_count": 5,
+                "core:label": "burst",
+            }],
+        }
+        if global_data:
+            meta["global"].update(global_data)
+        with open(meta_path, "w") as f:
+            json.dump(meta, f)
+        return data_path, meta_path
+
+    def run_transcode(self, args, filename, out_file):
+        cmd = ["sigmf-transcode"]
+        cmd.extend(args.split())
+        cmd.extend(["-o", out_file, filename])
+        p = Popen(cmd, stdout=PIPE, stderr=PIPE)
+        std_out, std_err = p.communicate()
+        return p.returncode, std_out, std_err
+
+    def play(self, filename, output_type="cf32_le"):
+        """samples as the source block produces them"""
+        file_source = sigmf.source(filename, output_type)
+        sink = blocks.vector_sink_c()
+        tb = gr.top_block()
+        tb.connect(file_source, sink)
+        tb.run()
+        return sink.data()
+
+    def test_ci16_to_cf32_threaded(self):
+        # Not a whole number of chunks, so the last one is short
+        N = 10007
+        data_path, meta_path = self.make_ci16_file("ci16", N)
+        out_file = os.path.join(self.test_dir, "cf32.sigmf-data")
+        rc, std_out, std_err = self.run_transcode(
+            "-t cf32 -j 4 --chunk-samples 1000", data_path, out_file)
+        self.assertEqual(rc, 0, std_err)
+
+        converted = np.fromfile(out_file, dtype=np.complex64)
+        self.assertEqual(len(converted), N)
+        self.assertComplexTuplesAlmostEqual(
+            self.play(data_path), tuple(converted), 6)
+
+        with open(os.path.splitext(out_file)[0] + ".sigmf-meta") as f:
+            meta = json.load(f)
+        self.assertEqual(meta["global"]["core:datatype"],
+                         "cf32" + NATIVE_SUFFIX)
+        self.assertNotIn("core:sha512", meta["global"])
+        self.assertEqual(meta["global"]["core:sample_rate"], 1e6)
+        self.assertEqual(meta["captures"], [{"core:sample_start": 0}])
+        self.assertEqual(len(meta["annotations"]), 1)
+        self.assertEqual(meta["annotations"][0]["core:label"], "burst")
+
+        # Played from the new file, the samples are the same again
+        self.assertComplexTuplesAlmostEqual(
+            self.play(data_path), self.play(out_file), 6)
+
+    def test_scale_applied(self):
+        N = 3000
+        data_path, meta_path = self.make_ci16_file(
+            "scaled", N, {"gr_sigmf:scale": 0.5, "gr_sigmf:offset": 0.25})
+        out_file = os.path.join(self.test_dir, "scaled_cf32.sigmf-data")
+        rc, std_out, std_err = self.run_transcode(
+            "-t cf32_le -j 3 --chunk-samples 256", data_path, out_file)
+        self.assertEqual(rc, 0, std_err)
+
+        # Scaled the way the source block scales it
+        converted = np.fromfile(out_file, dtype="<c8")
+        self.assertComplexTuplesAlmostEqual(
+            self.play(data_path), tuple(converted), 6)
+        with open(os.path.splitext(out_file)[0] + ".sigmf-meta") as f:
+            meta = json.load(f)
+        self.assertEqual(meta["global"]["core:datatype"], "cf32_le")
+        self.assertNotIn("gr_sigmf:scale", meta["global"])
+        self.assertNotIn("gr_sigmf:offset", meta["global"])
+        self.assertNotIn("core:sha512", meta["global"])
+
+    def test_scale_kept_when_not_applied(self):
+        N = 3000
+        data_path, meta_path = self.make_ci16_file(
+            "unscaled", N, {"gr_sigmf:scale": 0.5})
+        out_file = os.path.join(self.test_dir, "ci16_be.sigmf-data")
+        rc, std_out, std_err = self.run_transcode(
+            "-t ci16_be -j 2 --chunk-samples 100", data_path, out_file)
+        self.assertEqual(rc, 0, std_err)
+
+        original = np.fromfile(data_path, dtype="<i2")
+        swapped = np.fromfile(out_file, dtype=">i2")
+        self.assertEqual(list(original), list(swapped))
+        with open(os.path.splitext(out_file)[0] + ".sigmf-meta") as f:
+            meta = json.load(f)
+        self.assertEqual(meta["global"]["core:datatype"], "ci16_be")
+        self.assertEqual(meta["global"]["gr_sigmf:scale"], 0.5)
+        self.assertNotIn("core:sha512", meta["global"])
+
+    def test_same_file(self):
+        data_path, meta_path = self.make_ci16_file("same", 100)
+        with open(data_path, "rb") as f:
+            before = f.read()
+        # Named by its metadata file, it's still the same recording
+        rc, std_out, std_err = self.run_transcode(
+            "-t cf32 -j 2", data_path, meta_path)
+        self.assertNotEqual(rc, 0)
+        self.assertIn(b"onto itself", std_err)
+        with open(data_path, "rb") as f:
+            self.assertEqual(before, f.read())
+
+    def test_unreadable_input(self):
+        out_file = os.path.join(self.test_dir, "out.sigmf-data")
+        rc, std_out, std_err = self.run_transcode(
+            "-t cf32 -j 2",
+            os.path.join(self.test_dir, "missing.sigmf-data"), out_file)
+        self.assertNotEqual(rc, 0)
+        self.assertIn(b"Transcode failed", std_err)
+
+        # Metadata but no samples
+        data_path, meta_path = self.make_ci16_file("no_data", 100)
+        os.remove(data_path)
+        rc, std_out, std_err = self.run_transcode(
+            "-t cf32 -j 2", data_path, out_file)
+        self.assertNotEqual(rc, 0)
+        self.assertIn(b"Transcode failed", std_err)
+
+        # Samples but unparseable metadata
+        data_path, meta_path = self.make_ci16_file("bad_meta", 100)
+        with open(meta_path, "w") as f:
+            f.write("{\"global\": ")
+        rc, std_out, std_err = self.run_transcode(
+            "-t cf32 -j 2", data_path, out_file)
+        self.assertNotEqual(rc, 0)
+        self.assertIn(b"Transcode failed", std_err)
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_transcode)